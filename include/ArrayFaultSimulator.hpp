@@ -0,0 +1,443 @@
+#pragma once
+// =============================================================
+//  ArrayFaultSimulator.hpp — 具體陣列上的 fault injection 模擬，用來驗證 TP 模型算出的 coverage
+//  - 明確建出 rows × cols 的 DCIM 陣列：每格一個 D，每列一條 Ci（compute input）
+//  - 每個 FP 依 OrientationSelector 的方向注入到所有放得下的位置（victim + 相鄰 aggressor），
+//    逐 address 跑 March test，victim 上的 Read / Compute 輸出與 fault-free 機器不同即偵測（依 category）
+//  - 初值未知：全 0 與全 1 各跑一次，兩次都偵測到才算
+//
+//  操作語意（address = row * cols + col；Up 由 0 往上、Down 反向、Any 視同 Up）
+//    W v        ：D[a] = v
+//    R          ：輸出 D[a]
+//    C(T)(M)(B) ：Ci[row-1] = T、Ci[row] = M、Ci[row+1] = B（X 或超出陣列則不動），輸出 Ci[row] & D[a]
+//  Aggressor 位置：A_LT_V → 同列左鄰 / 上一列同欄；A_GT_V → 右鄰 / 下一列（row-agnostic 兩種都注入）
+//  FP 語意：
+//    - pivot（有 ops 的一側）在同一次 visit 內連續做完 S 的 ops 即 sensitize；pivot 自己的 pre_D / Ci
+//      在第一個 op 之前檢查，另一格的 D / Ci 在最後一個 op 時檢查（Ci 取該 op 驅動後的值，
+//      所以 compute 的 T/B 可替 cross-row aggressor 設 Ci）
+//    - 完成時 victim D = FD；若是 victim 上的 Read / Compute，輸出改為 RD / Co
+//    - 沒有 ops 的 FP 是 state fault：victim / aggressor 的 D 或 Ci 改變後條件成立即 victim D = FD；
+//      victim 上的 compute 驅動 Ci 後先結算再做 AND（同 TP 模型以偵測 compute 的 T / B 設 aggressor Ci）
+//    - 偵測看 fault category：must_read 只看 Read、must_compute 只看 Compute、either 兩者皆可
+//  以上 T / M / B 的方向、AND 用驅動後的 Ci、只看 victim 那一格的輸出，都與 TPGenerator 的偵測器一致。
+//
+//  與 TP 模型（FaultSimulator）已知的語意差異（ArrayCoverageCheck 以 input/ 的預設檔案列出的不一致都屬於這些）：
+//    - 模型多算：Co 效應不要求 D（CIDC 的 AND1Ci/0Co 在 D = 0 時輸出本來就是 0）；
+//      ^ / ; 偵測不檢查 Detector::order（CFid(↓,0)：遞增 element 裡 A_GT_V 的 victim 先於 aggressor 被讀）；
+//      element 內的 Ci 前態一律取 (Up) C0 = M、C2 = T、C4 = B（Down 為 T、B、M），但同列前一格留下的是
+//      T、M、B，每列第一格與位址 0 更只有上一列 / 初值（SDC(11,01)、CIDD(1,1)）
+//    - 模型少算：非 pivot 的 Ci 取 op 之前的值（CI(10,11)：同列的 AND1Ci 本身就把 aggressor 的 Ci 拉成 1）；
+//      只在 victim 的 op 取樣鄰格狀態，看不到 aggressor visit 中的暫態（CDCFst(00,0)）；
+//      sensitize 之後的寫入一律當成遮蔽，但錯值的 cell 再寫一次會再 sensitize（TFu：W0, W1, W1, R1）；
+//      state 在偵測 compute 之前已成立時，偵測器仍要求 compute 的 T / B 去設 aggressor Ci（CIDDB(1,1)）
+//
+//  位元平行：fault instance 只會讓自己的 victim 偏離 fault-free 機器，其他格都等於 fault-free 值，
+//  所以每格只存 victim 的 faulty D，一個 64-bit word 的 bit = lane（FP × 方向 × 擺法），
+//  一次 word 運算推進 64 個 instance；fault-free 機器以每 word 64 格的 bit-packed rows 存。
+//  aggressor 偏移不同的 lanes 分成獨立的 LaneSet，各 LaneSet × 兩種初值可平行跑。
+// =============================================================
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include "FaultSimulator.hpp"
+#include "ThreadPool.hpp"
+
+struct ArrayGeometry {
+    size_t rows{16};
+    size_t cols{64};
+};
+
+// aggressor 相對 victim 的擺法：Single 無 aggressor；SameRow 左右鄰；CrossRow 上下鄰
+enum class ArrayPlacement { Single, SameRow, CrossRow };
+
+// 一條 lane = (fault, fp, orientation, placement) 注入到所有位置的結果
+struct ArrayLaneResult {
+    size_t fault_index{0}; // faults 中的位置
+    size_t fp_index{0};
+    OrientationGroup group{OrientationGroup::Single};
+    ArrayPlacement placement{ArrayPlacement::Single};
+    size_t positions{0}; // 注入的 victim 位置數（aggressor 需在陣列內）
+    size_t detected{0};  // 兩種初值下都偵測到的位置數
+    bool fully_detected() const { return positions > 0 && detected == positions; }
+};
+
+struct ArraySimulationResult {
+    vector<ArrayLaneResult> lanes;
+    // 依 faults 順序，規則同 Reporter：單格 0/1，雙格每個方向 0.5；
+    // 某方向算偵測 = 有一個 FP 在該方向所有擺法的所有位置都偵測到
+    vector<double> fault_coverage;
+    double total_coverage{0.0};
+};
+
+class ArrayFaultSimulator {
+public:
+    ArrayFaultSimulator(const vector<Fault>& faults, ArrayGeometry geometry);
+
+    // 設定後各 LaneSet × 初值平行跑
+    void set_thread_pool(ThreadPool* pool) { pool_ = pool; }
+    const ArrayGeometry& geometry() const { return geo_; }
+
+    ArraySimulationResult simulate(const MarchTest& mt) const;
+
+private:
+    using Word = uint64_t;
+    static constexpr size_t LANE_BITS = 64;
+    enum Offset { None, Left, Right, Up, Down, OFFSET_NUM };
+
+    // 同一種 aggressor 偏移的 lanes；各遮罩以 word 為單位，bit = lane
+    struct LaneSet {
+        Offset offset{None};
+        vector<size_t> results; // lane -> ArraySimulationResult::lanes 的索引
+        size_t words{0};
+        size_t max_len{0};      // 最長的 S op 序列
+        vector<Word> read_obs, comp_obs;      // 依 fault category：Read / Compute 的輸出能看到錯誤
+        vector<Word> state, vseq, aseq;       // state: 無 ops；vseq / aseq: ops 在 victim / aggressor
+        vector<Word> vd1, vd0, vc1, vc0, ad1, ad0, ac1, ac0; // 條件：victim / aggressor 的 D、Ci 需為 1 / 0
+        vector<Word> fd_care, fd_one, rd_care, rd_one, co_care, co_one;
+        vector<Word> len_is; // [k * words + w]：S 長度為 k
+        vector<Word> match;  // [(k * OP_CODE_NUM + code) * words + w]：S 的第 k 個 op 匹配 code
+    };
+
+    const vector<Fault>& faults_;
+    ArrayGeometry geo_;
+    vector<ArrayLaneResult> lane_results_;
+    array<LaneSet, OFFSET_NUM> sets_;
+    ThreadPool* pool_{nullptr};
+
+    struct LaneSpec {
+        const FPExpr* fp;
+        const vector<Op>* seq; // pivot 那一側的 S ops
+        WhoIsPivot pivot;
+        Category category;
+    };
+    static void build_masks(LaneSet& ls, const vector<LaneSpec>& specs);
+    struct Cell { size_t idx, row, col; };
+    // victim v 的 aggressor；超出陣列回 false
+    bool aggressor_of(Offset off, const Cell& v, Cell& g) const;
+    // aggressor 為 g 的 victim
+    bool victim_of(Offset off, const Cell& g, Cell& v) const;
+    // 回傳每個 victim 位置的偵測 word（[v * words + w]）
+    vector<Word> run(const MarchTest& mt, const LaneSet& ls, bool init) const;
+};
+
+inline ArrayFaultSimulator::ArrayFaultSimulator(const vector<Fault>& faults, ArrayGeometry geometry)
+    : faults_(faults), geo_(geometry) {
+    if (geo_.rows == 0 || geo_.cols == 0) throw runtime_error("ArrayFaultSimulator: empty array geometry");
+    for (size_t o = 0; o < OFFSET_NUM; ++o) sets_[o].offset = static_cast<Offset>(o);
+    array<vector<LaneSpec>, OFFSET_NUM> specs;
+    OrientationSelector selector;
+    for (size_t fi = 0; fi < faults.size(); ++fi) {
+        const Fault& fault = faults[fi];
+        for (size_t p = 0; p < fault.primitives.size(); ++p) {
+            const FPExpr& fp = fault.primitives[p];
+            if (fp.Sa && fp.Sa->has_ops() && fp.Sv.has_ops())
+                throw runtime_error("ArrayFaultSimulator: FP with ops on both cells is not supported: " + fault.fault_id);
+            for (const OrientationPlan& plan : selector.plans(fault.cell_scope, fp)) {
+                const bool lt = plan.group == OrientationGroup::A_LT_V;
+                vector<pair<ArrayPlacement, Offset>> places;
+                switch (fault.cell_scope) {
+                    case CellScope::SingleCell:         places = {{ArrayPlacement::Single, None}}; break;
+                    case CellScope::TwoCellSameRow:     places = {{ArrayPlacement::SameRow, lt ? Left : Right}}; break;
+                    case CellScope::TwoCellCrossRow:    places = {{ArrayPlacement::CrossRow, lt ? Up : Down}}; break;
+                    case CellScope::TwoCellRowAgnostic: places = {{ArrayPlacement::SameRow, lt ? Left : Right},
+                                                                  {ArrayPlacement::CrossRow, lt ? Up : Down}}; break;
+                }
+                for (const auto& [placement, off] : places) {
+                    ArrayLaneResult r;
+                    r.fault_index = fi; r.fp_index = p; r.group = plan.group; r.placement = placement;
+                    lane_results_.push_back(r);
+                    sets_[off].results.push_back(lane_results_.size() - 1);
+                    const bool on_aggr = plan.pivot == WhoIsPivot::Aggressor;
+                    specs[off].push_back(LaneSpec{&fp, on_aggr ? &fp.Sa->ops : &fp.Sv.ops, plan.pivot, fault.category});
+                }
+            }
+        }
+    }
+    for (size_t o = 0; o < OFFSET_NUM; ++o) build_masks(sets_[o], specs[o]);
+}
+
+inline void ArrayFaultSimulator::build_masks(LaneSet& ls, const vector<LaneSpec>& specs) {
+    const size_t W = (specs.size() + LANE_BITS - 1) / LANE_BITS;
+    ls.words = W;
+    ls.max_len = 0;
+    for (const LaneSpec& s : specs) ls.max_len = std::max(ls.max_len, s.seq->size());
+    for (auto* v : {&ls.read_obs, &ls.comp_obs, &ls.state, &ls.vseq, &ls.aseq, &ls.vd1, &ls.vd0, &ls.vc1, &ls.vc0,
+                    &ls.ad1, &ls.ad0, &ls.ac1, &ls.ac0, &ls.fd_care, &ls.fd_one, &ls.rd_care, &ls.rd_one,
+                    &ls.co_care, &ls.co_one}) v->assign(W, 0);
+    ls.len_is.assign((ls.max_len + 1) * W, 0);
+    ls.match.assign(ls.max_len * OP_CODE_NUM * W, 0);
+
+    for (size_t lane = 0; lane < specs.size(); ++lane) {
+        const LaneSpec& s = specs[lane];
+        const FPExpr& fp = *s.fp;
+        const vector<Op>& seq = *s.seq;
+        const size_t w = lane / LANE_BITS;
+        const Word bit = Word(1) << (lane % LANE_BITS);
+        auto put = [&](vector<Word>& v, bool on) { if (on) v[w] |= bit; };
+        // care 記「有值」，one 記「值為 1」；條件類則分成需為 1 / 需為 0
+        auto put_cond = [&](vector<Word>& one, vector<Word>& zero, const optional<Val>& val) {
+            put(one, val == Val::One); put(zero, val == Val::Zero);
+        };
+        auto put_effect = [&](vector<Word>& care, vector<Word>& one, const optional<Val>& val) {
+            put(care, val == Val::One || val == Val::Zero); put(one, val == Val::One);
+        };
+        put(ls.read_obs, s.category != Category::MustCompute);
+        put(ls.comp_obs, s.category != Category::MustRead);
+        put(ls.state, seq.empty());
+        put(ls.vseq, !seq.empty() && s.pivot == WhoIsPivot::Victim);
+        put(ls.aseq, !seq.empty() && s.pivot == WhoIsPivot::Aggressor);
+        put_cond(ls.vd1, ls.vd0, fp.Sv.pre_D);
+        put_cond(ls.vc1, ls.vc0, fp.Sv.Ci);
+        if (fp.Sa) { put_cond(ls.ad1, ls.ad0, fp.Sa->pre_D); put_cond(ls.ac1, ls.ac0, fp.Sa->Ci); }
+        put_effect(ls.fd_care, ls.fd_one, fp.F.FD);
+        put_effect(ls.rd_care, ls.rd_one, fp.R.RD);
+        put_effect(ls.co_care, ls.co_one, fp.C.Co);
+        ls.len_is[seq.size() * W + w] |= bit;
+        for (size_t k = 0; k < seq.size(); ++k) {
+            const OpCode pattern = encode_op(seq[k]);
+            for (int code = 0; code < OP_CODE_NUM; ++code)
+                if (op_code_match(pattern, (OpCode)code)) ls.match[(k * OP_CODE_NUM + code) * W + w] |= bit;
+        }
+    }
+}
+
+inline bool ArrayFaultSimulator::aggressor_of(Offset off, const Cell& v, Cell& g) const {
+    switch (off) {
+        case Left:  if (v.col == 0) return false; g = {v.idx - 1, v.row, v.col - 1}; return true;
+        case Right: if (v.col + 1 == geo_.cols) return false; g = {v.idx + 1, v.row, v.col + 1}; return true;
+        case Up:    if (v.row == 0) return false; g = {v.idx - geo_.cols, v.row - 1, v.col}; return true;
+        case Down:  if (v.row + 1 == geo_.rows) return false; g = {v.idx + geo_.cols, v.row + 1, v.col}; return true;
+        default:    return false;
+    }
+}
+
+inline bool ArrayFaultSimulator::victim_of(Offset off, const Cell& g, Cell& v) const {
+    switch (off) {
+        case Left:  return aggressor_of(Right, g, v);
+        case Right: return aggressor_of(Left, g, v);
+        case Up:    return aggressor_of(Down, g, v);
+        case Down:  return aggressor_of(Up, g, v);
+        default:    return false;
+    }
+}
+
+inline vector<ArrayFaultSimulator::Word> ArrayFaultSimulator::run(const MarchTest& mt, const LaneSet& ls, bool init) const {
+    const size_t R = geo_.rows, M = geo_.cols, N = R * M, W = ls.words, L = ls.max_len;
+    const size_t row_words = (M + LANE_BITS - 1) / LANE_BITS;
+    const Word fill = init ? ~Word(0) : 0;
+    vector<Word> d(R * row_words, fill); // fault-free D
+    vector<uint8_t> ci(R, init ? 1 : 0);  // 每列的 Ci
+    vector<Word> f(N * W, fill);          // 各 lane 的 victim faulty D
+    vector<Word> det(N * W, 0);
+    vector<Word> pv((L + 1) * W), pa((L + 1) * W); // visit 內已匹配 k 個 op 的 lanes（victim / aggressor 為 pivot）
+
+    auto get_d = [&](const Cell& x) -> bool { return (d[x.row * row_words + x.col / LANE_BITS] >> (x.col % LANE_BITS)) & 1; };
+    auto set_d = [&](const Cell& x, bool b) {
+        Word& wd = d[x.row * row_words + x.col / LANE_BITS];
+        const Word bit = Word(1) << (x.col % LANE_BITS);
+        wd = b ? (wd | bit) : (wd & ~bit);
+    };
+    // 單一值的條件：值為 1 時排除「需為 0」的 lanes，反之亦然
+    auto cond = [](bool b, Word one, Word zero) -> Word { return b ? ~zero : ~one; };
+    // 各 lane 各自的值（victim faulty D）
+    auto cond_f = [](Word fv, Word one, Word zero) -> Word { return ~(one & ~fv) & ~(zero & fv); };
+    auto apply_fd = [&](Word& fv, Word hit, size_t w) { fv = (fv & ~(hit & ls.fd_care[w])) | (hit & ls.fd_one[w]); };
+    const bool has_state = std::any_of(ls.state.begin(), ls.state.end(), [](Word x) { return x != 0; });
+    const bool two_cell = ls.offset != None;
+
+    // state fault：條件成立的 lanes 把 victim 設成 FD。
+    // 兩次 visit 之間 victim / aggressor 的 D 不變，只有 Ci 會被別列的 compute 改動，所以大多 lanes
+    // 延後到下次碰到 victim 或 aggressor 時才補算（catch_up）：自上次結算後某列改過 Ci，兩個值都出現過。
+    // cross-row 且兩格都要求 Ci 的 lanes 需要兩列「同時」成立，只能在列 Ci 改變時立即結算（joint）
+    vector<uint64_t> settled(N, 0), ci_changed(R, 0); // 上次結算 / 列 Ci 上次改變的 op 時刻
+    uint64_t clock = 0;
+    vector<Word> joint(W, 0);
+    if (ls.offset == Up || ls.offset == Down)
+        for (size_t w = 0; w < W; ++w) joint[w] = ls.state[w] & (ls.vc1[w] | ls.vc0[w]) & (ls.ac1[w] | ls.ac0[w]);
+    const bool has_joint = std::any_of(joint.begin(), joint.end(), [](Word x) { return x != 0; });
+
+    auto settle = [&](const Cell& v, const vector<Word>& lanes, bool stamp) {
+        Cell g = v;
+        if (two_cell && !aggressor_of(ls.offset, v, g)) return;
+        for (size_t w = 0; w < W; ++w) {
+            Word& fv = f[v.idx * W + w];
+            Word hit = lanes[w] & cond_f(fv, ls.vd1[w], ls.vd0[w]) & cond(ci[v.row], ls.vc1[w], ls.vc0[w]);
+            if (two_cell) hit &= cond(get_d(g), ls.ad1[w], ls.ad0[w]) & cond(ci[g.row], ls.ac1[w], ls.ac0[w]);
+            apply_fd(fv, hit, w);
+        }
+        if (stamp) settled[v.idx] = clock;
+    };
+    auto catch_up = [&](const Cell& v, const Cell& g) {
+        const bool changed_v = ci_changed[v.row] > settled[v.idx], changed_g = ci_changed[g.row] > settled[v.idx];
+        if (!changed_v && !changed_g) return; // 條件與上次結算時相同
+        auto had = [&](size_t row, bool changed, Word one, Word zero) -> Word {
+            return (changed || ci[row] == 1 ? ~Word(0) : ~one) & (changed || ci[row] == 0 ? ~Word(0) : ~zero);
+        };
+        for (size_t w = 0; w < W; ++w) {
+            Word& fv = f[v.idx * W + w];
+            Word hit = ls.state[w] & ~joint[w] & cond_f(fv, ls.vd1[w], ls.vd0[w]);
+            if (!hit) continue;
+            if (two_cell) hit &= cond(get_d(g), ls.ad1[w], ls.ad0[w]);
+            if (g.row == v.row) { // 同一列：兩格要求的 Ci 要同時成立
+                const Word one = ls.vc1[w] | ls.ac1[w], zero = ls.vc0[w] | ls.ac0[w];
+                hit &= ~(one & zero) & had(v.row, changed_v, one, zero);
+            } else {
+                hit &= had(v.row, changed_v, ls.vc1[w], ls.vc0[w]) & had(g.row, changed_g, ls.ac1[w], ls.ac0[w]);
+            }
+            apply_fd(fv, hit, w);
+        }
+        settled[v.idx] = clock;
+    };
+    auto settle_around = [&](const Cell& x, const vector<Word>& lanes, bool stamp) { // x 當 victim、x 當 aggressor 的 instances
+        settle(x, lanes, stamp);
+        Cell v;
+        if (victim_of(ls.offset, x, v)) settle(v, lanes, stamp);
+    };
+    if (has_state)
+        for (size_t v = 0; v < N; ++v) settle(Cell{v, v / M, v % M}, ls.state, true);
+
+    for (const MarchElement& elem : mt.elements) {
+        const bool down = elem.order == AddrOrder::Down;
+        for (size_t i = 0; i < N; ++i) {
+            const size_t idx = down ? N - 1 - i : i;
+            const Cell a{idx, idx / M, idx % M};
+            Cell ga = a, vb = a;
+            const bool as_victim = !two_cell || aggressor_of(ls.offset, a, ga);
+            const bool as_aggr = victim_of(ls.offset, a, vb);
+            Cell gb = a; // vb 的 aggressor 就是 a
+            std::fill(pv.begin(), pv.end(), 0);
+            std::fill(pa.begin(), pa.end(), 0);
+            for (const Op& op : elem.ops) {
+                ++clock;
+                if (has_state) {
+                    if (as_victim) catch_up(a, ga);
+                    if (as_aggr) catch_up(vb, gb);
+                }
+                const OpCode code = encode_op(op);
+                const bool d_a = get_d(a), ci_before = ci[a.row];
+                // compute 先驅動三條 Ci，記下有變的列
+                size_t changed[3]; size_t n_changed = 0;
+                if (op.kind == OpKind::ComputeAnd) {
+                    auto drive = [&](size_t row, bool ok, Val v) {
+                        if (!ok || v == Val::X) return;
+                        const uint8_t b = v == Val::One;
+                        if (ci[row] != b) { ci[row] = b; ci_changed[row] = clock; changed[n_changed++] = row; }
+                    };
+                    drive(a.row - 1, a.row > 0, op.C_T);
+                    drive(a.row, true, op.C_M);
+                    drive(a.row + 1, a.row + 1 < R, op.C_B);
+                }
+                // 驅動後條件成立的 state fault 在 AND 之前就生效：TP 模型也以偵測 compute 的 T / B
+                // 設定 aggressor 的 Ci，並在同一個 compute 看到結果
+                if (has_state && as_victim && n_changed) settle(a, ls.state, true);
+                const bool m = op.kind == OpKind::ComputeAnd && op.C_M == Val::One; // March test 的 C 運算元必為 0/1
+                bool fired = false;
+
+                for (size_t w = 0; w < W; ++w) {
+                    if (as_victim) {
+                        Word& fv = f[a.idx * W + w];
+                        const Word start = ls.vseq[w] & cond_f(fv, ls.vd1[w], ls.vd0[w]) & cond(ci_before, ls.vc1[w], ls.vc0[w]);
+                        Word done = 0;
+                        for (size_t k = L; k >= 1; --k) {
+                            const Word nk = (k == 1 ? start : pv[(k - 1) * W + w]) & ls.match[((k - 1) * OP_CODE_NUM + code) * W + w];
+                            pv[k * W + w] = nk;
+                            done |= nk & ls.len_is[k * W + w];
+                        }
+                        if (two_cell) done &= cond(get_d(ga), ls.ad1[w], ls.ad0[w]) & cond(ci[ga.row], ls.ac1[w], ls.ac0[w]);
+                        if (op.kind == OpKind::Read) {
+                            const Word out = (fv & ~(done & ls.rd_care[w])) | (done & ls.rd_one[w]);
+                            det[a.idx * W + w] |= (out ^ (d_a ? ~Word(0) : 0)) & ls.read_obs[w];
+                        } else if (op.kind == OpKind::ComputeAnd) {
+                            const Word out = ((m ? fv : 0) & ~(done & ls.co_care[w])) | (done & ls.co_one[w]);
+                            det[a.idx * W + w] |= (out ^ (m && d_a ? ~Word(0) : 0)) & ls.comp_obs[w];
+                        } else {
+                            fv = op.value == Val::One ? ~Word(0) : 0;
+                        }
+                        apply_fd(fv, done, w);
+                        fired |= done != 0;
+                    }
+                    if (as_aggr) {
+                        Word& fv = f[vb.idx * W + w];
+                        const Word start = ls.aseq[w] & cond(d_a, ls.ad1[w], ls.ad0[w]) & cond(ci_before, ls.ac1[w], ls.ac0[w]);
+                        Word done = 0;
+                        for (size_t k = L; k >= 1; --k) {
+                            const Word nk = (k == 1 ? start : pa[(k - 1) * W + w]) & ls.match[((k - 1) * OP_CODE_NUM + code) * W + w];
+                            pa[k * W + w] = nk;
+                            done |= nk & ls.len_is[k * W + w];
+                        }
+                        done &= cond_f(fv, ls.vd1[w], ls.vd0[w]) & cond(ci[vb.row], ls.vc1[w], ls.vc0[w]);
+                        apply_fd(fv, done, w);
+                        fired |= done != 0;
+                    }
+                }
+                if (op.kind == OpKind::Write) set_d(a, op.value == Val::One);
+
+                if (!has_state) continue;
+                // Read 且沒有 fault 效應時 D / Ci 都沒變，不必重算
+                if (op.kind != OpKind::Read || fired) settle_around(a, ls.state, true);
+                if (!has_joint) continue;
+                for (size_t c = 0; c < n_changed; ++c)
+                    for (size_t col = 0; col < M; ++col) settle_around(Cell{changed[c] * M + col, changed[c], col}, joint, false);
+            }
+        }
+    }
+    return det;
+}
+
+inline ArraySimulationResult ArrayFaultSimulator::simulate(const MarchTest& mt) const {
+    ArraySimulationResult out;
+    out.lanes = lane_results_;
+    // 每個 (LaneSet, 初值) 一個 task
+    vector<const LaneSet*> sets;
+    for (const LaneSet& ls : sets_) if (!ls.results.empty()) sets.push_back(&ls);
+    vector<vector<Word>> dets(sets.size() * 2);
+    auto task = [&](size_t b, size_t e, size_t) {
+        for (size_t t = b; t < e; ++t) dets[t] = run(mt, *sets[t / 2], t % 2 == 1);
+    };
+    if (pool_) pool_->parallel_for(dets.size(), dets.size(), task);
+    else task(0, dets.size(), 0);
+
+    const size_t N = geo_.rows * geo_.cols;
+    for (size_t s = 0; s < sets.size(); ++s) {
+        const LaneSet& ls = *sets[s];
+        const vector<Word>& d0 = dets[2 * s];
+        const vector<Word>& d1 = dets[2 * s + 1];
+        vector<size_t> detected(ls.words * LANE_BITS, 0);
+        size_t positions = 0;
+        for (size_t v = 0; v < N; ++v) {
+            Cell g;
+            if (ls.offset != None && !aggressor_of(ls.offset, Cell{v, v / geo_.cols, v % geo_.cols}, g)) continue;
+            ++positions;
+            for (size_t w = 0; w < ls.words; ++w)
+                for (Word both = d0[v * ls.words + w] & d1[v * ls.words + w]; both; both &= both - 1)
+                    ++detected[w * LANE_BITS + __builtin_ctzll(both)];
+        }
+        for (size_t lane = 0; lane < ls.results.size(); ++lane) {
+            out.lanes[ls.results[lane]].positions = positions;
+            out.lanes[ls.results[lane]].detected = detected[lane];
+        }
+    }
+
+    // fault coverage：(fp, group) 的所有擺法都全偵測，該 group 才算
+    out.fault_coverage.assign(faults_.size(), 0.0);
+    vector<vector<uint8_t>> fp_ok(faults_.size());
+    for (size_t fi = 0; fi < faults_.size(); ++fi) fp_ok[fi].assign(faults_[fi].primitives.size() * 3, 1);
+    for (const ArrayLaneResult& r : out.lanes)
+        if (!r.fully_detected()) fp_ok[r.fault_index][r.fp_index * 3 + static_cast<size_t>(r.group)] = 0;
+    vector<array<bool, 3>> hit(faults_.size(), array<bool, 3>{false, false, false});
+    for (const ArrayLaneResult& r : out.lanes)
+        if (fp_ok[r.fault_index][r.fp_index * 3 + static_cast<size_t>(r.group)]) hit[r.fault_index][static_cast<size_t>(r.group)] = true;
+    double sum = 0.0;
+    for (size_t fi = 0; fi < faults_.size(); ++fi) {
+        const auto& h = hit[fi];
+        if (faults_[fi].cell_scope == CellScope::SingleCell) out.fault_coverage[fi] = h[0] ? 1.0 : 0.0;
+        else out.fault_coverage[fi] = (h[1] ? 0.5 : 0.0) + (h[2] ? 0.5 : 0.0);
+        sum += out.fault_coverage[fi];
+    }
+    out.total_coverage = faults_.empty() ? 0.0 : sum / faults_.size();
+    return out;
+}
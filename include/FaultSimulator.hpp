@@ -9,9 +9,15 @@
 #include <array>
 #include <unordered_map>
 #include <unordered_set>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+#include <string_view>
+#include <cctype>
 
 #include <nlohmann/json.hpp>
 #include "FpParserAndTpGen.hpp" // reuse Op/Val/OpKind
+#include "ThreadPool.hpp"
 
 // ---- precise using ----
 using std::string;
@@ -22,11 +28,15 @@ using std::size_t;
 using std::optional;
 using std::array;
 using std::uint8_t;
+using std::uint16_t;
+using std::int32_t;
+using std::uint64_t;
 using std::unordered_map;
 using std::pair;
 using std::to_string;
 using std::max;
 using std::unordered_set;
+using std::string_view;
 
 struct RawMarchTest {
     string name;
@@ -66,142 +76,123 @@ struct MarchTest {
     vector<MarchElement> elements;
 };
 
-class MarchTestNormalizer {
+// ---- March pattern parser（string_view）----
+// 格式：元素以 ';' 分隔（空元素略過）；元素 = 位址順序 [aA|dD|bB] + "(op, op, ...)"（括號可省略）；
+// op = R0 | R1 | W0 | W1 | C(t)(m)(b)，t/m/b ∈ {0,1}；任何位置的空白都忽略，op 清單可有結尾逗號。
+// 直接在輸入上掃描、不切出暫存字串；out.elements 既有元素（含 ops 容量）會被重複利用，
+// 所以同一個 MarchTest 反覆 parse 大量 pattern 時不會重配記憶體。
+// MarchTestNormalizer、MarchJsonRunner 與 Qt 的 MarchModel 都走這一份
+class MarchPatternParser {
 public:
-    // Parse a pattern string into a list of MarchElements
-    MarchTest normalize(const RawMarchTest& raw);
+    // 失敗丟 runtime_error（訊息含出錯的欄位）
+    static void parse(string_view pattern, MarchTest& out);
+    // 不丟例外版：失敗回 false，err 非空時填原因；out 內容此時不保證
+    static bool try_parse(string_view pattern, MarchTest& out, string* err = nullptr);
+
 private:
-    // helpers used by normalize()
-    string remove_all_space(const string& s);
-    // split pattern by ';' into element tokens
-    vector<string> split_elements(const string& pattern);
-    // extract address/order info from an element token (modifies token to remove the address part)
-    // returns AddrOrder::Any if no explicit order found
-    AddrOrder extract_addr_order(string& element_token);
-    // remove surrounding parentheses from a token, if present
-    string remove_parentheses(const string& token);
-    // split an element (after addr removed and parens stripped) by ',' into operation tokens
-    vector<string> split_ops(const string& element_body);
-    // parse a single operation token into an Op (may throw on invalid token)
-    Op parse_op_token(const string& op_token);
+    // 成功回 nullptr；失敗回錯誤描述（字串常數），pos 為出錯位置
+    static const char* parse_elements(string_view pattern, vector<MarchElement>& elements, size_t& pos);
+    static string describe(string_view pattern, const char* what, size_t pos);
 };
 
-inline MarchTest MarchTestNormalizer::normalize(const RawMarchTest& raw) {
-    MarchTest out;
-    out.name = raw.name;
-    string pattern = remove_all_space(raw.pattern);
-    auto element_tokens = split_elements(pattern);
-    for (auto& etok : element_tokens) {
-        if (etok.empty()) continue;
-        AddrOrder order = extract_addr_order(etok);
-        etok = remove_parentheses(etok);
-        auto op_tokens = split_ops(etok);
-        MarchElement me;
+inline const char* MarchPatternParser::parse_elements(string_view s, vector<MarchElement>& elements, size_t& i) {
+    i = 0;
+    auto peek = [&]() -> int {
+        while (i < s.size() && isspace(static_cast<unsigned char>(s[i]))) ++i;
+        return i < s.size() ? static_cast<unsigned char>(s[i]) : -1;
+    };
+    auto bit = [&](Val& v) {
+        int c = peek();
+        if (c != '0' && c != '1') return false;
+        v = (c == '1') ? Val::One : Val::Zero; ++i;
+        return true;
+    };
+    size_t ne = 0;
+    for (int c = peek(); c >= 0; c = peek()) {
+        if (c == ';') { ++i; continue; }
+        AddrOrder order;
+        if (c == 'a' || c == 'A') order = AddrOrder::Up;
+        else if (c == 'd' || c == 'D') order = AddrOrder::Down;
+        else if (c == 'b' || c == 'B') order = AddrOrder::Any;
+        else return "invalid or missing address order";
+        ++i;
+        if (ne == elements.size()) elements.emplace_back();
+        MarchElement& me = elements[ne++];
         me.order = order;
-        for (const auto& ot : op_tokens) {
-            Op op = parse_op_token(ot);
-            me.ops.push_back(op);
+        me.ops.clear();
+
+        const bool paren = peek() == '(';
+        if (paren) ++i;
+        auto at_end = [&](int k) { return paren ? k == ')' : (k == ';' || k < 0); };
+        if (!at_end(peek())) {
+            for (;;) {
+                Op op{OpKind::Read};
+                int k = peek();
+                if (k == 'R' || k == 'W') {
+                    ++i;
+                    op.kind = (k == 'R') ? OpKind::Read : OpKind::Write;
+                    if (!bit(op.value)) return "expect 0/1 after R/W";
+                } else if (k == 'C') {
+                    ++i;
+                    op.kind = OpKind::ComputeAnd;
+                    for (Val* v : {&op.C_T, &op.C_M, &op.C_B}) {
+                        if (peek() != '(') return "malformed compute op, expect C(t)(m)(b)";
+                        ++i;
+                        if (!bit(*v)) return "compute operand must be 0/1";
+                        if (peek() != ')') return "malformed compute op, expect C(t)(m)(b)";
+                        ++i;
+                    }
+                } else if (k == ',') {
+                    return "empty operation token";
+                } else {
+                    return "unknown operation";
+                }
+                me.ops.push_back(op);
+                if (peek() != ',') break;
+                ++i;
+                if (at_end(peek())) break; // 結尾逗號
+            }
+        }
+        if (paren) {
+            if (peek() != ')') return "expect ',' or ')'";
+            ++i;
         }
-        out.elements.push_back(me);
+        int k = peek();
+        if (k >= 0 && k != ';') return paren ? "unexpected character after ')'" : "expect ',' or ';'";
     }
-    return out;
+    elements.resize(ne);
+    return nullptr;
 }
 
-inline string MarchTestNormalizer::remove_all_space(const string& s) {
-    string out;
-    for (char c : s) {
-        if (!isspace(static_cast<unsigned char>(c))) out += c;
-    }
-    return out;
+inline string MarchPatternParser::describe(string_view pattern, const char* what, size_t pos) {
+    return "March pattern: " + string(what) + " at column " + to_string(pos + 1) + " in '" + string(pattern) + "'";
 }
 
-inline vector<string> MarchTestNormalizer::split_elements(const string& pattern) {
-    vector<string> out;
-    string cur; 
-    cur.reserve(pattern.size());
-    for (char c : pattern) {
-        if (c == ';') {
-            out.push_back(cur);
-            cur.clear();
-        } else {
-            cur.push_back(c);
-        }
-    }
-    if (!cur.empty()) out.push_back(cur);
-    return out;
+inline void MarchPatternParser::parse(string_view pattern, MarchTest& out) {
+    size_t pos = 0;
+    if (const char* what = parse_elements(pattern, out.elements, pos)) throw runtime_error(describe(pattern, what, pos));
 }
 
-inline AddrOrder MarchTestNormalizer::extract_addr_order(string& element_token) {
-    if (element_token.size() >= 1) {
-        char c = element_token[0];
-        element_token = element_token.substr(1);
-        if (c == 'b' || c == 'B') {
-            return AddrOrder::Any;
-        } else if (c == 'a' || c == 'A') {
-            return AddrOrder::Up;
-        } else if (c == 'd' || c == 'D') {
-            return AddrOrder::Down;
-        }
-    }
-    throw runtime_error("extract_addr_order: invalid or missing address order in element token: '" + element_token + "'");
-    return AddrOrder::Any; // default
+inline bool MarchPatternParser::try_parse(string_view pattern, MarchTest& out, string* err) {
+    size_t pos = 0;
+    const char* what = parse_elements(pattern, out.elements, pos);
+    if (what && err) *err = describe(pattern, what, pos);
+    return what == nullptr;
 }
 
-inline string MarchTestNormalizer::remove_parentheses(const string& token) {
-    if (token.size() >= 2 && token.front() == '(' && token.back() == ')') {
-        return token.substr(1, token.size() - 2);
-    }
-    return token;
-}
+class MarchTestNormalizer {
+public:
+    // Parse a pattern string into a list of MarchElements（實作在 MarchPatternParser）
+    MarchTest normalize(const RawMarchTest& raw);
+};
 
-inline vector<string> MarchTestNormalizer::split_ops(const string& element_body) {
-    vector<string> out;
-    string cur; 
-    cur.reserve(element_body.size());
-    for (char c : element_body) {
-        if (c == ',') {
-            out.push_back(cur);
-            cur.clear();
-        } else {
-            cur.push_back(c);
-        }
-    }
-    if (!cur.empty()) out.push_back(cur);
+inline MarchTest MarchTestNormalizer::normalize(const RawMarchTest& raw) {
+    MarchTest out;
+    out.name = raw.name;
+    MarchPatternParser::parse(raw.pattern, out);
     return out;
 }
 
-inline Op MarchTestNormalizer::parse_op_token(const string& op_token) {
-    if (op_token.empty()) throw runtime_error("parse_op_token: empty operation token");
-    Op op;
-    if (op_token[0] == 'R') {
-        // Read operation
-        if (op_token.size() != 2 || (op_token[1] != '0' && op_token[1] != '1')) {
-            throw runtime_error("parse_op_token: invalid Read operation token: '" + op_token + "'");
-        }
-        op.kind = OpKind::Read;
-        op.value = (op_token[1] == '0') ? Val::Zero : Val::One;
-    } else if (op_token[0] == 'W') {
-        // Write operation
-        if (op_token.size() != 2 || (op_token[1] != '0' && op_token[1] != '1')) {
-            throw runtime_error("parse_op_token: invalid Write operation token: '" + op_token + "'");
-        }
-        op.kind = OpKind::Write;
-        op.value = (op_token[1] == '0') ? Val::Zero : Val::One;
-    } else if (op_token[0] == 'C') {
-        // Compute operation
-        if (op_token.size() < 9) {
-            throw runtime_error("parse_op_token: invalid Compute operation token: '" + op_token + "'");
-        }
-        op.kind = OpKind::ComputeAnd;
-        op.C_T = (op_token[2] == '0') ? Val::Zero : Val::One;
-        op.C_M = (op_token[5] == '0') ? Val::Zero : Val::One;
-        op.C_B = (op_token[8] == '0') ? Val::Zero : Val::One;
-    } else {
-        throw runtime_error("parse_op_token: unknown operation type in token: '" + op_token + "'");
-    }
-    return op;
-}
-
 const int KEY_BIT = 6;
 const int CSS_EXPANDED_NUM = 729; // 3^6
 
@@ -218,42 +209,81 @@ inline size_t encode_to_key(const CrossState& input) {
     return key; // 0..728
 }
 
-class CoverLUT {
-public:
-    CoverLUT();
-    const vector<size_t>& get_compatible_tp_keys(const CrossState& op_css) const;
-    const vector<size_t>& get_compatible_tp_keys_by_key(size_t op_css_key) const { return compatible_tp_keys[op_css_key]; }
-private:
-    vector<size_t> compatible_tp_keys[CSS_EXPANDED_NUM]; // for each store key, which input keys are compatible
+// encode_to_key 的反函數。pre_state 都經過 enforceDCrule（A0.D=A1.D、A4.D=A3.D、A1.C=A2.C=A3.C），
+// 所以 6 位 key 足以還原完整 CrossState。
+inline CrossState decode_from_key(size_t key) {
+    auto valfrom3 = [](size_t d){ return d==0 ? Val::Zero : d==1 ? Val::One : Val::X; };
+    CrossState s;
+    s.A4.C = valfrom3(key % KEY_CARRY); key /= KEY_CARRY;
+    s.A2_CAS.C = valfrom3(key % KEY_CARRY); key /= KEY_CARRY;
+    s.A0.C = valfrom3(key % KEY_CARRY); key /= KEY_CARRY;
+    s.A3.D = valfrom3(key % KEY_CARRY); key /= KEY_CARRY;
+    s.A2_CAS.D = valfrom3(key % KEY_CARRY); key /= KEY_CARRY;
+    s.A1.D = valfrom3(key % KEY_CARRY);
+    s.A0.D = s.A1.D;
+    s.A4.D = s.A3.D;
+    s.A1.C = s.A3.C = s.A2_CAS.C;
+    return s;
+}
+
+// 729x729 相容表改為編譯期產生的 CSR：
+//   offsets[op_key] .. offsets[op_key+1] 是 keys 內與該 op key 相容的 tp key（遞增排列）。
+// 每一位：op 為 0/1 時 tp 可取 {同值, 2}；op 為 2 時 tp 只能是 2 → 總數 (2+2+1)^6 = 5^6。
+const int CSS_COMPAT_PAIRS = 15625; // 5^6
+
+struct CoverLUTTables {
+    array<uint16_t, CSS_EXPANDED_NUM + 1> offsets{};
+    array<uint16_t, CSS_COMPAT_PAIRS> keys{};
 };
 
-inline CoverLUT::CoverLUT() {
-    size_t decoded_key[CSS_EXPANDED_NUM][KEY_BIT];
-    for (int key=0; key<CSS_EXPANDED_NUM; ++key) {
-        int k=key;
-        for (int i=KEY_BIT-1; i>=0; --i){ decoded_key[key][i]=k%3; k/=3; }
-    }
-    // 我們要支援：輸入 op_css_key -> 回傳所有 "tp_key"（可被覆蓋的 TP）
+constexpr CoverLUTTables make_cover_lut_tables() {
+    CoverLUTTables t{};
+    int n = 0;
     for (int op_css = 0; op_css < CSS_EXPANDED_NUM; ++op_css) {
-        for (int tp = 0; tp < CSS_EXPANDED_NUM; ++tp) {
-            bool compatible = true;
-            for (int k=0;k<KEY_BIT;++k){
-                // TP 位元是 0/1 則必須相等；TP 位元 2 表 don’t care
-                if (decoded_key[tp][k] != 2 && decoded_key[tp][k] != decoded_key[op_css][k]) {
-                    compatible = false; break;
-                }
-            }
-            if (compatible) {
-                // 注意：索引要用 op_css，內容塞進「tp_key」
-                compatible_tp_keys[op_css].push_back(tp);
+        t.offsets[op_css] = static_cast<uint16_t>(n);
+        int digit[KEY_BIT] = {};
+        for (int i = KEY_BIT - 1, k = op_css; i >= 0; --i) { digit[i] = k % KEY_CARRY; k /= KEY_CARRY; }
+        // 逐位選「同值」或「2」，以里程表方式（最低位先進位）列舉即為遞增順序
+        int choice[KEY_BIT] = {};
+        for (;;) {
+            int tp = 0;
+            for (int i = 0; i < KEY_BIT; ++i) tp = tp * KEY_CARRY + (choice[i] == 0 ? digit[i] : 2);
+            t.keys[n++] = static_cast<uint16_t>(tp);
+            int i = KEY_BIT - 1;
+            for (; i >= 0; --i) {
+                int last_choice = (digit[i] == 2) ? 0 : 1; // op 為 2 時只有一種選擇
+                if (choice[i] < last_choice) { ++choice[i]; break; }
+                choice[i] = 0;
             }
+            if (i < 0) break;
         }
     }
+    t.offsets[CSS_EXPANDED_NUM] = static_cast<uint16_t>(n);
+    return t;
 }
 
-inline const vector<size_t>& CoverLUT::get_compatible_tp_keys(const CrossState& op_css) const {
-    return compatible_tp_keys[encode_to_key(op_css)];
-}
+inline constexpr CoverLUTTables COVER_LUT_TABLES = make_cover_lut_tables();
+static_assert(COVER_LUT_TABLES.offsets[CSS_EXPANDED_NUM] == CSS_COMPAT_PAIRS, "CoverLUT CSR size mismatch");
+
+// 一段相容 tp key 的唯讀範圍（指向 COVER_LUT_TABLES）
+struct TpKeySpan {
+    const uint16_t* first{nullptr};
+    const uint16_t* last{nullptr};
+    const uint16_t* begin() const { return first; }
+    const uint16_t* end() const { return last; }
+    size_t size() const { return static_cast<size_t>(last - first); }
+    bool empty() const { return first == last; }
+};
+
+// 相容表存於靜態唯讀區，所有實例／執行緒共用；建構沒有任何成本
+class CoverLUT {
+public:
+    static TpKeySpan get_compatible_tp_keys(const CrossState& op_css) { return get_compatible_tp_keys_by_key(encode_to_key(op_css)); }
+    static TpKeySpan get_compatible_tp_keys_by_key(size_t op_css_key) {
+        const auto& t = COVER_LUT_TABLES;
+        return TpKeySpan{t.keys.data() + t.offsets[op_css_key], t.keys.data() + t.offsets[op_css_key + 1]};
+    }
+};
 
 // ==============================
 //  March-based Fault Simulator (OP-driven + 729x729 LUT)
@@ -276,94 +306,298 @@ struct OpContext {
     OpId head_next{-1}; // index of first op in the next element, or -1 if last
 };
 
+// ---------- Op 的 1-byte 編碼 ----------
+// Write: value；Read: 3 + value；Compute: 6 + 9*T + 3*M + B（各值 0/1/X → 0/1/2），共 33 種。
+// 只保留該 kind 會用到的欄位；TP 端的 X 代表 don't care。
+using OpCode = uint8_t;
+const int OP_CODE_NUM = 33;
+
+inline OpCode encode_op(const Op& op) {
+    auto valto3 = [](Val v){ return (v==Val::Zero) ? 0 : (v==Val::One) ? 1 : 2; };
+    switch (op.kind) {
+        case OpKind::Write:      return static_cast<OpCode>(valto3(op.value));
+        case OpKind::Read:       return static_cast<OpCode>(3 + valto3(op.value));
+        case OpKind::ComputeAnd: return static_cast<OpCode>(6 + 9 * valto3(op.C_T) + 3 * valto3(op.C_M) + valto3(op.C_B));
+    }
+    throw runtime_error("encode_op: unknown op kind");
+}
+
+inline OpKind op_code_kind(OpCode c) { return c < 3 ? OpKind::Write : c < 6 ? OpKind::Read : OpKind::ComputeAnd; }
+
+inline Op decode_op(OpCode c) {
+    auto valfrom3 = [](int d){ return d==0 ? Val::Zero : d==1 ? Val::One : Val::X; };
+    Op op;
+    op.kind = op_code_kind(c);
+    if (op.kind == OpKind::ComputeAnd) {
+        int v = c - 6;
+        op.C_T = valfrom3(v / 9);
+        op.C_M = valfrom3(v / 3 % 3);
+        op.C_B = valfrom3(v % 3);
+    } else {
+        op.value = valfrom3(c % 3);
+    }
+    return op;
+}
+
+// ---------- MarchTest 的 128-bit 正規雜湊 ----------
+// 只看 element 數、每個 element 的 order / op 數與 encode_op 碼（名字不算），
+// 所以不同 template 展開出同一串 op、或不同 beam 路徑走到同一個 test 時雜湊相同。
+// 兩條 64-bit 線各自混合，可逐個 element 累加（前綴的 hasher 複製一份再 add 即可）。
+struct MarchTestHash {
+    uint64_t lo{0}, hi{0};
+    bool operator==(const MarchTestHash& o) const { return lo == o.lo && hi == o.hi; }
+    bool operator!=(const MarchTestHash& o) const { return !(*this == o); }
+};
+
+struct MarchTestHashHasher {
+    size_t operator()(const MarchTestHash& h) const { return (size_t)(h.lo ^ (h.hi * 0x9e3779b97f4a7c15ULL)); }
+};
+
+class MarchTestHasher {
+public:
+    void add(const MarchElement& e) {
+        // 每 8 個 op 碼打包成一個 word；第一個 word 帶 order 與 op 數
+        uint64_t w = (uint64_t)e.order | ((uint64_t)e.ops.size() << 2);
+        feed(w);
+        w = 0;
+        for (size_t i = 0; i < e.ops.size(); ++i) {
+            w |= (uint64_t)encode_op(e.ops[i]) << (8 * (i & 7));
+            if ((i & 7) == 7) { feed(w); w = 0; }
+        }
+        if (e.ops.size() & 7) feed(w);
+        ++count_;
+    }
+    MarchTestHash digest() const {
+        return MarchTestHash{mix(a_ ^ count_), mix(b_ + count_ * 0xd6e8feb86659fd93ULL)};
+    }
+
+private:
+    uint64_t a_{0x243f6a8885a308d3ULL}, b_{0x13198a2e03707344ULL};
+    uint64_t count_{0};
+
+    static uint64_t mix(uint64_t x) { // splitmix64 finalizer
+        x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+    void feed(uint64_t w) {
+        a_ = mix(a_ ^ w) + 0x9e3779b97f4a7c15ULL;
+        b_ = mix(b_ + (w ^ 0xc2b2ae3d27d4eb4fULL)) ^ (b_ >> 29);
+    }
+};
+
+inline MarchTestHash hash_march_test(const MarchTest& mt) {
+    MarchTestHasher h;
+    for (const auto& e : mt.elements) h.add(e);
+    return h.digest();
+}
+
+// [pattern][op]：pattern（TP 端，可含 X）是否匹配 march test 的 op；語意同逐欄位比對
+struct OpMatchTable {
+    array<array<bool, OP_CODE_NUM>, OP_CODE_NUM> m{};
+};
+
+constexpr OpMatchTable make_op_match_table() {
+    OpMatchTable t{};
+    for (int p = 0; p < OP_CODE_NUM; ++p) {
+        for (int o = 0; o < OP_CODE_NUM; ++o) {
+            int pk = p < 3 ? 0 : p < 6 ? 1 : 2;
+            int ok = o < 3 ? 0 : o < 6 ? 1 : 2;
+            if (pk != ok) continue; // 不同 kind
+            int pv = pk == 2 ? p - 6 : p % 3;
+            int ov = ok == 2 ? o - 6 : o % 3;
+            bool match = true;
+            for (int f = 0; f < (pk == 2 ? 3 : 1); ++f, pv /= 3, ov /= 3) {
+                if (pv % 3 != 2 && pv % 3 != ov % 3) match = false;
+            }
+            t.m[p][o] = match;
+        }
+    }
+    return t;
+}
+
+inline constexpr OpMatchTable OP_MATCH_TABLE = make_op_match_table();
+
+inline bool op_code_match(OpCode pattern, OpCode op) { return OP_MATCH_TABLE.m[pattern][op]; }
+
+// ---------- Op table（structure of arrays）----------
+// Sens/Detect/StateCover 的內層迴圈只讀 op 編碼、state key 與鄰接索引，各存成連續陣列；
+// 需要完整 OpContext（含 CrossState）的報表經由 operator[] 即時組出（by value）。
+// 另附「自 i 起下一個 Write / 下一個匹配某 detector pattern 的 op」索引，
+// 讓 DetectEngine 的往後掃描變成 O(1) 查表。
+class OpTable {
+public:
+    // detector pattern 只會是 Read / Compute（編碼 3..32）
+    static constexpr int DET_PATTERN_BASE = 3;
+    static constexpr int DET_PATTERN_NUM = OP_CODE_NUM - DET_PATTERN_BASE;
+
+    size_t size() const { return code_.size(); }
+    bool empty() const { return code_.empty(); }
+    void clear() { resize(0); }
+    void resize(size_t n) {
+        code_.resize(n); key_.resize(n); order_.resize(n);
+        elem_.resize(n); idx_in_elem_.resize(n); next_.resize(n); head_same_.resize(n); head_next_.resize(n);
+        next_write_.resize(n); next_det_.resize(n * DET_PATTERN_NUM);
+    }
+
+    OpCode code(OpId i) const { return code_[i]; }
+    size_t state_key(OpId i) const { return key_[i]; }
+    int elem_index(OpId i) const { return elem_[i]; }
+    int index_within_elem(OpId i) const { return idx_in_elem_[i]; }
+    AddrOrder order(OpId i) const { return static_cast<AddrOrder>(order_[i]); }
+    OpId next_op_index(OpId i) const { return next_[i]; }
+    OpId head_same(OpId i) const { return head_same_[i]; }
+    OpId head_next(OpId i) const { return head_next_[i]; }
+    Op op(OpId i) const { return decode_op(code_[i]); }
+    CrossState pre_state(OpId i) const { return decode_from_key(key_[i]); }
+    // [i, size) 內第一個 Write；沒有則 -1
+    OpId next_write(OpId i) const { return next_write_[i]; }
+    // [i, size) 內第一個被 pattern 匹配的 op；pattern 為 Write 時恆為 -1
+    OpId next_detect(OpId i, OpCode pattern) const {
+        if (pattern < DET_PATTERN_BASE) return -1;
+        return next_det_[(size_t)i * DET_PATTERN_NUM + (pattern - DET_PATTERN_BASE)];
+    }
+
+    // 報表用的完整檢視
+    OpContext operator[](size_t i) const {
+        OpId id = (OpId)i;
+        OpContext oc;
+        oc.op = op(id);
+        oc.elem_index = elem_[i];
+        oc.index_within_elem = idx_in_elem_[i];
+        oc.order = order(id);
+        oc.pre_state = pre_state(id);
+        oc.pre_state_key = key_[i];
+        oc.next_op_index = next_[i];
+        oc.head_same = head_same_[i];
+        oc.head_next = head_next_[i];
+        return oc;
+    }
+    OpContext back() const { return (*this)[size() - 1]; }
+
+private:
+    friend class OpTableBuilder;
+    vector<OpCode> code_;
+    vector<uint16_t> key_;         // pre_state key（0..728）
+    vector<uint8_t> order_;        // AddrOrder
+    vector<int32_t> elem_;
+    vector<int32_t> idx_in_elem_;
+    vector<int32_t> next_;         // 同 element 的下一個 op，-1 表最後一個
+    vector<int32_t> head_same_;
+    vector<int32_t> head_next_;
+    vector<int32_t> next_write_;
+    vector<int32_t> next_det_;     // [op * DET_PATTERN_NUM + (pattern - DET_PATTERN_BASE)]
+};
+
 class OpTableBuilder {
 public:
-    vector<OpContext> build(const MarchTest& mt);
+    OpTable build(const MarchTest& mt);
+    // 增量用：僅重建 elements[first_elem..] 的 op 列，之前的列與哨兵保持不變
+    // （前綴的哨兵只依賴自身與更早的 element，故 append 不會改變它們）
+    void rebuild_tail(const MarchTest& mt, OpTable& opt, int first_elem);
 private:
     vector<Val> D2_sentinel; // per element, D2 at start of element
     vector<array<Val,3>> C_sentinel; // per element, (C0,C2,C4) at start of element
     vector<AddrOrder> elem_orders; // cache element orders for derive stage
 
     // 1) 平展：填 elem_of/j_of/op/order，並產生每個 element 的 head id（空 element 設為 -1）
-    void flatten(const MarchTest& mt, vector<OpContext>& opt) const;
+    void flatten(const MarchTest& mt, OpTable& opt, int first_elem, int first_op) const;
 
-    // 2) 建 #/^/; 三種鄰接跳點
-    void build_neighbors(const MarchTest& mt, vector<OpContext>& opt) const;
+    // 2) 建 #/^/; 三種鄰接跳點（並補上前一個非空 element 指向新 head 的 ;）
+    void build_neighbors(const MarchTest& mt, OpTable& opt, int first_elem, int first_op) const;
 
     // 3) 計算每個 element 的 D2 哨兵
-    void build_D2_sentinels(const MarchTest& mt);
+    void build_D2_sentinels(const MarchTest& mt, int first_elem);
 
     // 4) 計算每個 element 的 C 哨兵（同列不變；跨列平移暫不實作）
     //    若該 element 有 ComputeAnd，取其「最後一個」(T,M,B) 作為 (C0,C2,C4)；
     //    否則 (C0=C2=C4= 上一 element 的 C2；若無上一 element → X)。
-    void build_C_sentinels(const MarchTest& mt);
+    void build_C_sentinels(const MarchTest& mt, int first_elem);
 
     // 5) 逐 OP 推導 pre state, 不做跨列平移
-    void derive_pre_state_in_same_row(vector<OpContext>& opt) const;
+    void derive_pre_state_in_same_row(OpTable& opt, int first_op) const;
+
+    // 6) 由後往前建 next Write / next detector 索引；前綴只補原本指向表尾之後（或 -1）的列
+    void build_next_index(OpTable& opt, int first_op) const;
 };
 
-inline vector<OpContext> OpTableBuilder::build(const MarchTest& mt){
-    vector<OpContext> opt;
+inline OpTable OpTableBuilder::build(const MarchTest& mt){
+    OpTable opt;
+    rebuild_tail(mt, opt, 0);
+    return opt;
+}
+
+inline void OpTableBuilder::rebuild_tail(const MarchTest& mt, OpTable& opt, int first_elem){
+    int first_op = 0;
+    for (int i = 0; i < first_elem; ++i) first_op += (int)mt.elements[i].ops.size();
     // 1) 平展
-    flatten(mt, opt);
+    flatten(mt, opt, first_elem, first_op);
     // 2) 鄰接 (#/^/;)
-    build_neighbors(mt, opt);
+    build_neighbors(mt, opt, first_elem, first_op);
     // 3) D2 哨兵
-    build_D2_sentinels(mt);
+    build_D2_sentinels(mt, first_elem);
     // 4) C 哨兵
-    build_C_sentinels(mt);
+    build_C_sentinels(mt, first_elem);
     // cache element orders
-    elem_orders.clear(); elem_orders.reserve(mt.elements.size());
-    for(const auto& e: mt.elements) elem_orders.push_back(e.order);
+    elem_orders.resize(mt.elements.size());
+    for (size_t i = first_elem; i < mt.elements.size(); ++i) elem_orders[i] = mt.elements[i].order;
     // 5) 推導 pre state（同列）
-    derive_pre_state_in_same_row(opt);
-    return opt;
+    derive_pre_state_in_same_row(opt, first_op);
+    // 6) next Write / detector 索引
+    build_next_index(opt, first_op);
 }
 
-inline void OpTableBuilder::flatten(const MarchTest& mt, vector<OpContext>& opt) const {
+inline void OpTableBuilder::flatten(const MarchTest& mt, OpTable& opt, int first_elem, int first_op) const {
     int totalElems = mt.elements.size();
-    int total = 0;
-    for (const auto& e : mt.elements) total += (int)e.ops.size();
+    int total = first_op;
+    for (int i = first_elem; i < totalElems; ++i) total += (int)mt.elements[i].ops.size();
     opt.resize(total);
 
-    int id = 0;
-    for (int i = 0; i < totalElems; ++i) {
+    int id = first_op;
+    for (int i = first_elem; i < totalElems; ++i) {
         const auto& elem = mt.elements[i];
         if (elem.ops.empty()) continue;
         for (int j = 0; j < (int)elem.ops.size(); ++j, ++id) {
-            opt[id].elem_index = i;
-            opt[id].index_within_elem = j;
-            opt[id].op = elem.ops[j];
-            opt[id].order = elem.order;
+            opt.code_[id] = encode_op(elem.ops[j]);
+            opt.key_[id] = 0;
+            opt.order_[id] = static_cast<uint8_t>(elem.order);
+            opt.elem_[id] = i;
+            opt.idx_in_elem_[id] = j;
+            opt.next_[id] = opt.head_same_[id] = opt.head_next_[id] = -1;
         }
     } 
 }
 
-inline void OpTableBuilder::build_neighbors(const MarchTest& mt, vector<OpContext>& opt) const {
+inline void OpTableBuilder::build_neighbors(const MarchTest& mt, OpTable& opt, int first_elem, int first_op) const {
     int totalElems = mt.elements.size();
     int totalOps = opt.size();
-    int id = 0;
-    for (int i = 0; i < totalElems; ++i) {
+    // 前一個非空 element 的 ; 原本指向 -1（或已被截掉的 op），改指向新的下一個 head
+    for (int id = first_op - 1; id >= 0 && id >= opt.head_same_[first_op - 1]; --id) {
+        opt.head_next_[id] = (first_op < totalOps) ? first_op : -1;
+    }
+    int id = first_op;
+    for (int i = first_elem; i < totalElems; ++i) {
         const auto& elem = mt.elements[i];
         if (elem.ops.empty()) continue;
         int this_head_id = id;
         int next_head_id = (this_head_id + (int)elem.ops.size() < totalOps) ? (this_head_id + (int)elem.ops.size()) : -1;
         for (int j = 0; j < (int)elem.ops.size(); ++j, ++id) {
             if (j + 1 < (int)elem.ops.size()) {
-                opt[id].next_op_index = id + 1;
+                opt.next_[id] = id + 1;
             } else {
-                opt[id].next_op_index = -1;
+                opt.next_[id] = -1;
             }
-            opt[id].head_same = this_head_id;
-            opt[id].head_next = next_head_id;
+            opt.head_same_[id] = this_head_id;
+            opt.head_next_[id] = next_head_id;
         }
     }
 }
 
-inline void OpTableBuilder::build_D2_sentinels(const MarchTest& mt) {
+inline void OpTableBuilder::build_D2_sentinels(const MarchTest& mt, int first_elem) {
     const int elem_num = (int)mt.elements.size();
-    D2_sentinel.assign(elem_num+1, Val::X);  // D2_sentinel[0] = X
-    for (int i = 0; i < elem_num; ++i) {
+    D2_sentinel.resize(elem_num+1);
+    D2_sentinel[first_elem] = (first_elem > 0) ? D2_sentinel[first_elem-1] : Val::X;  // D2_sentinel[0] = X
+    for (int i = first_elem; i < elem_num; ++i) {
         for (const auto& op : mt.elements[i].ops) { // element 內只需追末值
             if (op.kind == OpKind::Write) D2_sentinel[i] = op.value;
         }
@@ -371,10 +605,10 @@ inline void OpTableBuilder::build_D2_sentinels(const MarchTest& mt) {
     }
 }
 
-inline void OpTableBuilder::build_C_sentinels(const MarchTest& mt) {
+inline void OpTableBuilder::build_C_sentinels(const MarchTest& mt, int first_elem) {
     const int elem_num = (int)mt.elements.size();
-    C_sentinel.assign(elem_num, array<Val,3>{Val::X, Val::X, Val::X}); // 預設全 X
-    for (int i = 0; i < elem_num; ++i) {
+    C_sentinel.resize(elem_num, array<Val,3>{Val::X, Val::X, Val::X}); // 預設全 X
+    for (int i = first_elem; i < elem_num; ++i) {
         Val C0 = (i > 0) ? C_sentinel[i-1][1] : Val::X; // 承前 C2
         Val C2 = C0;
         Val C4 = C0;
@@ -389,14 +623,14 @@ inline void OpTableBuilder::build_C_sentinels(const MarchTest& mt) {
     }
 }
 
-inline void OpTableBuilder::derive_pre_state_in_same_row(vector<OpContext>& opt) const {
-    if(opt.empty()) return;
+inline void OpTableBuilder::derive_pre_state_in_same_row(OpTable& opt, int first_op) const {
+    if((int)opt.size() <= first_op) return;
     // 需要能反查 element 的第一個 op id：掃一次建立
     // 也需要 element 的最後一個 op id 以便在本 element 的最後寫入 D2 哨兵與 C 哨兵演進
     struct ElemRange { int first{-1}; int last{-1}; };
-    int maxElem = 0; for(const auto& oc: opt) if(oc.elem_index+1>maxElem) maxElem = oc.elem_index+1;
+    int maxElem = opt.elem_[opt.size() - 1] + 1;
     std::vector<ElemRange> ranges(maxElem);
-    for(int i=0;i<(int)opt.size();++i){ auto e=opt[i].elem_index; if(ranges[e].first==-1) ranges[e].first=i; ranges[e].last=i; }
+    for(int i=first_op;i<(int)opt.size();++i){ auto e=opt.elem_[i]; if(ranges[e].first==-1) ranges[e].first=i; ranges[e].last=i; }
 
     // 先準備一個工作 cross state
     // 根據規則：
@@ -413,7 +647,7 @@ inline void OpTableBuilder::derive_pre_state_in_same_row(vector<OpContext>& opt)
     auto getCSent = [&](int elem)->array<Val,3> { return C_sentinel[elem]; }; // 本 element 開頭 (C0,C2,C4)
 
     // 建立每個 element 走訪
-    for(int elem=0; elem<maxElem; ++elem){
+    for(int elem=opt.elem_[first_op]; elem<maxElem; ++elem){
         if(ranges[elem].first==-1) continue; // 空 element 已被跳過
         Val baseD2_up   = getD2Sent(elem);
         Val baseD2_prev = getPrevD2Sent(elem);
@@ -429,17 +663,18 @@ inline void OpTableBuilder::derive_pre_state_in_same_row(vector<OpContext>& opt)
         // element 內逐 op
         for(int id = ranges[elem].first; id <= ranges[elem].last; ++id){
             // 填 pre_state (before this op)
-            opt[id].pre_state.A2_CAS.D = curD2; // D2
-            opt[id].pre_state.A1.D = d1_init;   // D1
-            opt[id].pre_state.A3.D = d3_init;   // D3
-            opt[id].pre_state.A0.C = c0;        // C0
-            opt[id].pre_state.A2_CAS.C = c2;    // C2
-            opt[id].pre_state.A4.C = c4;        // C4
-            opt[id].pre_state.enforceDCrule();
-            // 順手計算 pre_state 的 key 並快取
-            opt[id].pre_state_key = encode_to_key(opt[id].pre_state);
+            CrossState pre;
+            pre.A2_CAS.D = curD2; // D2
+            pre.A1.D = d1_init;   // D1
+            pre.A3.D = d3_init;   // D3
+            pre.A0.C = c0;        // C0
+            pre.A2_CAS.C = c2;    // C2
+            pre.A4.C = c4;        // C4
+            pre.enforceDCrule();
+            // 表內只存 key；完整 CrossState 由 decode_from_key 還原
+            opt.key_[id] = static_cast<uint16_t>(encode_to_key(pre));
             // 遇此 op 之後，更新影響下一 op 的狀態
-            const Op& opv = opt[id].op;
+            const Op opv = opt.op(id);
             if(opv.kind == OpKind::Write){
                 curD2 = opv.value; // 下一 pre D2
                 // 若 order 為 Up 或 Down 不影響 D1/D3 (它們對 element 固定)，故不改
@@ -450,20 +685,67 @@ inline void OpTableBuilder::derive_pre_state_in_same_row(vector<OpContext>& opt)
     }
 }
 
+inline void OpTableBuilder::build_next_index(OpTable& opt, int first_op) const {
+    const int N = (int)opt.size();
+    const int P = OpTable::DET_PATTERN_NUM;
+    for (int i = N - 1; i >= first_op; --i) {
+        const OpCode c = opt.code_[i];
+        const bool last = (i + 1 == N);
+        opt.next_write_[i] = (op_code_kind(c) == OpKind::Write) ? i : (last ? -1 : opt.next_write_[i + 1]);
+        int32_t* row = &opt.next_det_[(size_t)i * P];
+        for (int p = 0; p < P; ++p) {
+            row[p] = OP_MATCH_TABLE.m[p + OpTable::DET_PATTERN_BASE][c] ? i : (last ? -1 : row[p + P]);
+        }
+    }
+    if (first_op <= 0) return;
+    // 前綴：值落在 [0, first_op) 的列仍正確；其餘（-1 或指向舊尾段）改成新尾段起點的值。
+    // 某列全部不變時更早的列也不會變（next 索引對 i 單調）
+    auto tail_of = [&](const vector<int32_t>& col, int stride, int p) -> int32_t {
+        return first_op < N ? col[(size_t)first_op * stride + p] : -1;
+    };
+    auto patch = [&](int32_t& v, int32_t tail) -> bool {
+        if (v >= 0 && v < first_op) return false;
+        if (v == tail) return false;
+        v = tail;
+        return true;
+    };
+    const int32_t w_tail = tail_of(opt.next_write_, 1, 0);
+    for (int i = first_op - 1; i >= 0; --i) {
+        bool changed = patch(opt.next_write_[i], w_tail);
+        int32_t* row = &opt.next_det_[(size_t)i * P];
+        for (int p = 0; p < P; ++p) {
+            changed |= patch(row[p], tail_of(opt.next_det_, P, p));
+        }
+        if (!changed) break;
+    }
+}
+
 using TpGid = size_t; // Test Primitive global ID
+using GroupId = size_t;         // 覆蓋群組 id
+
+// 一段連續 id 的唯讀範圍（不擁有記憶體）
+template <class T>
+struct ConstSpan {
+    const T* first{nullptr};
+    const T* last{nullptr};
+    const T* begin() const { return first; }
+    const T* end() const { return last; }
+    size_t size() const { return static_cast<size_t>(last - first); }
+    bool empty() const { return first == last; }
+};
+using TpSpan = ConstSpan<TpGid>;
 
 class StateCoverEngine {
 public:
     void build_tp_buckets(const vector<TestPrimitive>& tps);
-    vector<TpGid> cover(size_t op_css_key);
+    vector<TpGid> cover(size_t op_css_key) const;
 private:
-    CoverLUT lut;
     array<vector<TpGid>, CSS_EXPANDED_NUM> tp_buckets; // tp_buckets[tp_key] -> list of test pattern indices
 };
 
-inline vector<TpGid> StateCoverEngine::cover(size_t op_css_key) {
+inline vector<TpGid> StateCoverEngine::cover(size_t op_css_key) const {
     vector<TpGid> out;
-    const auto& tp_keys = lut.get_compatible_tp_keys_by_key(op_css_key);
+    TpKeySpan tp_keys = CoverLUT::get_compatible_tp_keys_by_key(op_css_key);
     for (int key : tp_keys) {
         const auto& v = tp_buckets[key];
         out.insert(out.end(), v.begin(), v.end());
@@ -489,12 +771,12 @@ struct SensOutcome {
 class SensEngine {
 public:
     // 成功回傳完成的 op_id；失敗回 -1
-    SensOutcome cover(const vector<OpContext>& opt, OpId opt_begin, const TestPrimitive& tp) const;
+    SensOutcome cover(const OpTable& opt, OpId opt_begin, const TestPrimitive& tp) const;
 private:
-    bool op_match(const OpContext& march_test_op, const Op& tp_op) const;
+    bool op_match(OpCode march_test_op, const Op& tp_op) const { return op_code_match(encode_op(tp_op), march_test_op); }
 };
 
-inline SensOutcome SensEngine::cover(const vector<OpContext>& opt, OpId opt_begin, const TestPrimitive& tp) const {
+inline SensOutcome SensEngine::cover(const OpTable& opt, OpId opt_begin, const TestPrimitive& tp) const {
     const int op_length = static_cast<int>(tp.ops_before_detect.size());
     if (op_length == 0) return {SensOutcome::Status::DontNeedSens, opt_begin, -1}; // 無 sensitizer 序列：不前進、保留 state cover 位置
 
@@ -504,27 +786,184 @@ inline SensOutcome SensEngine::cover(const vector<OpContext>& opt, OpId opt_begi
     if (last < 0 || last >= static_cast<int>(opt.size())) return SensOutcome{};
 
     // 必須都在同一個 element 內
-    if (opt[opt_begin].elem_index != opt[last].elem_index) return SensOutcome{};
+    if (opt.elem_index(opt_begin) != opt.elem_index(last)) return SensOutcome{};
 
     // 逐 op 比對
     for (int i = opt_begin, j = 0; i <= last; ++i, ++j) {
-        if (!op_match(opt[i], tp.ops_before_detect[j])) return SensOutcome{SensOutcome::Status::SensPartial, -1, i}; // 在 op i 被遮蔽
+        if (!op_match(opt.code(i), tp.ops_before_detect[j])) return SensOutcome{SensOutcome::Status::SensPartial, -1, i}; // 在 op i 被遮蔽
     }
     return SensOutcome{SensOutcome::Status::SensAll, last, -1}; // 回傳最後一個成功匹配到的 op 索引
 }
 
-inline bool SensEngine::op_match(const OpContext& march_test_op, const Op& tp_op) const {
-    // march_test_op.op 與 tp_op 比對
-    if (march_test_op.op.kind != tp_op.kind) return false; // 不同 kind
-    if (tp_op.kind == OpKind::Read || tp_op.kind == OpKind::Write) {
-        if (tp_op.value != Val::X && march_test_op.op.value != tp_op.value) return false; // 讀寫值不符 (tp X 可任意
-    } 
-    if (tp_op.kind == OpKind::ComputeAnd) {
-        if (tp_op.C_T != Val::X && march_test_op.op.C_T != tp_op.C_T) return false;
-        if (tp_op.C_M != Val::X && march_test_op.op.C_M != tp_op.C_M) return false;
-        if (tp_op.C_B != Val::X && march_test_op.op.C_B != tp_op.C_B) return false;
+// ---------- 所有 TP 的 sensitizer 序列編成一棵 trie ----------
+// 數千個 TP 只共用少數幾種 ops_before_detect；相同序列只比對一次。
+// 致敏一定從 state cover 的 op 開始（錨定比對），因此只需 trie，不需 Aho-Corasick 的 failure link。
+// match_at(start) 沿 trie 走一次，得到每個序列自 start 起連續匹配的長度；
+// cover(tp) 再換算成與 SensEngine::cover 完全相同的 SensOutcome。
+class TPPatternAutomaton {
+public:
+    using SeqId = int;
+    // caller 持有的暫存（可重複使用；多執行緒時各自一份）。
+    // op table 內容改變後須把 start 設回 -1
+    struct MatchBuffer {
+        OpId start{-1};
+        int avail{0};           // start 所在 element 內，自 start 起剩餘的 op 數
+        vector<int> match_len;  // [seq] → 自 start 起連續匹配的長度
+        vector<pair<int, int>> stack; // 走訪用 (node, depth)
+    };
+
+    void build(const vector<TestPrimitive>& tps);
+    size_t seq_count() const { return seq_len_.size(); }
+    SeqId seq_of_tp(TpGid tp_gid) const { return tp_seq_[tp_gid]; }
+    int seq_length(SeqId s) const { return seq_len_[s]; }
+
+    void match_at(const OpTable& opt, OpId start, MatchBuffer& buf) const;
+    // 同 SensEngine::cover；buf 不是 start 的比對結果時才走 trie（空序列完全不走）
+    SensOutcome cover(const OpTable& opt, OpId start, TpGid tp_gid, MatchBuffer& buf) const;
+
+    // 位元平行版的 match_at：lanes 的每一位代表一個 March test（見 BitParallelSimulator）。
+    // step(d, code) 回傳自 start 起第 d 個 op 仍在同一 element、且被 code 匹配的 lanes；
+    // full[seq] 為整段序列都匹配的 lanes（空序列即 lanes）
+    struct LaneFrame { int node; int depth; uint64_t lanes; };
+    template <class StepFn>
+    void match_lanes(uint64_t lanes, StepFn&& step, vector<uint64_t>& full, vector<LaneFrame>& stack) const;
+    int max_seq_length() const { return seq_len_.empty() ? 0 : *std::max_element(seq_len_.begin(), seq_len_.end()); }
+
+private:
+    // 節點 n 的子節點為 child_[child_begin_[n] .. child_begin_[n+1])；
+    // 子樹內的序列編號連續：[seq_lo_[n], seq_hi_[n])，節點本身是終點時其序列為 seq_lo_[n]
+    vector<int> child_begin_;
+    vector<OpCode> child_code_;
+    vector<int> child_node_;
+    vector<int> seq_lo_;
+    vector<int> seq_hi_;
+    vector<uint8_t> terminal_;
+    vector<int> seq_len_;
+    vector<SeqId> tp_seq_;
+};
+
+inline void TPPatternAutomaton::build(const vector<TestPrimitive>& tps) {
+    // 1) 以 (op code) 為邊建 trie
+    vector<vector<pair<OpCode, int>>> kids(1);
+    vector<int> term_of_tp(tps.size());
+    vector<uint8_t> is_term(1, 0);
+    for (size_t t = 0; t < tps.size(); ++t) {
+        int n = 0;
+        for (const auto& op : tps[t].ops_before_detect) {
+            OpCode c = encode_op(op);
+            int next = -1;
+            for (const auto& kv : kids[n]) if (kv.first == c) { next = kv.second; break; }
+            if (next < 0) {
+                next = (int)kids.size();
+                kids[n].emplace_back(c, next);
+                kids.emplace_back();
+                is_term.push_back(0);
+            }
+            n = next;
+        }
+        is_term[n] = 1;
+        term_of_tp[t] = n;
+    }
+    // 2) 前序走訪：重新編號節點、攤平子節點、序列依走訪順序編號
+    const int node_num = (int)kids.size();
+    vector<int> new_id(node_num, -1);
+    child_begin_.assign(node_num + 1, 0);
+    child_code_.clear(); child_node_.clear();
+    seq_lo_.assign(node_num, 0); seq_hi_.assign(node_num, 0);
+    terminal_.assign(node_num, 0);
+    seq_len_.clear();
+    vector<int> order; order.reserve(node_num);
+    vector<pair<int, int>> stack{{0, 0}}; // (舊節點, 深度)
+    vector<int> depth(node_num, 0);
+    while (!stack.empty()) {
+        auto [n, d] = stack.back(); stack.pop_back();
+        new_id[n] = (int)order.size();
+        order.push_back(n);
+        depth[n] = d;
+        std::sort(kids[n].begin(), kids[n].end());
+        for (auto it = kids[n].rbegin(); it != kids[n].rend(); ++it) stack.emplace_back(it->second, d + 1);
+    }
+    for (int i = 0; i < node_num; ++i) {
+        int n = order[i];
+        seq_lo_[i] = (int)seq_len_.size();
+        if (is_term[n]) { terminal_[i] = 1; seq_len_.push_back(depth[n]); }
+    }
+    // 子樹範圍：前序中子樹連續，由後往前累積 seq_hi_
+    for (int i = node_num - 1; i >= 0; --i) {
+        int n = order[i];
+        int hi = seq_lo_[i] + terminal_[i];
+        for (const auto& kv : kids[n]) hi = max(hi, seq_hi_[new_id[kv.second]]);
+        seq_hi_[i] = hi;
+    }
+    for (int i = 0; i < node_num; ++i) {
+        child_begin_[i] = (int)child_code_.size();
+        for (const auto& kv : kids[order[i]]) {
+            child_code_.push_back(kv.first);
+            child_node_.push_back(new_id[kv.second]);
+        }
+    }
+    child_begin_[node_num] = (int)child_code_.size();
+    tp_seq_.resize(tps.size());
+    for (size_t t = 0; t < tps.size(); ++t) tp_seq_[t] = seq_lo_[new_id[term_of_tp[t]]];
+}
+
+inline void TPPatternAutomaton::match_at(const OpTable& opt, OpId start, MatchBuffer& buf) const {
+    buf.start = start;
+    // 同一 element 的 op 連續排列：最後一個 op 是下一個 head 的前一個（或表尾）
+    OpId elem_last = (opt.head_next(start) >= 0) ? opt.head_next(start) - 1 : (OpId)opt.size() - 1;
+    buf.avail = elem_last - start + 1;
+    buf.match_len.resize(seq_len_.size());
+    if (seq_len_.empty()) return;
+    if (terminal_[0]) buf.match_len[0] = 0;
+    // 深度優先：走得進去的子節點繼續比對，走不進去的整棵子樹停在目前深度
+    auto& stack = buf.stack;
+    stack.clear();
+    stack.emplace_back(0, 0);
+    while (!stack.empty()) {
+        auto [n, d] = stack.back(); stack.pop_back();
+        const bool in_elem = d < buf.avail;
+        const OpCode code = in_elem ? opt.code(start + d) : 0;
+        for (int k = child_begin_[n]; k < child_begin_[n + 1]; ++k) {
+            int c = child_node_[k];
+            if (in_elem && op_code_match(child_code_[k], code)) {
+                if (terminal_[c]) buf.match_len[seq_lo_[c]] = d + 1;
+                stack.emplace_back(c, d + 1);
+            } else {
+                std::fill(buf.match_len.begin() + seq_lo_[c], buf.match_len.begin() + seq_hi_[c], d);
+            }
+        }
+    }
+}
+
+template <class StepFn>
+inline void TPPatternAutomaton::match_lanes(uint64_t lanes, StepFn&& step, vector<uint64_t>& full, vector<LaneFrame>& stack) const {
+    full.assign(seq_len_.size(), 0);
+    if (seq_len_.empty() || !lanes) return;
+    if (terminal_[0]) full[0] = lanes;
+    // 只往還有 lane 匹配的子節點走；走不進去的子樹維持 0
+    stack.clear();
+    stack.push_back(LaneFrame{0, 0, lanes});
+    while (!stack.empty()) {
+        LaneFrame f = stack.back(); stack.pop_back();
+        for (int k = child_begin_[f.node]; k < child_begin_[f.node + 1]; ++k) {
+            uint64_t m = f.lanes & step(f.depth, child_code_[k]);
+            if (!m) continue;
+            int c = child_node_[k];
+            if (terminal_[c]) full[seq_lo_[c]] = m;
+            stack.push_back(LaneFrame{c, f.depth + 1, m});
+        }
     }
-    return true;
+}
+
+inline SensOutcome TPPatternAutomaton::cover(const OpTable& opt, OpId start, TpGid tp_gid, MatchBuffer& buf) const {
+    const SeqId s = tp_seq_[tp_gid];
+    const int len = seq_len_[s];
+    if (len == 0) return {SensOutcome::Status::DontNeedSens, start, -1};
+    if (buf.start != start) match_at(opt, start, buf);
+    if (len > buf.avail) return SensOutcome{}; // 超出表尾或跨 element
+    const int matched = buf.match_len[s];
+    if (matched >= len) return SensOutcome{SensOutcome::Status::SensAll, buf.start + len - 1, -1};
+    return SensOutcome{SensOutcome::Status::SensPartial, -1, buf.start + matched};
 }
 
 struct DetectOutcome {
@@ -536,69 +975,76 @@ struct DetectOutcome {
 
 class DetectEngine {
 public:
-    DetectOutcome cover(const vector<OpContext>& opt, OpId sens_end_id, const TestPrimitive& tp) const;
+    DetectOutcome cover(const OpTable& opt, OpId sens_end_id, const TestPrimitive& tp) const;
+    // 以下兩段即 cover() 的拆解，供增量模擬在 op table 變長後接續未完成的偵測
+    // 把 # / ^ / ; 轉成錨點；錨點尚不存在時回 -1
+    OpId anchor_of(const OpTable& opt, OpId sens_end_id, const TestPrimitive& tp) const;
+    // F 有值時自 from 起往後掃描；掃到表尾仍無結果回 NoDetectorReachable
+    DetectOutcome scan_from(const OpTable& opt, OpId from, const TestPrimitive& tp) const;
 protected:
-    bool detect_match(const OpContext& op, const Detector& dec) const;
-    bool is_masking_on_D(const OpContext& op) const { return (op.op.kind == OpKind::Write); }
+    bool detect_match(OpCode op, const Detector& dec) const;
+    bool is_masking_on_D(OpCode op) const { return op_code_kind(op) == OpKind::Write; }
 };
 
-inline DetectOutcome DetectEngine::cover(const vector<OpContext>& opt, OpId sens_end_id, const TestPrimitive& tp) const {
+inline DetectOutcome DetectEngine::cover(const OpTable& opt, OpId sens_end_id, const TestPrimitive& tp) const {
     if (sens_end_id < 0 || sens_end_id >= (OpId)opt.size()) return DetectOutcome{};
     if (tp.R_has_value) return DetectOutcome{DetectOutcome::Status::Found, sens_end_id, -1}; // 特例：R有值-偵測成功
 
     // 1) 先把 # / ^ / ; 轉成錨點（原本定位點）
+    OpId anchor = anchor_of(opt, sens_end_id, tp);
+    if (anchor < 0) return DetectOutcome{};
+
+    // 2) 決定是否啟用「往後掃描」模式
+    //    僅當 F 在 D 面有具體值時（對應到 detector.kind==Read 且 value!=X）才啟用。
+    if (!tp.F_has_value) {
+        // 舊語意：只在錨點做一次比對
+        return detect_match(opt.code(anchor), tp.detector) ? DetectOutcome{DetectOutcome::Status::Found, anchor, -1} : DetectOutcome{};
+    }
+
+    // 3) 新語意（F 有值）：自錨點起往後掃描，直到找到 detector 或被 mask
+    return scan_from(opt, anchor, tp);
+}
+
+inline OpId DetectEngine::anchor_of(const OpTable& opt, OpId sens_end_id, const TestPrimitive& tp) const {
     OpId anchor = -1;
     switch (tp.detector.pos) {
         case PositionMark::Adjacent:
             // 無 sensitizer 時，偵測與 state 同一個 op；有 sensitizer 時取同 element 的下一個 op
-            anchor = tp.ops_before_detect.empty() ? sens_end_id : opt[sens_end_id].next_op_index;
+            anchor = tp.ops_before_detect.empty() ? sens_end_id : opt.next_op_index(sens_end_id);
             break;
         case PositionMark::SameElementHead:
-            anchor = opt[sens_end_id].head_same;
+            anchor = opt.head_same(sens_end_id);
             break;
         case PositionMark::NextElementHead:
-            anchor = opt[sens_end_id].head_next;
+            anchor = opt.head_next(sens_end_id);
             break;
     }
-    if (anchor < 0 || anchor >= (OpId)opt.size()) return DetectOutcome{};
-
-    // 2) 決定是否啟用「往後掃描」模式
-    //    僅當 F 在 D 面有具體值時（對應到 detector.kind==Read 且 value!=X）才啟用。
-    if (!tp.F_has_value) {
-        // 舊語意：只在錨點做一次比對
-        return detect_match(opt[anchor], tp.detector) ? DetectOutcome{DetectOutcome::Status::Found, anchor, -1} : DetectOutcome{};
-    }
+    if (anchor < 0 || anchor >= (OpId)opt.size()) return -1;
+    return anchor;
+}
 
-    // 3) 新語意（F 有值）：自錨點起往後掃描，直到找到 detector 或被 mask
+inline DetectOutcome DetectEngine::scan_from(const OpTable& opt, OpId from, const TestPrimitive& tp) const {
     //    這裡的「往後」是針對同一目標 cell 的操作序列（同一地址的執行序），
     //    因 opt 是 per-address/element 的攤平成序關係（參見 OpTableBuilder 的鄰接建構）。:contentReference[oaicite:3]{index=3}
-    for (OpId i = anchor; i < (OpId)opt.size(); ++i) {
-        // 先檢查遮罩：一旦遇到會寫 D 的操作，代表 fault effect 被洗掉 → 失敗
-        if (is_masking_on_D(opt[i])) {
-            return DetectOutcome{DetectOutcome::Status::MaskedOnD, -1, i}; // mask at i
-        }
-        // 符合 detector（例如 R0/R1）→ 成功
-        if (detect_match(opt[i], tp.detector)) {
-            return DetectOutcome{DetectOutcome::Status::Found, i, -1};
-        }
-        // 否則持續往後找下一個 op
+    //    等同逐 op 掃描：先遇到會寫 D 的操作 → fault effect 被洗掉；先遇到符合 detector 的 op → 成功。
+    //    兩者皆由 OpTable 的 next 索引 O(1) 取得（Write 不會匹配 Read/Compute detector，不會同位置）
+    if (from < 0 || from >= (OpId)opt.size()) return DetectOutcome{};
+    OpId mask = opt.next_write(from);
+    OpId hit = opt.next_detect(from, encode_op(tp.detector.detectOp));
+    if (mask >= 0 && (hit < 0 || mask < hit)) {
+        return DetectOutcome{DetectOutcome::Status::MaskedOnD, -1, mask}; // mask at mask
     }
+    if (hit >= 0) return DetectOutcome{DetectOutcome::Status::Found, hit, -1};
     return DetectOutcome{}; // 沒找到 detector 且未被寫 D 擋到 → 視為未偵測
 }
 
 
-inline bool DetectEngine::detect_match(const OpContext& op, const Detector& dec) const {
-    if (op.op.kind != dec.detectOp.kind) return false; // 不同 kind
-    if (dec.detectOp.kind == OpKind::Read) {
-        if (dec.detectOp.value != Val::X && op.op.value != dec.detectOp.value) return false; // 讀值不符 (tp X 可任意
-    } else if (dec.detectOp.kind == OpKind::ComputeAnd) {
-        if (dec.detectOp.C_T != Val::X && op.op.C_T != dec.detectOp.C_T) return false;
-        if (dec.detectOp.C_M != Val::X && op.op.C_M != dec.detectOp.C_M) return false;
-        if (dec.detectOp.C_B != Val::X && op.op.C_B != dec.detectOp.C_B) return false;
-    } else if (dec.detectOp.kind == OpKind::Write) {
+inline bool DetectEngine::detect_match(OpCode op, const Detector& dec) const {
+    if (op_code_kind(op) != dec.detectOp.kind) return false; // 不同 kind
+    if (dec.detectOp.kind == OpKind::Write) {
         throw runtime_error("DetectEngine::detect_match: detector op kind cannot be Write");
     }
-    return true;
+    return op_code_match(encode_op(dec.detectOp), op); // 讀值 / T,M,B 不符則失敗（X 可任意）
 }
 
 struct MaskOutcome {
@@ -614,6 +1060,8 @@ struct RawCoverLists {
     vector<TpGid>       sens_cover;  // [op] -> tp_gid[]
     vector<TpGid>       det_cover;   // [op] -> tp_gid[] (偵測命中)
     vector<MaskOutcome> masked;      // [op] -> tp_gid[] (遮蔽誰)
+
+    void clear() { state_cover.clear(); sens_cover.clear(); det_cover.clear(); masked.clear(); } // 保留容量
 };
 
 struct FaultCoverageDetail {
@@ -631,40 +1079,375 @@ struct FaultCoverageDetail {
     vector<TpGid> sens_tp_gids;   // TPs that sensitized this fault
     vector<TpGid> detect_tp_gids; // TPs that detected this fault
 };
+// 只有四個覆蓋率（搜尋器打分數只需要這些）
+struct CoverageSummary {
+    double state_coverage{0.0};
+    double sens_coverage{0.0};
+    double detect_coverage{0.0};
+    double total_coverage{0.0};
+};
+
+// Full：填 cover_lists / op_table / fault_detail_map；
+// Summary：只以整數群組旗標累計覆蓋率，不配置任何 per-op 清單或字串 map
+enum class SimulationMode { Full, Summary };
+
 struct SimulationResult {
     double state_coverage{0.0};
     double sens_coverage{0.0};
     double detect_coverage{0.0};
     double total_coverage{0.0};
     vector<RawCoverLists> cover_lists; // per op
-    vector<OpContext> op_table; // for reference
+    OpTable op_table; // for reference（SoA；op_table[i] 回傳完整 OpContext 檢視）
     unordered_map<string, FaultCoverageDetail> fault_detail_map; 
+
+    CoverageSummary summary() const { return CoverageSummary{state_coverage, sens_coverage, detect_coverage, total_coverage}; }
+    // 回到空結果（同預設建構），但保留 op table 等緩衝的容量
+    void clear() {
+        state_coverage = sens_coverage = detect_coverage = total_coverage = 0.0;
+        cover_lists.clear();
+        op_table.clear();
+        fault_detail_map.clear();
+    }
+    // Summary 模式的結果：只有覆蓋率欄位
+    static SimulationResult from_summary(const CoverageSummary& cs) {
+        SimulationResult r;
+        r.state_coverage = cs.state_coverage;
+        r.sens_coverage = cs.sens_coverage;
+        r.detect_coverage = cs.detect_coverage;
+        r.total_coverage = cs.total_coverage;
+        return r;
+    }
+};
+
+// tp → 群組緊密編號（依 TP 首次出現順序），回傳群組數。
+// TP 帶有 group_idx（TPGenerator 產生）時只做陣列查表；缺少或前後不一致
+// （例如把兩份各自正規化的清單接在一起）時才退回 (parent_fault_id, group) 字串雜湊。
+inline size_t assign_dense_groups(const vector<TestPrimitive>& tps, vector<GroupId>& tp2group) {
+    tp2group.assign(tps.size(), 0);
+    GroupIdx max_idx = -1;
+    bool interned = true;
+    for (const auto& tp : tps) {
+        if (tp.group_idx < 0) { interned = false; break; }
+        max_idx = std::max(max_idx, tp.group_idx);
+    }
+    if (interned) {
+        const TpGid none = tps.size();
+        vector<TpGid> first_tp(max_idx + 1, none); // group_idx → 第一個 TP
+        vector<GroupId> dense(max_idx + 1, 0);
+        size_t count = 0;
+        for (TpGid t = 0; t < tps.size() && interned; ++t) {
+            GroupIdx gi = tps[t].group_idx;
+            if (first_tp[gi] == none) {
+                first_tp[gi] = t;
+                dense[gi] = count++;
+            } else if (tps[first_tp[gi]].group != tps[t].group ||
+                       tps[first_tp[gi]].parent_fault_id != tps[t].parent_fault_id) {
+                interned = false;
+            }
+            tp2group[t] = dense[gi];
+        }
+        if (interned) return count;
+    }
+    unordered_map<string, array<long long, 3>> group_of_fault; // parent_fault_id → [og] → group id
+    size_t count = 0;
+    for (TpGid t = 0; t < tps.size(); ++t) {
+        auto it = group_of_fault.emplace(tps[t].parent_fault_id, array<long long, 3>{-1, -1, -1}).first;
+        long long& gid = it->second[(size_t)tps[t].group];
+        if (gid < 0) gid = (long long)count++;
+        tp2group[t] = (GroupId)gid;
+    }
+    return count;
+}
+
+// =============================================================
+//  PreparedFaultSet：整個搜尋期間 faults/TPs 不變，
+//  buckets、每個 state key 的相容 TP 清單、群組索引與 fault 索引只建一次。
+//  建好後唯讀，可被多個 FaultSimulator（包含不同執行緒）共用。
+// =============================================================
+using TpClassId = int; // TP 行為類別
+using GroupSpan = ConstSpan<GroupId>;
+using ClassSpan = ConstSpan<TpClassId>;
+
+// tp → 行為類別緊密編號（依 TP 首次出現順序）。
+// 模擬只讀 TP 的 state key、sensitizer 序列、detector（op/位置）與 F/R 旗標，這些相同即同類。
+struct TpClassMap {
+    vector<TpClassId> tp2class;
+    vector<TpGid> rep;            // [class] → 編號最小的成員
+    vector<uint16_t> state_key;   // [class] → state key
+    vector<uint64_t> behaviour;   // [class] → state key 以外的模擬輸入（sensitizer、detector、F/R）
+    void build(const vector<TestPrimitive>& tps, const TPPatternAutomaton& automaton);
+    size_t size() const { return rep.size(); }
+    // behaviour 相同、state key 為 key 的類別；不存在回 -1
+    TpClassId find(size_t key, uint64_t behav) const {
+        auto it = ids_.find(behav * CSS_EXPANDED_NUM + key);
+        return it == ids_.end() ? -1 : it->second;
+    }
+private:
+    unordered_map<uint64_t, TpClassId> ids_; // 重複 build 時沿用 bucket
+};
+
+inline void TpClassMap::build(const vector<TestPrimitive>& tps, const TPPatternAutomaton& automaton) {
+    auto& ids = ids_;
+    ids.clear();
+    tp2class.resize(tps.size());
+    rep.clear(); state_key.clear(); behaviour.clear();
+    for (size_t t = 0; t < tps.size(); ++t) {
+        const auto& tp = tps[t];
+        uint64_t b = (uint64_t)automaton.seq_of_tp(t);
+        b = b * OP_CODE_NUM + encode_op(tp.detector.detectOp);
+        b = b * 3 + static_cast<uint64_t>(tp.detector.pos);
+        b = b * 4 + (tp.F_has_value ? 2 : 0) + (tp.R_has_value ? 1 : 0);
+        size_t key = encode_to_key(tp.state);
+        auto ins = ids.emplace(b * CSS_EXPANDED_NUM + key, (TpClassId)ids.size());
+        if (ins.second) {
+            rep.push_back(t);
+            state_key.push_back(static_cast<uint16_t>(key));
+            behaviour.push_back(b);
+        }
+        tp2class[t] = ins.first->second;
+    }
+}
+
+class PreparedFaultSet {
+public:
+    PreparedFaultSet(const vector<Fault>& faults, const vector<TestPrimitive>& tps);
+
+    const vector<Fault>& faults() const { return faults_; }
+    const vector<TestPrimitive>& tps() const { return tps_; }
+
+    // 內容與順序同 StateCoverEngine::cover(key)，但直接指向攤平好的清單
+    TpSpan state_cover(size_t op_css_key) const {
+        return TpSpan{cover_flat_.data() + cover_offsets_[op_css_key], cover_flat_.data() + cover_offsets_[op_css_key + 1]};
+    }
+
+    // tp → faults() 內的位置；parent fault 不在 faults 內時為 -1
+    int fault_of_tp(TpGid tp_gid) const { return tp2fault_[tp_gid]; }
+    // tp → (parent_fault_id, group) 群組；編號規則同 GroupIndex::build（依 TP 首次出現順序）
+    GroupId group_of_tp(TpGid tp_gid) const { return tp2group_[tp_gid]; }
+    size_t group_count() const { return group_halves_.size(); }
+    // 群組對覆蓋率的權重，以 0.5 為單位（Single=2、LT/GT=1、不計分=0）
+    int group_halves(GroupId gid) const { return group_halves_[gid]; }
+    // 所有 TP 的 sensitizer trie（序列相同的 TP 每個 op 只比對一次）
+    const TPPatternAutomaton& sens_automaton() const { return sens_automaton_; }
+
+    // 行為類別：state key、sensitizer 序列、detector、F/R 旗標都相同的 TP 模擬結果必相同，
+    // 只差在 parent fault / group。每類只需模擬代表（編號最小的成員）一次，再分給成員。
+    const TpClassMap& classes() const { return classes_; }
+
+    // 支配：同群組內另有 TP 的 sensitizer / detector / F/R 都相同，而 state 嚴格較一般
+    // （對方每一位都是 X 或與自己相同）。自己被 state cover 時對方必定也是，後續結果也相同，
+    // 因此群組覆蓋從不依賴被支配的 TP。回傳支配它的同群組 TP（報表用）
+    optional<TpGid> dominator_of(TpGid tp_gid) const {
+        if (dominator_[tp_gid] == NO_DOMINATOR) return std::nullopt;
+        return dominator_[tp_gid];
+    }
+    // 類別的所有計分群組都被支配：覆蓋率計算時可整個略過
+    bool class_dominated(TpClassId c) const { return class_dominated_[c] != 0; }
+    size_t dominated_class_count() const { return (size_t)std::count(class_dominated_.begin(), class_dominated_.end(), 1); }
+    size_t class_count() const { return classes_.size(); }
+    TpClassId class_of_tp(TpGid tp_gid) const { return classes_.tp2class[tp_gid]; }
+    TpGid class_rep(TpClassId c) const { return classes_.rep[c]; }
+    // 成員的計分群組（去重、不含權重 0 的群組）
+    GroupSpan class_groups(TpClassId c) const {
+        return GroupSpan{class_group_flat_.data() + class_group_offsets_[c], class_group_flat_.data() + class_group_offsets_[c + 1]};
+    }
+    // 同 state_cover(key)，但以類別列出（依代表的順序），並略過被支配的類別（只用於算覆蓋率）
+    ClassSpan class_state_cover(size_t op_css_key) const {
+        return ClassSpan{class_cover_flat_.data() + class_cover_offsets_[op_css_key], class_cover_flat_.data() + class_cover_offsets_[op_css_key + 1]};
+    }
+
+private:
+    const vector<Fault>& faults_;
+    const vector<TestPrimitive>& tps_;
+    vector<size_t> cover_offsets_;  // [op key] → cover_flat_ 起點（CSR，大小 729+1）
+    vector<TpGid> cover_flat_;
+    vector<int> tp2fault_;
+    vector<GroupId> tp2group_;
+    vector<int> group_halves_;
+    TPPatternAutomaton sens_automaton_;
+    TpClassMap classes_;
+    vector<size_t> class_group_offsets_;
+    vector<GroupId> class_group_flat_;
+    vector<size_t> class_cover_offsets_;
+    vector<TpClassId> class_cover_flat_;
+    static constexpr TpGid NO_DOMINATOR = static_cast<TpGid>(-1);
+    vector<TpGid> dominator_;
+    vector<uint8_t> class_dominated_;
+
+    void build_dominance();
 };
 
+inline PreparedFaultSet::PreparedFaultSet(const vector<Fault>& faults, const vector<TestPrimitive>& tps)
+    : faults_(faults), tps_(tps) {
+    // 1) fault id → 位置（檢查重複；TP 的整數索引不可用時也靠它查）
+    unordered_map<string, int> fault_pos;
+    for (size_t i = 0; i < faults_.size(); ++i) {
+        if (!fault_pos.emplace(faults_[i].fault_id, (int)i).second) {
+            throw runtime_error("PreparedFaultSet: duplicate fault id: " + faults_[i].fault_id);
+        }
+    }
+    // 2) tp → fault：優先用 parent_fault_idx（需與 faults 的位置一致）
+    const int fault_num = (int)faults_.size();
+    tp2fault_.assign(tps_.size(), -1);
+    for (size_t t = 0; t < tps_.size(); ++t) {
+        const auto& tp = tps_[t];
+        FaultIdx fi = tp.parent_fault_idx;
+        if (fi >= 0 && fi < fault_num && faults_[fi].fault_idx == fi && faults_[fi].fault_id == tp.parent_fault_id) {
+            tp2fault_[t] = fi;
+        } else {
+            auto fit = fault_pos.find(tp.parent_fault_id);
+            if (fit != fault_pos.end()) tp2fault_[t] = fit->second;
+        }
+    }
+    // 3) tp → group 與群組權重
+    group_halves_.assign(assign_dense_groups(tps_, tp2group_), -1);
+    for (size_t t = 0; t < tps_.size(); ++t) {
+        int& halves = group_halves_[tp2group_[t]];
+        if (halves >= 0) continue;
+        halves = 0;
+        if (tp2fault_[t] >= 0) {
+            bool single_cell = faults_[tp2fault_[t]].cell_scope == CellScope::SingleCell;
+            if (single_cell && tps_[t].group == OrientationGroup::Single) halves = 2;
+            if (!single_cell && tps_[t].group != OrientationGroup::Single) halves = 1;
+        }
+    }
+    // 4) buckets → 每個 op key 的相容 TP 清單攤平成 CSR
+    array<vector<TpGid>, CSS_EXPANDED_NUM> buckets;
+    for (size_t i = 0; i < tps_.size(); ++i) buckets[encode_to_key(tps_[i].state)].push_back(i);
+    cover_offsets_.assign(CSS_EXPANDED_NUM + 1, 0);
+    for (int key = 0; key < CSS_EXPANDED_NUM; ++key) {
+        cover_offsets_[key] = cover_flat_.size();
+        for (auto tp_key : CoverLUT::get_compatible_tp_keys_by_key(key)) {
+            const auto& b = buckets[tp_key];
+            cover_flat_.insert(cover_flat_.end(), b.begin(), b.end());
+        }
+    }
+    cover_offsets_[CSS_EXPANDED_NUM] = cover_flat_.size();
+    // 5) sensitizer trie
+    sens_automaton_.build(tps_);
+    // 6) 行為類別與各類別的 state cover / 計分群組
+    classes_.build(tps_, sens_automaton_);
+    const size_t class_num = classes_.size();
+    vector<vector<GroupId>> groups_of(class_num);
+    for (size_t t = 0; t < tps_.size(); ++t) {
+        GroupId g = tp2group_[t];
+        auto& gs = groups_of[classes_.tp2class[t]];
+        if (group_halves_[g] > 0 && std::find(gs.begin(), gs.end(), g) == gs.end()) gs.push_back(g);
+    }
+    class_group_offsets_.assign(class_num + 1, 0);
+    for (size_t c = 0; c < class_num; ++c) {
+        class_group_offsets_[c] = class_group_flat_.size();
+        class_group_flat_.insert(class_group_flat_.end(), groups_of[c].begin(), groups_of[c].end());
+    }
+    class_group_offsets_[class_num] = class_group_flat_.size();
+    // 7) 支配關係；被支配的類別不進 class_state_cover
+    build_dominance();
+    class_cover_offsets_.assign(CSS_EXPANDED_NUM + 1, 0);
+    for (int key = 0; key < CSS_EXPANDED_NUM; ++key) {
+        class_cover_offsets_[key] = class_cover_flat_.size();
+        for (TpGid t : state_cover(key)) {
+            TpClassId c = class_of_tp(t);
+            if (class_rep(c) == t && !class_dominated_[c]) class_cover_flat_.push_back(c);
+        }
+    }
+    class_cover_offsets_[CSS_EXPANDED_NUM] = class_cover_flat_.size();
+}
+
+inline void PreparedFaultSet::build_dominance() {
+    const size_t class_num = classes_.size();
+    const size_t group_num = group_halves_.size();
+    // (class, group) → 該類別在該群組的第一個成員
+    unordered_map<uint64_t, TpGid> member_in_group;
+    for (size_t t = 0; t < tps_.size(); ++t) {
+        member_in_group.emplace((uint64_t)class_of_tp(t) * group_num + tp2group_[t], t);
+    }
+    // 類別 c 的所有嚴格較一般的 state key：把非 X 的位任取非空子集改成 X
+    auto for_each_generalization = [&](TpClassId c, auto&& fn) {
+        int digit[KEY_BIT];
+        size_t key = classes_.state_key[c];
+        for (int i = KEY_BIT - 1; i >= 0; --i) { digit[i] = (int)(key % KEY_CARRY); key /= KEY_CARRY; }
+        int fixed[KEY_BIT], nfixed = 0;
+        for (int i = 0; i < KEY_BIT; ++i) if (digit[i] != 2) fixed[nfixed++] = i;
+        for (int mask = 1; mask < (1 << nfixed); ++mask) {
+            size_t g = 0;
+            for (int i = 0; i < KEY_BIT; ++i) {
+                bool to_x = false;
+                for (int j = 0; j < nfixed; ++j) if (fixed[j] == i && (mask >> j & 1)) to_x = true;
+                g = g * KEY_CARRY + (to_x ? 2 : digit[i]);
+            }
+            TpClassId d = classes_.find(g, classes_.behaviour[c]);
+            if (d >= 0) fn(d);
+        }
+    };
+    dominator_.assign(tps_.size(), NO_DOMINATOR);
+    for (size_t t = 0; t < tps_.size(); ++t) {
+        const uint64_t g = tp2group_[t];
+        for_each_generalization(class_of_tp(t), [&](TpClassId d) {
+            if (dominator_[t] != NO_DOMINATOR) return;
+            auto it = member_in_group.find((uint64_t)d * group_num + g);
+            if (it != member_in_group.end()) dominator_[t] = it->second;
+        });
+    }
+    // 類別的每個計分群組都有被支配的成員 → 整個類別不影響覆蓋率。
+    // 較一般的類別可能也被支配，但 key 嚴格變一般不會成環，最一般的那個一定保留
+    class_dominated_.assign(class_num, 0);
+    for (size_t c = 0; c < class_num; ++c) {
+        bool all = true;
+        for (GroupId g : class_groups((TpClassId)c)) {
+            auto it = member_in_group.find((uint64_t)c * group_num + g);
+            if (it == member_in_group.end() || dominator_[it->second] == NO_DOMINATOR) { all = false; break; }
+        }
+        class_dominated_[c] = all && !class_groups((TpClassId)c).empty();
+    }
+}
+
+// fault_detail_map 只在建立時以 fault_id 雜湊一次；之後都經由 details[fault 位置] 存取
 class Reporter {
 public:
     void build(const vector<TestPrimitive>& tps, const vector<Fault>& faults, SimulationResult& result) const;
+    // 同上，但以 prepared 內的 fault 索引歸戶。result 已帶有同一組 fault 的 fault_detail_map 時
+    // 就地歸零各項重用（key 字串與 tp 清單的容量都保留），反覆傳入同一個 result 不再配置記憶體
+    void build(const PreparedFaultSet& prepared, SimulationResult& result) const;
 private:
-    void build_fault_map(const vector<Fault>& faults, SimulationResult& result) const;
-    void analyze_fault_detail(const vector<TestPrimitive>& tps, SimulationResult& result) const;
-    void compute_fault_coverage(const vector<Fault>& faults, const vector<TestPrimitive>& tps, SimulationResult& result) const;
+    using DetailRefs = vector<FaultCoverageDetail*>; // [fault 位置] → fault_detail_map 內的項目
+    mutable DetailRefs details_; // build 的暫存（每個模擬器各有一個 Reporter，不跨執行緒共用）
+    void build_fault_map(const vector<Fault>& faults, SimulationResult& result, DetailRefs& details) const;
+    bool reuse_fault_map(const vector<Fault>& faults, SimulationResult& result, DetailRefs& details) const;
+    void analyze_fault_detail(const vector<TestPrimitive>& tps, const vector<Fault>& faults,
+                              const DetailRefs& details, SimulationResult& result) const;
+    void analyze_fault_detail(const PreparedFaultSet& prepared, const DetailRefs& details, SimulationResult& result) const;
+    void compute_fault_coverage(const vector<Fault>& faults, const vector<TestPrimitive>& tps, const DetailRefs& details) const;
     void compute_final_coverage(SimulationResult& result) const;
 };
 
 inline void Reporter::build(const vector<TestPrimitive>& tps, const vector<Fault>& faults,
                                         SimulationResult& result) const {
-    build_fault_map(faults, result);
-    analyze_fault_detail(tps, result);
-    compute_fault_coverage(faults, tps, result);
+    build_fault_map(faults, result, details_);
+    analyze_fault_detail(tps, faults, details_, result);
+    compute_fault_coverage(faults, tps, details_);
     compute_final_coverage(result);
 }
 
-inline void Reporter::build_fault_map(const vector<Fault>& faults, SimulationResult& result) const {
+inline void Reporter::build(const PreparedFaultSet& prepared, SimulationResult& result) const {
+    if (!reuse_fault_map(prepared.faults(), result, details_)) {
+        result.fault_detail_map.clear();
+        build_fault_map(prepared.faults(), result, details_);
+    }
+    analyze_fault_detail(prepared, details_, result);
+    compute_fault_coverage(prepared.faults(), prepared.tps(), details_);
+    compute_final_coverage(result);
+}
+
+inline void Reporter::build_fault_map(const vector<Fault>& faults, SimulationResult& result, DetailRefs& details) const {
+    details.clear();
+    details.reserve(faults.size());
+    result.fault_detail_map.reserve(faults.size());
     for (const auto& f : faults) {
-        if (result.fault_detail_map.find(f.fault_id) != result.fault_detail_map.end()) {
+        auto ins = result.fault_detail_map.emplace(f.fault_id, FaultCoverageDetail{});
+        if (!ins.second) {
             throw runtime_error("Reporter::build_fault_map: duplicate fault id: " + f.fault_id);
         }
-        result.fault_detail_map[f.fault_id] = FaultCoverageDetail{f.fault_id,
+        ins.first->second = FaultCoverageDetail{f.fault_id,
                                                                   /*coverage*/0.0,
                                                                   /*state_coverage*/0.0,
                                                                   /*sens_coverage*/0.0,
@@ -672,42 +1455,73 @@ inline void Reporter::build_fault_map(const vector<Fault>& faults, SimulationRes
                                                                   /*state_tp_gids*/{},
                                                                   /*sens_tp_gids*/{},
                                                                   /*detect_tp_gids*/{}};
+        details.push_back(&ins.first->second);
     }
 }
 
-inline void Reporter::analyze_fault_detail(const vector<TestPrimitive>& tps, SimulationResult& result) const {
-    for (const auto& cover_list : result.cover_lists) {
-        // 1) collect state phase tp gids
-        for (const auto& tp_gid : cover_list.state_cover) {
-            const auto& fid = tps[tp_gid].parent_fault_id;
-            auto it = result.fault_detail_map.find(fid);
-            if (it != result.fault_detail_map.end()) {
-                it->second.state_tp_gids.push_back(tp_gid);
-            }
+// map 的 key 恰好是 faults 時就地歸零各項；fault id 不重複（PreparedFaultSet 已檢查），
+// 所以大小相同且每個 id 都找得到即一一對應
+inline bool Reporter::reuse_fault_map(const vector<Fault>& faults, SimulationResult& result, DetailRefs& details) const {
+    if (result.fault_detail_map.size() != faults.size()) return false;
+    details.clear();
+    for (const auto& f : faults) {
+        auto it = result.fault_detail_map.find(f.fault_id);
+        if (it == result.fault_detail_map.end()) return false;
+        details.push_back(&it->second);
+    }
+    for (FaultCoverageDetail* d : details) {
+        d->coverage = d->state_coverage = d->sens_coverage = d->detect_coverage = 0.0;
+        d->state_tp_gids.clear();
+        d->sens_tp_gids.clear();
+        d->detect_tp_gids.clear();
+    }
+    return true;
+}
+
+inline void Reporter::analyze_fault_detail(const vector<TestPrimitive>& tps, const vector<Fault>& faults,
+                                           const DetailRefs& details, SimulationResult& result) const {
+    // tp → fault 位置：parent_fault_idx 與 faults 一致時直接用，否則才以字串查 map
+    const int fault_num = (int)faults.size();
+    auto detail_of = [&](const TestPrimitive& tp) -> FaultCoverageDetail* {
+        FaultIdx fi = tp.parent_fault_idx;
+        if (fi >= 0 && fi < fault_num && faults[fi].fault_idx == fi && faults[fi].fault_id == tp.parent_fault_id) {
+            return details[fi];
         }
-        // 2) collect sens phase tp gids
-        for (const auto& tp_gid : cover_list.sens_cover) {
-            const auto& fid = tps[tp_gid].parent_fault_id;
-            auto it = result.fault_detail_map.find(fid);
-            if (it != result.fault_detail_map.end()) {
-                it->second.sens_tp_gids.push_back(tp_gid);
-            }
+        auto it = result.fault_detail_map.find(tp.parent_fault_id);
+        return it != result.fault_detail_map.end() ? &it->second : nullptr;
+    };
+    auto collect = [&](const vector<TpGid>& tp_gids, vector<TpGid> FaultCoverageDetail::*field) {
+        for (auto tp_gid : tp_gids) {
+            if (FaultCoverageDetail* d = detail_of(tps[tp_gid])) (d->*field).push_back(tp_gid);
         }
-        // 3) collect detect tp gids
-        for (const auto& tp_gid : cover_list.det_cover) {
-            const auto& fid = tps[tp_gid].parent_fault_id;
-            auto it = result.fault_detail_map.find(fid);
-            if (it != result.fault_detail_map.end()) {
-                it->second.detect_tp_gids.push_back(tp_gid);
-            }
+    };
+    for (const auto& cover_list : result.cover_lists) {
+        collect(cover_list.state_cover, &FaultCoverageDetail::state_tp_gids);  // 1) state phase
+        collect(cover_list.sens_cover, &FaultCoverageDetail::sens_tp_gids);    // 2) sens phase
+        collect(cover_list.det_cover, &FaultCoverageDetail::detect_tp_gids);   // 3) detect
+    }
+}
+
+inline void Reporter::analyze_fault_detail(const PreparedFaultSet& prepared, const DetailRefs& details,
+                                           SimulationResult& result) const {
+    auto collect = [&](const vector<TpGid>& tp_gids, vector<TpGid> FaultCoverageDetail::*field) {
+        for (auto tp_gid : tp_gids) {
+            int f = prepared.fault_of_tp(tp_gid);
+            if (f >= 0) (details[f]->*field).push_back(tp_gid);
         }
+    };
+    for (const auto& cover_list : result.cover_lists) {
+        collect(cover_list.state_cover, &FaultCoverageDetail::state_tp_gids);
+        collect(cover_list.sens_cover, &FaultCoverageDetail::sens_tp_gids);
+        collect(cover_list.det_cover, &FaultCoverageDetail::detect_tp_gids);
     }
 }
 
 inline void Reporter::compute_fault_coverage(const vector<Fault>& faults, const vector<TestPrimitive>& tps, 
-                                             SimulationResult& result) const {
-    for (const auto& fault : faults) {
-        auto& fault_detail = result.fault_detail_map[fault.fault_id];
+                                             const DetailRefs& details) const {
+    for (size_t fi = 0; fi < faults.size(); ++fi) {
+        const auto& fault = faults[fi];
+        auto& fault_detail = *details[fi];
         auto compute_cov_from_tp_gids = [&](const vector<size_t>& tp_gids) -> double {
             bool has_any = false;
             bool has_lt = false;
@@ -765,12 +1579,64 @@ inline void Reporter::compute_final_coverage(SimulationResult& result) const {
 class FaultSimulator {
 public:
     SimulationResult simulate(const MarchTest& mt, const vector<Fault>& faults, const vector<TestPrimitive>& tps);
+    // 使用預先建好的 PreparedFaultSet（唯讀），省去每次重建 buckets
+    // mode == Summary 時只填四個覆蓋率欄位（其值與 Full 逐位元相同）
+    SimulationResult simulate(const MarchTest& mt, const PreparedFaultSet& prepared,
+                              SimulationMode mode = SimulationMode::Full);
+    // 同上（Full），但寫進呼叫端持有的 out 並沿用它的緩衝：op table、每個 op 的 cover lists、
+    // fault_detail_map 的項目都保留上一次的容量。同一個 out 反覆傳入時，穩定後不再配置記憶體
+    void simulate(const MarchTest& mt, const PreparedFaultSet& prepared, SimulationResult& out);
+    // 只算覆蓋率：op table 與群組旗標都重複使用成員緩衝，穩定後不再配置記憶體
+    CoverageSummary simulate_summary(const MarchTest& mt, const PreparedFaultSet& prepared);
+
+    // 設定後 Full 模式的 op 迴圈切成連續區段平行執行（每段至少 min_ops_per_shard 個 op），
+    // 各段的 push 先暫存在段內，再依 op 順序合併，結果與序列版逐位元相同。
+    // pool 由呼叫端持有；nullptr 表示序列執行。Summary 模式不受影響。
+    void set_thread_pool(ThreadPool* pool, size_t min_ops_per_shard = 32) {
+        pool_ = pool;
+        min_ops_per_shard_ = max<size_t>(1, min_ops_per_shard);
+    }
 protected:
     OpTableBuilder op_table_builder;
     StateCoverEngine state_cover_engine;
-    SensEngine sens_engine;
+    TPPatternAutomaton sens_automaton; // 舊介面（faults/tps）每次模擬重建
+    TpClassMap tp_classes;
     DetectEngine detect_engine;
     Reporter reporter;
+    OpTable summary_op_table_;               // Summary 模式重複使用的 op table
+    array<vector<uint8_t>, 3> group_hit_;    // [stage][group] → 是否已命中（Summary 模式）
+    TPPatternAutomaton::MatchBuffer sens_match_; // 目前 op 的 trie 比對結果（每次模擬前重設）
+
+    // 行為類別在某個 op 的 sens/detect 結果（同 op 下同類成員共用）
+    struct ClassOutcome {
+        OpId op{-1};
+        SensOutcome sens;
+        DetectOutcome det;
+    };
+    vector<ClassOutcome> class_outcome_;
+
+    // 平行時每段 op 的暫存：自己的類別快取與 trie 緩衝，以及寫往 op >= first 的 cover lists
+    struct OpShard {
+        size_t first{0};
+        vector<ClassOutcome> class_outcome;
+        TPPatternAutomaton::MatchBuffer sens_match;
+        vector<RawCoverLists> lists; // [op - first]
+    };
+    ThreadPool* pool_{nullptr};
+    size_t min_ops_per_shard_{32};
+    vector<OpShard> shards_;
+
+    // 三階段模擬；state_cover(key, out) 負責填入該 op 的 state cover 清單（需可平行呼叫）。
+    // 每個行為類別只以代表模擬，結果再依 state cover 的順序分給每個 TP
+    template <class StateCoverFn>
+    void simulate_ops(const vector<TestPrimitive>& tps, const TPPatternAutomaton& automaton, const TpClassMap& classes,
+                      SimulationResult& result, StateCoverFn&& state_cover);
+    // op [op_begin, op_end) 的三階段模擬；push 寫進 out[op - out_first]
+    template <class StateCoverFn>
+    void simulate_op_range(const vector<TestPrimitive>& tps, const TPPatternAutomaton& automaton, const TpClassMap& classes,
+                           const OpTable& opt, size_t op_begin, size_t op_end, StateCoverFn& state_cover,
+                           vector<ClassOutcome>& memo, TPPatternAutomaton::MatchBuffer& buf,
+                           vector<RawCoverLists>& out, size_t out_first) const;
 };
 
 inline SimulationResult FaultSimulator::simulate(const MarchTest& mt, const vector<Fault>& faults, const vector<TestPrimitive>& tps) {
@@ -781,41 +1647,983 @@ inline SimulationResult FaultSimulator::simulate(const MarchTest& mt, const vect
     result.op_table = op_table_builder.build(mt);
     // 2) 建立 State Cover LUT 與 buckets
     state_cover_engine.build_tp_buckets(tps);
+    sens_automaton.build(tps);
+    tp_classes.build(tps, sens_automaton);
     // 3) 三階段模擬
-    result.cover_lists.resize(result.op_table.size());
-    for (size_t op_id = 0; op_id < result.op_table.size(); ++op_id) {
+    simulate_ops(tps, sens_automaton, tp_classes, result, [&](size_t key, vector<TpGid>& out) { out = state_cover_engine.cover(key); });
+    // 4) Reporter
+    reporter.build(tps, faults, result);
+    return result;
+}
+
+inline SimulationResult FaultSimulator::simulate(const MarchTest& mt, const PreparedFaultSet& prepared, SimulationMode mode) {
+    if (mode == SimulationMode::Summary) return SimulationResult::from_summary(simulate_summary(mt, prepared));
+    SimulationResult result;
+    simulate(mt, prepared, result);
+    return result;
+}
+
+inline void FaultSimulator::simulate(const MarchTest& mt, const PreparedFaultSet& prepared, SimulationResult& out) {
+    if (mt.elements.empty() || prepared.faults().empty()) { // empty March test / no faults
+        out.clear();
+        return;
+    }
+    op_table_builder.rebuild_tail(mt, out.op_table, 0);
+    simulate_ops(prepared.tps(), prepared.sens_automaton(), prepared.classes(), out, [&](size_t key, vector<TpGid>& lst) {
+        TpSpan span = prepared.state_cover(key);
+        lst.assign(span.begin(), span.end());
+    });
+    reporter.build(prepared, out);
+}
+
+inline CoverageSummary FaultSimulator::simulate_summary(const MarchTest& mt, const PreparedFaultSet& prepared) {
+    CoverageSummary out;
+    if (mt.elements.empty()) return out; // empty March test
+    if (prepared.faults().empty()) return out; // no faults
+    const auto& tps = prepared.tps();
+    op_table_builder.rebuild_tail(mt, summary_op_table_, 0);
+    const auto& opt = summary_op_table_;
+    for (auto& h : group_hit_) h.assign(prepared.group_count(), 0);
+    sens_match_.start = -1;
+    array<long long, 3> covered_halves{}; // [stage] → 已命中群組權重（0.5 為單位）
+
+    // 命中的類別把所有成員的計分群組一起標記
+    auto mark = [&](int stage, GroupSpan groups) {
+        for (GroupId g : groups) {
+            if (!group_hit_[stage][g]) { group_hit_[stage][g] = 1; covered_halves[stage] += prepared.group_halves(g); }
+        }
+    };
+    auto all_hit = [&](int stage, GroupSpan groups) {
+        for (GroupId g : groups) if (!group_hit_[stage][g]) return false;
+        return true;
+    };
+
+    // 每個行為類別只模擬代表 TP
+    for (size_t op_id = 0; op_id < opt.size(); ++op_id) {
+        for (TpClassId c : prepared.class_state_cover(opt.state_key((OpId)op_id))) {
+            GroupSpan groups = prepared.class_groups(c);
+            if (groups.empty()) continue; // 成員都屬不計分的群組
+            mark(0, groups);
+            // 成員群組的 sens 與 detect 都已命中：這個類別不會再改變覆蓋率
+            if (all_hit(1, groups) && all_hit(2, groups)) continue;
+
+            TpGid rep = prepared.class_rep(c);
+            auto sens_result = prepared.sens_automaton().cover(opt, (OpId)op_id, rep, sens_match_);
+            if (sens_result.status == SensOutcome::Status::SensNone ||
+                sens_result.status == SensOutcome::Status::SensPartial) continue;
+            mark(1, groups);
+            if (all_hit(2, groups)) continue;
+
+            auto det_result = detect_engine.cover(opt, sens_result.sens_end_op, tps[rep]);
+            if (det_result.det_op != -1) mark(2, groups);
+        }
+    }
+    // 與 Reporter 相同：每個 fault 的覆蓋率是 0 / 0.5 / 1，加總後除以 fault 數
+    double n = static_cast<double>(prepared.faults().size());
+    out.state_coverage  = (covered_halves[0] * 0.5) / n;
+    out.sens_coverage   = (covered_halves[1] * 0.5) / n;
+    out.detect_coverage = (covered_halves[2] * 0.5) / n;
+    out.total_coverage  = out.detect_coverage;
+    return out;
+}
+
+template <class StateCoverFn>
+inline void FaultSimulator::simulate_ops(const vector<TestPrimitive>& tps, const TPPatternAutomaton& automaton, const TpClassMap& classes,
+                                         SimulationResult& result, StateCoverFn&& state_cover) {
+    const size_t n = result.op_table.size();
+    result.cover_lists.resize(n);
+    for (auto& l : result.cover_lists) l.clear(); // result 可能是重複使用的緩衝
+    size_t shard_num = pool_ ? std::min(pool_->concurrency(), n / min_ops_per_shard_) : 1;
+    if (shard_num <= 1) {
+        simulate_op_range(tps, automaton, classes, result.op_table, 0, n, state_cover,
+                          class_outcome_, sens_match_, result.cover_lists, 0);
+        return;
+    }
+    // 1) 切點對齊 element 開頭：^ 錨點的 detect/mask 可能落在同 element 較前面的 op，
+    //    但不會早於該 element 的 head，所以每段的 push 都寫往 op >= 段起點
+    vector<size_t> cut{0};
+    for (size_t si = 1; si < shard_num; ++si) {
+        size_t head = (size_t)result.op_table.head_same((OpId)(n * si / shard_num));
+        if (head > cut.back()) cut.push_back(head);
+    }
+    cut.push_back(n);
+    shard_num = cut.size() - 1;
+    if (shard_num <= 1) {
+        simulate_op_range(tps, automaton, classes, result.op_table, 0, n, state_cover,
+                          class_outcome_, sens_match_, result.cover_lists, 0);
+        return;
+    }
+    // 2) 各段獨立模擬，push 先暫存在段內
+    shards_.resize(shard_num);
+    pool_->parallel_for(shard_num, shard_num, [&](size_t si, size_t, size_t) {
+        const size_t b = cut[si], e = cut[si + 1];
+        OpShard& sh = shards_[si];
+        sh.first = b;
+        sh.lists.resize(n - b);
+        for (auto& l : sh.lists) l.clear();
+        simulate_op_range(tps, automaton, classes, result.op_table, b, e, state_cover,
+                          sh.class_outcome, sh.sens_match, sh.lists, b);
+    });
+    // 3) 依 op 合併：目標 op j 的清單 = 各段（op 由小到大）對 j 的 push 依序串接，與序列版順序相同
+    pool_->parallel_for(n, shard_num, [&](size_t b, size_t e, size_t) {
+        for (size_t j = b; j < e; ++j) {
+            RawCoverLists& dst = result.cover_lists[j];
+            for (OpShard& sh : shards_) {
+                if (sh.first > j) break;
+                RawCoverLists& src = sh.lists[j - sh.first];
+                if (!src.state_cover.empty()) dst.state_cover.swap(src.state_cover); // 只有 j 所在的段會寫
+                dst.sens_cover.insert(dst.sens_cover.end(), src.sens_cover.begin(), src.sens_cover.end());
+                dst.det_cover.insert(dst.det_cover.end(), src.det_cover.begin(), src.det_cover.end());
+                dst.masked.insert(dst.masked.end(), src.masked.begin(), src.masked.end());
+            }
+        }
+    });
+}
+
+template <class StateCoverFn>
+inline void FaultSimulator::simulate_op_range(const vector<TestPrimitive>& tps, const TPPatternAutomaton& automaton, const TpClassMap& classes,
+                                              const OpTable& opt, size_t op_begin, size_t op_end, StateCoverFn& state_cover,
+                                              vector<ClassOutcome>& memo, TPPatternAutomaton::MatchBuffer& buf,
+                                              vector<RawCoverLists>& out, size_t out_first) const {
+    buf.start = -1;
+    memo.assign(classes.size(), ClassOutcome{});
+    auto lists = [&](OpId op) -> RawCoverLists& { return out[(size_t)op - out_first]; };
+    for (size_t op_id = op_begin; op_id < op_end; ++op_id) {
         // 1) State cover
-        result.cover_lists[op_id].state_cover = state_cover_engine.cover(result.op_table[op_id].pre_state_key);
+        vector<TpGid>& state_tps = lists((OpId)op_id).state_cover;
+        state_cover(opt.state_key((OpId)op_id), state_tps);
 
         // 2) Sens + Detect 必須串在一起檢查
-        for (size_t tp_gid : result.cover_lists[op_id].state_cover) {
-            auto sens_result = sens_engine.cover(result.op_table, (int)op_id, tps[tp_gid]);
+        for (size_t tp_gid : state_tps) {
+            // 同類成員在這個 op 第一次出現時才模擬代表
+            ClassOutcome& oc = memo[classes.tp2class[tp_gid]];
+            if (oc.op != (OpId)op_id) {
+                TpGid rep = classes.rep[classes.tp2class[tp_gid]];
+                oc.op = (OpId)op_id;
+                oc.sens = automaton.cover(opt, (OpId)op_id, rep, buf);
+                oc.det = DetectOutcome{};
+                if (oc.sens.status == SensOutcome::Status::SensAll || oc.sens.status == SensOutcome::Status::DontNeedSens) {
+                    oc.det = detect_engine.cover(opt, oc.sens.sens_end_op, tps[rep]);
+                }
+            }
+            const SensOutcome& sens_result = oc.sens;
             if (sens_result.status == SensOutcome::Status::SensNone) {
                 continue; // 沒致敏就不做偵測
             }
             if (sens_result.status == SensOutcome::Status::SensPartial) {
-                result.cover_lists[sens_result.sens_mask_at_op].masked.push_back(
+                lists(sens_result.sens_mask_at_op).masked.push_back(
                     MaskOutcome{tp_gid, MaskOutcome::Status::PartMasked});
                 continue; // 致敏被遮蔽就不做偵測
             }
-            result.cover_lists[sens_result.sens_end_op].sens_cover.push_back(tp_gid);
+            lists(sens_result.sens_end_op).sens_cover.push_back(tp_gid);
 
-            auto det_result = detect_engine.cover(result.op_table, sens_result.sens_end_op, tps[tp_gid]);
+            const DetectOutcome& det_result = oc.det;
             if (det_result.det_op != -1) {
-                result.cover_lists[det_result.det_op].det_cover.push_back(tp_gid);
+                lists(det_result.det_op).det_cover.push_back(tp_gid);
             }
             if (det_result.mask_at_op != -1) {
-                result.cover_lists[det_result.mask_at_op].masked.push_back(
+                lists(det_result.mask_at_op).masked.push_back(
                     MaskOutcome{tp_gid, MaskOutcome::Status::AllMasked});
             }
         }
     }
-    // 3) Reporter
-    reporter.build(tps, faults, result);
+}
+
+// =============================================================
+//  Incremental (append-only) Simulation
+//  搜尋器都是「前綴 + 一個 element / op」在試，這裡把模擬狀態保留下來，
+//  每次只重算最後一個 element 與尚未結束的偵測掃描。
+// =============================================================
+
+// append 一次的結果：前後覆蓋率 + 自哪個 op 起 cover_lists 被重算
+struct CoverageDelta {
+    CoverageSummary before;
+    CoverageSummary after;
+    OpId first_changed_op{0};
+};
+
+// 以整數計數追蹤每個 (fault, orientation) 群組在三階段的命中次數。
+// 群組權重以 0.5 為單位（Single=2、LT/GT=1），覆蓋率與 Reporter 的加總逐位元相同。
+class CoverageCounter {
+public:
+    enum Stage { State = 0, Sens = 1, Detect = 2 };
+    void build(const PreparedFaultSet& prepared);
+    void reset();
+    void add(Stage s, TpGid tp_gid);
+    void remove(Stage s, TpGid tp_gid);
+    bool covered(Stage s, TpGid tp_gid) const { return hits_[s][tp2group_[tp_gid]] != 0; } // tp 所屬群組已命中
+    CoverageSummary summary() const;
+private:
+    vector<GroupId> tp2group_;                // tp → group（同 PreparedFaultSet::group_of_tp）
+    vector<int> group_halves_;                // group 權重（0.5 的倍數；不計分的群組為 0）
+    array<vector<unsigned>, 3> hits_;         // [stage][group] → 命中次數
+    array<long long, 3> covered_halves_{};    // [stage] → 已命中群組權重總和
+    size_t fault_num_{0};
+};
+
+inline void CoverageCounter::build(const PreparedFaultSet& prepared) {
+    fault_num_ = prepared.faults().size();
+    tp2group_.resize(prepared.tps().size());
+    for (TpGid t = 0; t < tp2group_.size(); ++t) tp2group_[t] = prepared.group_of_tp(t);
+    group_halves_.resize(prepared.group_count());
+    for (GroupId g = 0; g < group_halves_.size(); ++g) group_halves_[g] = prepared.group_halves(g);
+    reset();
+}
+
+inline void CoverageCounter::reset() {
+    for (auto& h : hits_) h.assign(group_halves_.size(), 0);
+    covered_halves_.fill(0);
+}
+
+inline void CoverageCounter::add(Stage s, TpGid tp_gid) {
+    GroupId g = tp2group_[tp_gid];
+    if (hits_[s][g]++ == 0) covered_halves_[s] += group_halves_[g];
+}
+
+inline void CoverageCounter::remove(Stage s, TpGid tp_gid) {
+    GroupId g = tp2group_[tp_gid];
+    if (--hits_[s][g] == 0) covered_halves_[s] -= group_halves_[g];
+}
+
+inline CoverageSummary CoverageCounter::summary() const {
+    CoverageSummary out;
+    if (fault_num_ == 0) return out;
+    double n = static_cast<double>(fault_num_);
+    out.state_coverage  = (covered_halves_[State]  * 0.5) / n;
+    out.sens_coverage   = (covered_halves_[Sens]   * 0.5) / n;
+    out.detect_coverage = (covered_halves_[Detect] * 0.5) / n;
+    out.total_coverage  = out.detect_coverage;
+    return out;
+}
+
+// 候選 March test 的前綴樹：根是共同起點（模擬器目前的前綴），每個節點在 parent 之後多接一個 element。
+// 共用前綴的候選只需模擬一次前綴，分岔後各自模擬（見 IncrementalSimulator / PrefixSummarySimulator 的 simulate_batch）
+class MarchPrefixTrie {
+public:
+    using NodeId = int;
+    static constexpr NodeId ROOT = 0;
+
+    MarchPrefixTrie() { clear(); }
+    void clear() {
+        parent_.assign(1, -1);
+        elem_.assign(1, MarchElement{});
+        kids_.assign(1, vector<NodeId>{});
+    }
+    size_t size() const { return parent_.size(); }
+    NodeId parent(NodeId n) const { return parent_[n]; }
+    const MarchElement& element(NodeId n) const { return elem_[n]; }
+    const vector<NodeId>& children(NodeId n) const { return kids_[n]; }
+
+    // 在 parent 後接一個 element（不與既有的子節點合併）
+    NodeId add_child(NodeId parent, const MarchElement& elem);
+    // 沿既有路徑合併相同的 element，回傳 mt 的末端節點（空 March test 即根）
+    NodeId insert(const MarchTest& mt);
+
+    // 前序走訪：enter(n) 接上 element(n)、visit(n) 讀結果、子樹走完後 leave(n) 撤掉；根只 visit
+    template <class Enter, class Visit, class Leave>
+    void walk(Enter&& enter, Visit&& visit, Leave&& leave) const;
+
+private:
+    vector<NodeId> parent_;
+    vector<MarchElement> elem_;
+    vector<vector<NodeId>> kids_;
+
+    static bool same_element(const MarchElement& a, const MarchElement& b) {
+        if (a.order != b.order || a.ops.size() != b.ops.size()) return false;
+        for (size_t i = 0; i < a.ops.size(); ++i) if (encode_op(a.ops[i]) != encode_op(b.ops[i])) return false;
+        return true;
+    }
+};
+
+inline MarchPrefixTrie::NodeId MarchPrefixTrie::add_child(NodeId parent, const MarchElement& elem) {
+    NodeId n = (NodeId)parent_.size();
+    parent_.push_back(parent);
+    elem_.push_back(elem);
+    kids_.emplace_back();
+    kids_[parent].push_back(n);
+    return n;
+}
+
+inline MarchPrefixTrie::NodeId MarchPrefixTrie::insert(const MarchTest& mt) {
+    NodeId n = ROOT;
+    for (const auto& e : mt.elements) {
+        NodeId next = -1;
+        for (NodeId c : kids_[n]) if (same_element(elem_[c], e)) { next = c; break; }
+        n = (next >= 0) ? next : add_child(n, e);
+    }
+    return n;
+}
+
+template <class Enter, class Visit, class Leave>
+inline void MarchPrefixTrie::walk(Enter&& enter, Visit&& visit, Leave&& leave) const {
+    visit(ROOT);
+    vector<pair<NodeId, size_t>> stack{{ROOT, 0}}; // (節點, 下一個要走的子節點)
+    while (!stack.empty()) {
+        NodeId n = stack.back().first;
+        if (stack.back().second == kids_[n].size()) {
+            stack.pop_back();
+            if (n != ROOT) leave(n);
+            continue;
+        }
+        NodeId c = kids_[n][stack.back().second++];
+        enter(c);
+        visit(c);
+        stack.emplace_back(c, 0);
+    }
+}
+
+// 可延伸的模擬狀態：append 只影響最後一個 element（其 D2/C 哨兵會變，整個 element 的 pre_state 都要重推），
+// 以及之前 element 中「錨點尚未出現（;）」或「往後掃描掃到表尾」的偵測。
+// 其他 op 的結果與完整 simulate 相同，cover_lists 內的順序也相同。
+class IncrementalSimulator {
+public:
+    explicit IncrementalSimulator(const PreparedFaultSet& prepared);
+    IncrementalSimulator(const vector<Fault>& faults, const vector<TestPrimitive>& tps);
+
+    // 從空前綴重來；assign 等同逐個 append_element
+    void reset();
+    void assign(const MarchTest& mt);
+
+    // fault dropping：群組一旦被偵測，其 TP 在之後的 state / sens / detect 都跳過（也不再追 pending）。
+    // 撤掉的只有與它同 element 或更晚的 op，而偵測 ⊂ 致敏 ⊂ state，所以 summary() 與不開時逐位元相同；
+    // cover_lists() / result() 則不再列出被跳過的 TP。只看覆蓋率的搜尋用；請在 reset / assign 前設定
+    void set_fault_dropping(bool on) { fault_dropping_ = on; }
+    bool fault_dropping() const { return fault_dropping_; }
+
+    CoverageDelta append_element(const MarchElement& elem);
+    CoverageDelta append_op(const Op& op); // 加到最後一個 element
+    // 回到較短的前綴：保留前 elem_count 個 element，且最後一個只留 last_elem_ops 個 op
+    void truncate(size_t elem_count, size_t last_elem_ops);
+    void pop_op();      // 移除最後一個 element 的最後一個 op
+    void pop_element(); // 移除最後一個 element
+
+    const MarchTest& march_test() const { return mt_; }
+    const OpTable& op_table() const { return op_table_; }
+    const vector<RawCoverLists>& cover_lists() const { return cover_lists_; }
+    CoverageSummary summary() const { return counter_.summary(); }
+    // 實體化成與 FaultSimulator::simulate(march_test(), faults, tps) 相同的結果
+    SimulationResult result() const;
+    // 同上，但寫進 out 並沿用它的緩衝（同 FaultSimulator::simulate 的 out 版本）
+    void result(SimulationResult& out) const;
+
+    // trie 的節點接在目前前綴之後：沿前序 append_element / pop_element，每個不同前綴只模擬一次。
+    // visit(n, *this) 時模擬器停在節點 n；走完回到原本的前綴
+    template <class Visit>
+    void simulate_batch(const MarchPrefixTrie& trie, Visit&& visit) {
+        trie.walk([&](MarchPrefixTrie::NodeId n) { append_element(trie.element(n)); },
+                  [&](MarchPrefixTrie::NodeId n) { visit(n, static_cast<const IncrementalSimulator&>(*this)); },
+                  [&](MarchPrefixTrie::NodeId) { pop_element(); });
+    }
+
+private:
+    // 尚未定案的偵測：resume == -1 表錨點（;）還不存在，否則表示下次從 resume 繼續往後掃
+    struct PendingDetect {
+        OpId state_op;
+        TpGid tp_gid;
+        OpId sens_end;
+        OpId resume;
+    };
+    // 每個 element 開始時的快照：第一個 op 的索引 + 來自更早 element 的 pending
+    struct Frame {
+        size_t first_op;
+        vector<PendingDetect> pending;
+    };
+
+    std::unique_ptr<PreparedFaultSet> owned_prepared_; // 只在以 faults/tps 建構時持有
+    const PreparedFaultSet& prepared_;
+    const vector<TestPrimitive>& tps_;
+    OpTableBuilder op_table_builder_;
+    DetectEngine detect_engine_;
+    Reporter reporter_;
+    CoverageCounter counter_;
+    TPPatternAutomaton::MatchBuffer sens_match_;
+
+    MarchTest mt_;
+    OpTable op_table_;
+    vector<RawCoverLists> cover_lists_;
+    vector<Frame> frames_; // frames_[e] ↔ mt_.elements[e]
+    vector<PendingDetect> pending_;
+    bool fault_dropping_{false};
+
+    void resimulate_last_element();
+    void drop_cover_lists_from(size_t first_op);
+    // 回傳 true 表示偵測已定案（不論有無命中）
+    bool resolve_pending(PendingDetect& p);
+    void push_detect(TpGid tp_gid, const DetectOutcome& det);
+};
+
+inline IncrementalSimulator::IncrementalSimulator(const PreparedFaultSet& prepared)
+    : prepared_(prepared), tps_(prepared.tps()) {
+    counter_.build(prepared_);
+    reset();
+}
+
+inline IncrementalSimulator::IncrementalSimulator(const vector<Fault>& faults, const vector<TestPrimitive>& tps)
+    : owned_prepared_(std::make_unique<PreparedFaultSet>(faults, tps)), prepared_(*owned_prepared_), tps_(tps) {
+    counter_.build(prepared_);
+    reset();
+}
+
+inline void IncrementalSimulator::reset() {
+    mt_.elements.clear();
+    op_table_.clear();
+    cover_lists_.clear();
+    frames_.clear();
+    pending_.clear();
+    counter_.reset();
+}
+
+inline void IncrementalSimulator::assign(const MarchTest& mt) {
+    reset();
+    mt_.name = mt.name;
+    for (const auto& e : mt.elements) append_element(e);
+}
+
+inline CoverageDelta IncrementalSimulator::append_element(const MarchElement& elem) {
+    CoverageDelta d;
+    d.before = summary();
+    d.first_changed_op = (OpId)op_table_.size();
+    frames_.push_back(Frame{op_table_.size(), pending_});
+    mt_.elements.push_back(elem);
+    resimulate_last_element();
+    d.after = summary();
+    return d;
+}
+
+inline CoverageDelta IncrementalSimulator::append_op(const Op& op) {
+    if (mt_.elements.empty()) throw runtime_error("IncrementalSimulator::append_op: no element to append to");
+    CoverageDelta d;
+    d.before = summary();
+    d.first_changed_op = (OpId)frames_.back().first_op;
+    mt_.elements.back().ops.push_back(op);
+    resimulate_last_element();
+    d.after = summary();
+    return d;
+}
+
+inline void IncrementalSimulator::truncate(size_t elem_count, size_t last_elem_ops) {
+    if (elem_count > mt_.elements.size()) throw runtime_error("IncrementalSimulator::truncate: elem_count out of range");
+    if (elem_count == 0) { reset(); return; }
+    if (last_elem_ops > mt_.elements[elem_count - 1].ops.size()) {
+        throw runtime_error("IncrementalSimulator::truncate: last_elem_ops out of range");
+    }
+    mt_.elements.resize(elem_count);
+    frames_.resize(elem_count);
+    mt_.elements.back().ops.resize(last_elem_ops);
+    resimulate_last_element();
+}
+
+inline void IncrementalSimulator::pop_op() {
+    if (mt_.elements.empty() || mt_.elements.back().ops.empty()) {
+        throw runtime_error("IncrementalSimulator::pop_op: last element has no op");
+    }
+    truncate(mt_.elements.size(), mt_.elements.back().ops.size() - 1);
+}
+
+inline void IncrementalSimulator::pop_element() {
+    if (mt_.elements.empty()) throw runtime_error("IncrementalSimulator::pop_element: no element");
+    // 最後一個 element 的所有 push（含它接續的 pending）都落在 first_op 之後，
+    // 撤掉這些列、還原 pending 即回到 append 之前；前一個 element 不必重算
+    Frame& fr = frames_.back();
+    drop_cover_lists_from(fr.first_op);
+    pending_ = std::move(fr.pending);
+    frames_.pop_back();
+    mt_.elements.pop_back();
+    // 截掉 op 列，並把前綴指向被截部分的 ; / next 索引改回 -1
+    op_table_builder_.rebuild_tail(mt_, op_table_, (int)mt_.elements.size());
+    sens_match_.start = -1;
+}
+
+inline SimulationResult IncrementalSimulator::result() const {
+    SimulationResult result;
+    this->result(result);
     return result;
 }
 
-using GroupId = size_t;         // 覆蓋群組 id
+inline void IncrementalSimulator::result(SimulationResult& out) const {
+    if (mt_.elements.empty() || prepared_.faults().empty()) {
+        out.clear();
+        return;
+    }
+    out.op_table = op_table_;       // 複製指派：沿用 out 既有的容量
+    out.cover_lists = cover_lists_;
+    reporter_.build(prepared_, out);
+}
+
+inline void IncrementalSimulator::drop_cover_lists_from(size_t first_op) {
+    for (size_t op_id = first_op; op_id < cover_lists_.size(); ++op_id) {
+        const auto& cl = cover_lists_[op_id];
+        for (auto g : cl.state_cover) counter_.remove(CoverageCounter::State, g);
+        for (auto g : cl.sens_cover)  counter_.remove(CoverageCounter::Sens, g);
+        for (auto g : cl.det_cover)   counter_.remove(CoverageCounter::Detect, g);
+    }
+    if (cover_lists_.size() > first_op) cover_lists_.resize(first_op);
+}
+
+inline void IncrementalSimulator::push_detect(TpGid tp_gid, const DetectOutcome& det) {
+    if (det.det_op != -1) {
+        cover_lists_[det.det_op].det_cover.push_back(tp_gid);
+        counter_.add(CoverageCounter::Detect, tp_gid);
+    }
+    if (det.mask_at_op != -1) {
+        cover_lists_[det.mask_at_op].masked.push_back(MaskOutcome{tp_gid, MaskOutcome::Status::AllMasked});
+    }
+}
+
+inline bool IncrementalSimulator::resolve_pending(PendingDetect& p) {
+    const TestPrimitive& tp = tps_[p.tp_gid];
+    if (p.resume < 0) {
+        OpId anchor = detect_engine_.anchor_of(op_table_, p.sens_end, tp);
+        if (anchor < 0) {
+            // 只有 ; 會等到下一個非空 element 出現；# 在已收尾的 element 內找不到就是找不到
+            return tp.detector.pos != PositionMark::NextElementHead;
+        }
+        if (!tp.F_has_value) {
+            push_detect(p.tp_gid, detect_engine_.cover(op_table_, p.sens_end, tp));
+            return true;
+        }
+        p.resume = anchor;
+    }
+    DetectOutcome det = detect_engine_.scan_from(op_table_, p.resume, tp);
+    if (det.status == DetectOutcome::Status::NoDetectorReachable) {
+        p.resume = (OpId)op_table_.size();
+        return false;
+    }
+    push_detect(p.tp_gid, det);
+    return true;
+}
+
+inline void IncrementalSimulator::resimulate_last_element() {
+    const Frame& fr = frames_.back();
+    // 1) 撤掉最後一個 element 的舊結果（含先前 pending 落在這裡的命中）
+    drop_cover_lists_from(fr.first_op);
+    // 2) 重建最後一個 element 的 op 列與哨兵，並補上前一 element 的 ;
+    op_table_builder_.rebuild_tail(mt_, op_table_, (int)mt_.elements.size() - 1);
+    cover_lists_.resize(op_table_.size());
+
+    // fault dropping：所屬群組已被偵測的 TP 不會再改變任何一階段的覆蓋率
+    auto dropped = [&](TpGid tp_gid) { return fault_dropping_ && counter_.covered(CoverageCounter::Detect, tp_gid); };
+
+    // 3) 先接續更早 element 的 pending（它們的 state op 較早，push 順序與完整 simulate 相同）
+    vector<PendingDetect> still_pending;
+    for (PendingDetect p : fr.pending) {
+        if (dropped(p.tp_gid)) continue;
+        if (!resolve_pending(p)) still_pending.push_back(p);
+    }
+
+    // 4) 最後一個 element 內逐 op 三階段模擬（同 FaultSimulator::simulate）
+    const TPPatternAutomaton& automaton = prepared_.sens_automaton();
+    sens_match_.start = -1; // op 列已重建
+    for (size_t op_id = fr.first_op; op_id < op_table_.size(); ++op_id) {
+        TpSpan state_tps = prepared_.state_cover(op_table_.state_key((OpId)op_id));
+        vector<TpGid>& state_cover = cover_lists_[op_id].state_cover;
+        if (!fault_dropping_) {
+            state_cover.assign(state_tps.begin(), state_tps.end());
+        } else {
+            state_cover.clear();
+            for (TpGid tp_gid : state_tps) if (!dropped(tp_gid)) state_cover.push_back(tp_gid);
+        }
+        for (TpGid tp_gid : state_cover) {
+            counter_.add(CoverageCounter::State, tp_gid);
+            auto sens_result = automaton.cover(op_table_, (OpId)op_id, tp_gid, sens_match_);
+            if (sens_result.status == SensOutcome::Status::SensNone) continue;
+            if (sens_result.status == SensOutcome::Status::SensPartial) {
+                cover_lists_[sens_result.sens_mask_at_op].masked.push_back(
+                    MaskOutcome{tp_gid, MaskOutcome::Status::PartMasked});
+                continue;
+            }
+            cover_lists_[sens_result.sens_end_op].sens_cover.push_back(tp_gid);
+            counter_.add(CoverageCounter::Sens, tp_gid);
+
+            PendingDetect p{(OpId)op_id, tp_gid, sens_result.sens_end_op, -1};
+            if (tps_[tp_gid].R_has_value) {
+                push_detect(tp_gid, detect_engine_.cover(op_table_, p.sens_end, tps_[tp_gid]));
+            } else if (!resolve_pending(p)) {
+                still_pending.push_back(p);
+            }
+        }
+    }
+    pending_ = std::move(still_pending);
+}
+
+// 只算覆蓋率、可延伸也可撤銷的前綴模擬（類別層級，結果同 FaultSimulator::simulate_summary）。
+// push_element 只模擬新 element 與更早 element 尚未定案的偵測；pop_element 依命中紀錄撤回群組旗標，
+// 不重算前一個 element。搜尋器以 simulate_batch 走前綴樹，每個不同前綴只模擬一次。
+class PrefixSummarySimulator {
+public:
+    explicit PrefixSummarySimulator(const PreparedFaultSet& prepared);
+
+    void reset();
+    void assign(const MarchTest& mt);
+    void push_element(const MarchElement& elem);
+    void pop_element();
+
+    const MarchTest& march_test() const { return mt_; }
+    CoverageSummary summary() const;
+    // out[n] 為「目前前綴 + 根到 n 的 element」的覆蓋率（out[ROOT] 即目前前綴）；走完回到原本的前綴
+    void simulate_batch(const MarchPrefixTrie& trie, vector<CoverageSummary>& out);
+
+private:
+    // 尚未定案的偵測（以類別代表）：resume == -1 表錨點（;）還不存在，否則下次從 resume 繼續往後掃
+    struct PendingDetect {
+        TpClassId cls;
+        OpId sens_end;
+        OpId resume;
+    };
+    // 每個 element 開始時的快照：第一個 op、命中紀錄長度、來自更早 element 的 pending
+    struct Frame {
+        size_t first_op;
+        size_t hit_log_size;
+        vector<PendingDetect> pending;
+    };
+
+    const PreparedFaultSet& prepared_;
+    OpTableBuilder op_table_builder_;
+    DetectEngine detect_engine_;
+    TPPatternAutomaton::MatchBuffer sens_match_;
+
+    MarchTest mt_;
+    OpTable op_table_;
+    array<vector<uint8_t>, 3> group_hit_;       // [stage][group] → 是否已命中
+    array<long long, 3> covered_halves_{};      // [stage] → 已命中群組權重（0.5 為單位）
+    vector<pair<uint8_t, GroupId>> hit_log_;    // 依序新命中的 (stage, group)，pop 時倒回
+    vector<Frame> frames_;                      // frames_[e] ↔ mt_.elements[e]；只增不減，重複使用 pending 緩衝
+    vector<PendingDetect> pending_;
+
+    void mark(int stage, GroupSpan groups);
+    bool all_hit(int stage, GroupSpan groups) const;
+    // 回傳 true 表示偵測已定案（不論有無命中）
+    bool resolve_pending(PendingDetect& p);
+};
+
+inline PrefixSummarySimulator::PrefixSummarySimulator(const PreparedFaultSet& prepared) : prepared_(prepared) {
+    reset();
+}
+
+inline void PrefixSummarySimulator::reset() {
+    mt_.elements.clear();
+    op_table_.clear();
+    for (auto& h : group_hit_) h.assign(prepared_.group_count(), 0);
+    covered_halves_.fill(0);
+    hit_log_.clear();
+    pending_.clear();
+    sens_match_.start = -1;
+}
+
+inline void PrefixSummarySimulator::assign(const MarchTest& mt) {
+    reset();
+    mt_.name = mt.name;
+    for (const auto& e : mt.elements) push_element(e);
+}
+
+inline void PrefixSummarySimulator::mark(int stage, GroupSpan groups) {
+    for (GroupId g : groups) {
+        if (group_hit_[stage][g]) continue;
+        group_hit_[stage][g] = 1;
+        covered_halves_[stage] += prepared_.group_halves(g);
+        hit_log_.emplace_back((uint8_t)stage, g);
+    }
+}
+
+inline bool PrefixSummarySimulator::all_hit(int stage, GroupSpan groups) const {
+    for (GroupId g : groups) if (!group_hit_[stage][g]) return false;
+    return true;
+}
+
+inline bool PrefixSummarySimulator::resolve_pending(PendingDetect& p) {
+    const TestPrimitive& tp = prepared_.tps()[prepared_.class_rep(p.cls)];
+    if (p.resume < 0) {
+        OpId anchor = detect_engine_.anchor_of(op_table_, p.sens_end, tp);
+        if (anchor < 0) {
+            // 只有 ; 會等到下一個非空 element 出現
+            return tp.detector.pos != PositionMark::NextElementHead;
+        }
+        if (!tp.F_has_value) {
+            if (detect_engine_.cover(op_table_, p.sens_end, tp).det_op != -1) mark(2, prepared_.class_groups(p.cls));
+            return true;
+        }
+        p.resume = anchor;
+    }
+    DetectOutcome det = detect_engine_.scan_from(op_table_, p.resume, tp);
+    if (det.status == DetectOutcome::Status::NoDetectorReachable) {
+        p.resume = (OpId)op_table_.size();
+        return false;
+    }
+    if (det.det_op != -1) mark(2, prepared_.class_groups(p.cls));
+    return true;
+}
+
+inline void PrefixSummarySimulator::push_element(const MarchElement& elem) {
+    if (frames_.size() <= mt_.elements.size()) frames_.emplace_back();
+    Frame& fr = frames_[mt_.elements.size()];
+    fr.first_op = op_table_.size();
+    fr.hit_log_size = hit_log_.size();
+    fr.pending.swap(pending_); // 進入前的 pending 存進快照，pending_ 改收仍未定案者
+    pending_.clear();
+    mt_.elements.push_back(elem);
+    op_table_builder_.rebuild_tail(mt_, op_table_, (int)mt_.elements.size() - 1);
+    sens_match_.start = -1;
+
+    // 1) 先接續更早 element 的 pending；群組都已偵測到的不必再掃
+    for (PendingDetect p : fr.pending) {
+        if (all_hit(2, prepared_.class_groups(p.cls))) continue;
+        if (!resolve_pending(p)) pending_.push_back(p);
+    }
+    // 2) 新 element 內逐 op 三階段模擬（同 FaultSimulator::simulate_summary）
+    const TPPatternAutomaton& automaton = prepared_.sens_automaton();
+    for (size_t op_id = fr.first_op; op_id < op_table_.size(); ++op_id) {
+        for (TpClassId c : prepared_.class_state_cover(op_table_.state_key((OpId)op_id))) {
+            GroupSpan groups = prepared_.class_groups(c);
+            if (groups.empty()) continue; // 成員都屬不計分的群組
+            mark(0, groups);
+            if (all_hit(1, groups) && all_hit(2, groups)) continue;
+
+            TpGid rep = prepared_.class_rep(c);
+            auto sens_result = automaton.cover(op_table_, (OpId)op_id, rep, sens_match_);
+            if (sens_result.status == SensOutcome::Status::SensNone ||
+                sens_result.status == SensOutcome::Status::SensPartial) continue;
+            mark(1, groups);
+            if (all_hit(2, groups)) continue;
+
+            PendingDetect p{c, sens_result.sens_end_op, -1};
+            if (prepared_.tps()[rep].R_has_value) {
+                if (detect_engine_.cover(op_table_, p.sens_end, prepared_.tps()[rep]).det_op != -1) mark(2, groups);
+            } else if (!resolve_pending(p)) {
+                pending_.push_back(p);
+            }
+        }
+    }
+}
+
+inline void PrefixSummarySimulator::pop_element() {
+    if (mt_.elements.empty()) throw runtime_error("PrefixSummarySimulator::pop_element: no element");
+    Frame& fr = frames_[mt_.elements.size() - 1];
+    while (hit_log_.size() > fr.hit_log_size) {
+        auto [stage, g] = hit_log_.back();
+        hit_log_.pop_back();
+        group_hit_[stage][g] = 0;
+        covered_halves_[stage] -= prepared_.group_halves(g);
+    }
+    pending_.swap(fr.pending);
+    mt_.elements.pop_back();
+    // 只截掉 op 列：前綴中指向被截部分的 ; / next 索引由下一次 push 的 rebuild_tail 修正（op table 不對外）
+    op_table_.resize(fr.first_op);
+    sens_match_.start = -1;
+}
+
+inline CoverageSummary PrefixSummarySimulator::summary() const {
+    CoverageSummary out;
+    if (mt_.elements.empty() || prepared_.faults().empty()) return out;
+    double n = static_cast<double>(prepared_.faults().size());
+    out.state_coverage  = (covered_halves_[0] * 0.5) / n;
+    out.sens_coverage   = (covered_halves_[1] * 0.5) / n;
+    out.detect_coverage = (covered_halves_[2] * 0.5) / n;
+    out.total_coverage  = out.detect_coverage;
+    return out;
+}
+
+inline void PrefixSummarySimulator::simulate_batch(const MarchPrefixTrie& trie, vector<CoverageSummary>& out) {
+    out.assign(trie.size(), CoverageSummary{});
+    trie.walk([&](MarchPrefixTrie::NodeId n) { push_element(trie.element(n)); },
+              [&](MarchPrefixTrie::NodeId n) { out[n] = summary(); },
+              [&](MarchPrefixTrie::NodeId) { pop_element(); });
+}
+
+// =============================================================
+//  Bit-parallel batch simulation（只算覆蓋率）
+//  beam 展開時上百個候選只差最後一個 element，這裡一次模擬最多 64 個 March test，
+//  每個候選佔一條 lane（uint64_t 的一位）：
+//  - 逐 op 位置推進；同一位置 state key 相同的 lanes 一起做 state cover
+//  - sensitizer 以 lane mask 走 TP trie，整段匹配的 lanes 一次得到
+//  - 群組命中旗標是 [stage][group] → lanes，是否還需模擬也是整個 word 判斷
+//  偵測的錨點 / 往後掃描依各 lane 的 op table 查表，以 (序列結束位置, detector) 快取。
+//  每條 lane 的覆蓋率與 FaultSimulator::simulate_summary 逐位元相同。
+// =============================================================
+class BitParallelSimulator {
+public:
+    using LaneMask = uint64_t;
+    static constexpr size_t LANES = 64;
+
+    explicit BitParallelSimulator(const PreparedFaultSet& prepared);
+
+    // 依序每 LANES 個一批；out[i] 為 *mts[i] 的覆蓋率
+    void simulate(const vector<const MarchTest*>& mts, vector<CoverageSummary>& out);
+    vector<CoverageSummary> simulate(const vector<MarchTest>& mts);
+
+private:
+    const PreparedFaultSet& prepared_;
+    OpTableBuilder op_table_builder_;
+    DetectEngine detect_engine_;
+    vector<OpTable> lane_opt_;          // [lane]，重複使用
+    size_t lane_num_{0};
+    size_t pos_num_{0};                 // 本批最長 op table 的長度
+    int max_seq_len_{0};
+    vector<LaneMask> active_;           // [pos] → op table 長度 > pos 的 lanes
+    vector<LaneMask> same_next_;        // [pos] → pos+1 仍在同一 element 的 lanes
+    vector<LaneMask> pattern_;          // [pos * OP_CODE_NUM + pattern] → 該位置的 op 被 pattern 匹配的 lanes
+    vector<pair<size_t, LaneMask>> key_lanes_; // 目前位置：state key → lanes
+    vector<LaneMask> in_elem_;          // [d] → 目前位置起第 d 個 op 仍在同一 element 的 lanes
+    vector<LaneMask> seq_full_;         // [seq] → 目前位置起整段匹配的 lanes
+    vector<TPPatternAutomaton::LaneFrame> stack_;
+    // 偵測快取：[end * DET_VARIANT_NUM + detector 變體] → 已算過 / 偵測成功的 lanes
+    static constexpr size_t DET_VARIANT_NUM = 3 * 2 * OP_CODE_NUM * 2; // pos × 無 sensitizer × detectOp × F
+    vector<LaneMask> det_known_;
+    vector<LaneMask> det_hit_;
+    array<vector<LaneMask>, 3> group_hit_; // [stage][group] → 已命中的 lanes
+
+    void run_batch(const MarchTest* const* mts, size_t lane_num, CoverageSummary* out);
+    void build_lane_tables(const MarchTest* const* mts);
+    LaneMask detect_lanes(OpId end, TpGid rep, LaneMask lanes);
+};
+
+inline BitParallelSimulator::BitParallelSimulator(const PreparedFaultSet& prepared)
+    : prepared_(prepared), lane_opt_(LANES), max_seq_len_(prepared.sens_automaton().max_seq_length()) {
+    in_elem_.resize(max_seq_len_ + 1);
+}
+
+inline vector<CoverageSummary> BitParallelSimulator::simulate(const vector<MarchTest>& mts) {
+    vector<const MarchTest*> ptrs;
+    ptrs.reserve(mts.size());
+    for (const auto& mt : mts) ptrs.push_back(&mt);
+    vector<CoverageSummary> out;
+    simulate(ptrs, out);
+    return out;
+}
+
+inline void BitParallelSimulator::simulate(const vector<const MarchTest*>& mts, vector<CoverageSummary>& out) {
+    out.assign(mts.size(), CoverageSummary{});
+    if (prepared_.faults().empty()) return; // no faults
+    for (size_t first = 0; first < mts.size(); first += LANES) {
+        run_batch(mts.data() + first, std::min(LANES, mts.size() - first), out.data() + first);
+    }
+}
+
+inline void BitParallelSimulator::build_lane_tables(const MarchTest* const* mts) {
+    pos_num_ = 0;
+    for (size_t l = 0; l < lane_num_; ++l) {
+        if (mts[l]->elements.empty()) lane_opt_[l].clear(); // empty March test
+        else op_table_builder_.rebuild_tail(*mts[l], lane_opt_[l], 0);
+        pos_num_ = std::max(pos_num_, lane_opt_[l].size());
+    }
+    active_.assign(pos_num_, 0);
+    same_next_.assign(pos_num_, 0);
+    pattern_.assign(pos_num_ * OP_CODE_NUM, 0);
+    array<LaneMask, OP_CODE_NUM> code_lanes;
+    for (size_t pos = 0; pos < pos_num_; ++pos) {
+        code_lanes.fill(0);
+        for (size_t l = 0; l < lane_num_; ++l) {
+            const OpTable& opt = lane_opt_[l];
+            if (pos >= opt.size()) continue;
+            const LaneMask bit = LaneMask(1) << l;
+            active_[pos] |= bit;
+            if (pos + 1 < opt.size() && opt.elem_index((OpId)pos + 1) == opt.elem_index((OpId)pos)) same_next_[pos] |= bit;
+            code_lanes[opt.code((OpId)pos)] |= bit;
+        }
+        LaneMask* row = &pattern_[pos * OP_CODE_NUM];
+        for (int q = 0; q < OP_CODE_NUM; ++q) {
+            if (!code_lanes[q]) continue;
+            for (int p = 0; p < OP_CODE_NUM; ++p) if (op_code_match((OpCode)p, (OpCode)q)) row[p] |= code_lanes[q];
+        }
+    }
+    det_known_.assign(pos_num_ * DET_VARIANT_NUM, 0);
+    det_hit_.assign(pos_num_ * DET_VARIANT_NUM, 0);
+}
+
+// lanes 中以 rep 的 detector 自 end 起偵測成功者（與 DetectEngine::cover 相同），依 (end, detector) 快取
+inline BitParallelSimulator::LaneMask BitParallelSimulator::detect_lanes(OpId end, TpGid rep, LaneMask lanes) {
+    const TestPrimitive& tp = prepared_.tps()[rep];
+    if (tp.R_has_value) return lanes; // R 有值：sens 結束即偵測
+    size_t v = (size_t)tp.detector.pos * 2 + (tp.ops_before_detect.empty() ? 1 : 0);
+    v = (v * OP_CODE_NUM + encode_op(tp.detector.detectOp)) * 2 + (tp.F_has_value ? 1 : 0);
+    const size_t slot = (size_t)end * DET_VARIANT_NUM + v;
+    LaneMask todo = lanes & ~det_known_[slot];
+    for (size_t l = 0; todo; ++l, todo >>= 1) {
+        if (!(todo & 1)) continue;
+        if (detect_engine_.cover(lane_opt_[l], end, tp).det_op != -1) det_hit_[slot] |= LaneMask(1) << l;
+    }
+    det_known_[slot] |= lanes;
+    return det_hit_[slot] & lanes;
+}
+
+inline void BitParallelSimulator::run_batch(const MarchTest* const* mts, size_t lane_num, CoverageSummary* out) {
+    lane_num_ = lane_num;
+    build_lane_tables(mts);
+    for (auto& h : group_hit_) h.assign(prepared_.group_count(), 0);
+    const TPPatternAutomaton& automaton = prepared_.sens_automaton();
+
+    auto mark = [&](int stage, GroupSpan groups, LaneMask lanes) {
+        for (GroupId g : groups) group_hit_[stage][g] |= lanes;
+    };
+    // 所有群組都已命中的 lanes
+    auto all_hit = [&](int stage, GroupSpan groups) {
+        LaneMask m = ~LaneMask(0);
+        for (GroupId g : groups) m &= group_hit_[stage][g];
+        return m;
+    };
+    auto step = [&](size_t pos) {
+        return [this, pos](int d, OpCode code) -> LaneMask {
+            if (pos + d >= pos_num_) return 0;
+            return in_elem_[d] & pattern_[(pos + d) * OP_CODE_NUM + code];
+        };
+    };
+
+    for (size_t pos = 0; pos < pos_num_; ++pos) {
+        // 1) 依 state key 把 lanes 分組（前綴相同的候選大多落在同一組）
+        key_lanes_.clear();
+        for (size_t l = 0; l < lane_num_; ++l) {
+            if (pos >= lane_opt_[l].size()) continue;
+            size_t key = lane_opt_[l].state_key((OpId)pos);
+            auto it = std::find_if(key_lanes_.begin(), key_lanes_.end(), [&](const pair<size_t, LaneMask>& kl) { return kl.first == key; });
+            if (it == key_lanes_.end()) key_lanes_.emplace_back(key, LaneMask(1) << l);
+            else it->second |= LaneMask(1) << l;
+        }
+        bool matched = false; // 本位置的 trie 是否已走過
+        for (const auto& kl : key_lanes_) {
+            for (TpClassId c : prepared_.class_state_cover(kl.first)) {
+                GroupSpan groups = prepared_.class_groups(c);
+                if (groups.empty()) continue; // 成員都屬不計分的群組
+                mark(0, groups, kl.second);
+                // 成員群組的 sens 與 detect 都已命中的 lanes 不必再模擬
+                LaneMask sens = kl.second & ~(all_hit(1, groups) & all_hit(2, groups));
+                if (!sens) continue;
+
+                TpGid rep = prepared_.class_rep(c);
+                const int len = automaton.seq_length(automaton.seq_of_tp(rep));
+                if (len > 0) {
+                    if (!matched) {
+                        in_elem_[0] = active_[pos];
+                        for (int d = 1; d <= max_seq_len_; ++d) {
+                            in_elem_[d] = (pos + d < pos_num_) ? (in_elem_[d - 1] & same_next_[pos + d - 1]) : 0;
+                        }
+                        automaton.match_lanes(active_[pos], step(pos), seq_full_, stack_);
+                        matched = true;
+                    }
+                    sens &= seq_full_[automaton.seq_of_tp(rep)];
+                    if (!sens) continue;
+                }
+                mark(1, groups, sens);
+                LaneMask det = sens & ~all_hit(2, groups);
+                if (!det) continue;
+                const OpId end = (OpId)pos + std::max(len, 1) - 1; // 無 sensitizer：sens_end 即 state cover 的 op
+                mark(2, groups, detect_lanes(end, rep, det));
+            }
+        }
+    }
+    // 與 Reporter 相同：每個 fault 的覆蓋率是 0 / 0.5 / 1，加總後除以 fault 數
+    const double n = static_cast<double>(prepared_.faults().size());
+    for (size_t l = 0; l < lane_num_; ++l) {
+        array<long long, 3> covered_halves{}; // [stage] → 已命中群組權重（0.5 為單位）
+        for (int stage = 0; stage < 3; ++stage) {
+            for (GroupId g = 0; g < prepared_.group_count(); ++g) {
+                if (group_hit_[stage][g] >> l & 1) covered_halves[stage] += prepared_.group_halves(g);
+            }
+        }
+        out[l].state_coverage  = (covered_halves[0] * 0.5) / n;
+        out[l].sens_coverage   = (covered_halves[1] * 0.5) / n;
+        out[l].detect_coverage = (covered_halves[2] * 0.5) / n;
+        out[l].total_coverage  = out[l].detect_coverage;
+    }
+}
 
 struct GroupKey {
     string fault_id;
@@ -825,16 +2633,12 @@ struct GroupKey {
     }
 };
 
-struct GroupKeyHash {
-    std::size_t operator()(const GroupKey& k) const noexcept {
-        return std::hash<string>{}(k.fault_id) ^ (std::hash<int>{}(int(k.og))<<1);
-    }
-};
-
 class GroupIndex {
 public:
     // 構建：根據 faults 與 tps 建 tp→group 映射與 group_meta
     void build(const vector<TestPrimitive>& tps);
+    // 直接沿用 prepared 已建好的群組編號（編號規則相同）
+    void build(const PreparedFaultSet& prepared);
     void reset_coverage() { std::fill(group_covered_.begin(), group_covered_.end(), false); }
     void reset_state_flags() { 
         std::fill(group_state_flagged_.begin(), group_state_flagged_.end(), false); 
@@ -863,23 +2667,20 @@ private:
 };
 
 inline void GroupIndex::build(const vector<TestPrimitive>& tps) {
+    // 群組編號由 assign_dense_groups 以整數 group_idx 決定；重複 build 時延續既有編號往後加
+    vector<GroupId> dense;
+    size_t count = assign_dense_groups(tps, dense);
+    GroupId base = (GroupId)group_meta_.size();
     tp2group_.resize(tps.size(), -1);
-    unordered_map<GroupKey, GroupId, GroupKeyHash> key2gid;
+    group_meta_.resize(base + count);
+    group_sizes_.resize(base + count, 0);
+    group_is_static_.resize(base + count, false);
     for (TpGid t = 0; t < tps.size(); ++t) {
-        const auto& tp = tps[t];
-        GroupKey gk{tp.parent_fault_id, tp.group};
-        auto it = key2gid.find(gk);
-        if (it == key2gid.end()) {
-            GroupId gid = (GroupId)group_meta_.size();
-            key2gid.emplace(gk, gid);
-            group_meta_.push_back(gk);
-            key2gid[gk] = gid;
-            tp2group_[t] = gid;
-            group_sizes_.push_back(1);
-            group_is_static_.push_back(tp.ops_before_detect.empty());
-        } else {
-            tp2group_[t] = it->second;
-            group_sizes_[it->second]++;
+        GroupId gid = base + dense[t];
+        tp2group_[t] = (int)gid;
+        if (group_sizes_[gid]++ == 0) {
+            group_meta_[gid] = GroupKey{tps[t].parent_fault_id, tps[t].group};
+            group_is_static_[gid] = tps[t].ops_before_detect.empty();
         }
     }
     group_state_flagged_.resize(group_meta_.size(), false);
@@ -887,6 +2688,25 @@ inline void GroupIndex::build(const vector<TestPrimitive>& tps) {
     group_covered_.resize(group_meta_.size(), false);
 }
 
+inline void GroupIndex::build(const PreparedFaultSet& prepared) {
+    const auto& tps = prepared.tps();
+    tp2group_.assign(tps.size(), -1);
+    group_meta_.assign(prepared.group_count(), GroupKey{});
+    group_sizes_.assign(prepared.group_count(), 0);
+    group_is_static_.assign(prepared.group_count(), false);
+    for (TpGid t = 0; t < tps.size(); ++t) {
+        GroupId gid = prepared.group_of_tp(t);
+        tp2group_[t] = (int)gid;
+        if (group_sizes_[gid]++ == 0) {
+            group_meta_[gid] = GroupKey{tps[t].parent_fault_id, tps[t].group};
+            group_is_static_[gid] = tps[t].ops_before_detect.empty();
+        }
+    }
+    group_state_flagged_.assign(group_meta_.size(), false);
+    group_sens_flagged_.assign(group_meta_.size(), false);
+    group_covered_.assign(group_meta_.size(), false);
+}
+
 inline int GroupIndex::group_of_tp(size_t tp_gid) const {
     if (tp_gid >= tp2group_.size()) {
         throw runtime_error("GroupIndex::group_of_tp: invalid tp_gid: " + to_string(tp_gid));
@@ -985,6 +2805,7 @@ class OpScorer {
 public:
     vector<OpScoreOutcome> score_ops(const vector<RawCoverLists>& sim_results);
     void set_group_index(const vector<TestPrimitive>& tps) { group_index_.build(tps); }
+    void set_group_index(const PreparedFaultSet& prepared) { group_index_.build(prepared); }
     void set_weights(const ScoreWeights& w) { weights_ = w; }
 private:
     GroupIndex group_index_;
@@ -1165,13 +2986,16 @@ public:
 };
 
 struct SimulationEventResult {
-    vector<OpContext> op_table;
+    OpTable op_table;
     TPEventCenter events;
     GroupIndex tp_group;
 };
 
 class FaultSimulatorEvent {
 public:
+    // 設定後各 op 的 sens/detect 平行計算，再依 op 順序序列地登錄事件（event id 與序列版相同）
+    void set_thread_pool(ThreadPool* pool) { pool_ = pool; }
+
     SimulationEventResult simulate(const MarchTest& mt, const std::vector<Fault>& faults, const std::vector<TestPrimitive>& tps){
         SimulationEventResult out;
         if (mt.elements.empty() || faults.empty()) return out;
@@ -1179,11 +3003,29 @@ public:
         out.op_table = op_table_builder_.build(mt);
         state_cover_engine_.build_tp_buckets(tps);
         out.events.init(out.op_table.size(), tps.size());
-        for (size_t op_id = 0; op_id < out.op_table.size(); ++op_id){
-            auto state_tps = state_cover_engine_.cover(out.op_table[op_id].pre_state_key);
-            for (auto tp_gid : state_tps){
+        // 1) 每個 op 的 state cover 與 sens/detect 結果彼此獨立，可切段平行
+        const size_t n = out.op_table.size();
+        steps_.resize(n);
+        auto compute = [&](size_t b, size_t e, size_t){
+            for (size_t op_id = b; op_id < e; ++op_id){
+                auto& st = steps_[op_id];
+                st.clear();
+                for (auto tp_gid : state_cover_engine_.cover(out.op_table.state_key((OpId)op_id))){
+                    Step s{tp_gid, sens_engine_.cover(out.op_table, (OpId)op_id, tps[tp_gid]), DetectOutcome{}};
+                    if (s.sens.status == SensOutcome::Status::SensAll || s.sens.status == SensOutcome::Status::DontNeedSens)
+                        s.det = detect_engine_.cover(out.op_table, s.sens.sens_end_op, tps[tp_gid]);
+                    st.push_back(s);
+                }
+            }
+        };
+        if (pool_) pool_->parallel_for(n, pool_->concurrency(), compute);
+        else compute(0, n, 0);
+        // 2) 依 op 順序登錄事件
+        for (size_t op_id = 0; op_id < n; ++op_id){
+            for (const Step& st : steps_[op_id]){
+                const TpGid tp_gid = st.tp_gid;
                 auto evt = out.events.start_state(tp_gid, (OpId)op_id);
-                auto sens_res = sens_engine_.cover(out.op_table, (OpId)op_id, tps[tp_gid]);
+                const auto& sens_res = st.sens;
                 if (sens_res.status == SensOutcome::Status::SensNone) continue;
                 if (sens_res.status == SensOutcome::Status::SensPartial){
                     if (sens_res.sens_mask_at_op >= 0 && sens_res.sens_mask_at_op < (int)out.op_table.size())
@@ -1191,7 +3033,7 @@ public:
                     continue;
                 }
                 out.events.add_sens_complete(evt, sens_res.sens_end_op);
-                auto det_res = detect_engine_.cover(out.op_table, sens_res.sens_end_op, tps[tp_gid]);
+                const auto& det_res = st.det;
                 if (det_res.status == DetectOutcome::Status::Found && det_res.det_op >= 0){
                     out.events.set_detect(evt, det_res.det_op);
                     out.tp_group.mark_covered_if_new(tp_gid);
@@ -1206,5 +3048,13 @@ private:
     StateCoverEngine state_cover_engine_;
     SensEngine sens_engine_;
     DetectEngine detect_engine_;
+    // state cover 到某 op 的一個 TP 與它的 sens/detect 結果
+    struct Step {
+        TpGid tp_gid;
+        SensOutcome sens;
+        DetectOutcome det;
+    };
+    std::vector<std::vector<Step>> steps_; // [op]
+    ThreadPool* pool_{nullptr};
 };
 
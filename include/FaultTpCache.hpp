@@ -0,0 +1,433 @@
+#pragma once
+// =============================================================
+//  FaultTpCache.hpp — 正規化後的 faults 與產生好的 TPs 的二進位快取
+//  - load_fault_tp_set(json, cache_dir, pool)：cache_dir 下有同內容的快取就 mmap 還原，
+//    否則串流 parse JSON、在 pool 上平行 FaultNormalizer + TPGenerator，再把結果寫成快取
+//  - cache_dir 預設取環境變數 FAULT_TP_CACHE_DIR（見 default_fault_tp_cache_dir）
+//  - 快取以 faults.json 內容的 hash 命名，JSON 一改就自然失效；
+//    TP 產生規則或紀錄格式改變時要調 FAULT_TP_CACHE_VERSION
+//  - 檔案內全是固定大小的 POD 紀錄（Val 2 bits、CrossState 打包成 20 bits、字串集中在字元區），
+//    read-only 的 MAP_SHARED 映射可讓多個同時啟動的 process 共用同一份 page cache
+//  - 寫入先寫暫存檔再 rename，並行寫同一份快取也不會讀到半截的檔案
+// =============================================================
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <filesystem>
+#include <future>
+#include <iterator>
+#include <algorithm>
+#include <exception>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FpParserAndTpGen.hpp"
+#include "ThreadPool.hpp"
+
+// ---- precise using ----
+using std::uint8_t;
+using std::uint32_t;
+using std::int32_t;
+using std::uint64_t;
+using std::unordered_map;
+
+struct FaultTpSet {
+    vector<Fault> faults;
+    vector<TestPrimitive> tps;
+};
+
+inline constexpr uint32_t FAULT_TP_CACHE_VERSION = 1;
+
+namespace fault_tp_cache {
+
+// ---- 檔案紀錄（全部 trivially copyable，section 以 8 bytes 對齊）----
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;   // 0x01020304：寫入端與讀取端的 endianness 要一致
+    uint64_t content_hash; // faults.json 內容 + version
+    uint32_t n_faults, n_fps, n_ops, n_tps, n_chars, reserved;
+    uint64_t off_faults, off_fps, off_ops, off_tps, off_chars;
+};
+struct OpRec   { uint8_t kind, value, c_t, c_m, c_b; };
+struct SideRec { uint8_t pre_d, ci, last_d, pad; uint32_t op_begin, op_count; };
+struct FpRec   { SideRec sa, sv; uint8_t has_sa, fd, rd, co, s_has_any_op, pad[3]; };
+struct FaultRec {
+    uint32_t id_begin, id_len; // 字元區
+    int32_t fault_idx;
+    uint8_t category, scope, pad[2];
+    uint32_t fp_begin, fp_count;
+};
+struct TpRec {
+    uint32_t fault;     // FaultRec 索引（parent_fault_id / parent_fault_idx 由此還原）
+    uint32_t fp_index;
+    int32_t group_idx;
+    uint32_t state;     // 5 格 × (D, C) × 2 bits
+    uint32_t op_begin, op_count;
+    OpRec detect_op;
+    uint8_t group, pos, order, flags; // flags：F / R / C has value、has_set_Ci
+    uint8_t pad[3];
+};
+static_assert(std::is_trivially_copyable_v<Header> && std::is_trivially_copyable_v<FpRec> &&
+              std::is_trivially_copyable_v<FaultRec> && std::is_trivially_copyable_v<TpRec>, "cache records must be POD");
+
+inline constexpr char MAGIC[8] = {'M', 'T', 'F', 'T', 'P', 'C', 'C', 'H'};
+inline constexpr uint32_t BYTE_ORDER_MARK = 0x01020304u;
+enum : uint8_t { TP_F = 1, TP_R = 2, TP_C = 4, TP_SET_CI = 8 };
+
+// Val：0 / 1 / X → 0 / 1 / 2；optional 為 nullopt → 3
+inline uint8_t pack_val(Val v) { return v == Val::Zero ? 0 : v == Val::One ? 1 : 2; }
+inline uint8_t pack_val(const optional<Val>& v) { return v ? pack_val(*v) : 3; }
+inline Val unpack_val(uint8_t b) {
+    if (b > 2) throw runtime_error("fault cache: bad value code");
+    return b == 0 ? Val::Zero : b == 1 ? Val::One : Val::X;
+}
+inline optional<Val> unpack_opt_val(uint8_t b) { return b == 3 ? optional<Val>{} : optional<Val>{unpack_val(b)}; }
+
+inline OpRec pack_op(const Op& op) {
+    return OpRec{static_cast<uint8_t>(op.kind), pack_val(op.value), pack_val(op.C_T), pack_val(op.C_M), pack_val(op.C_B)};
+}
+inline Op unpack_op(const OpRec& r) {
+    if (r.kind > static_cast<uint8_t>(OpKind::ComputeAnd)) throw runtime_error("fault cache: bad op kind");
+    Op op{static_cast<OpKind>(r.kind)};
+    op.value = unpack_val(r.value); op.C_T = unpack_val(r.c_t); op.C_M = unpack_val(r.c_m); op.C_B = unpack_val(r.c_b);
+    return op;
+}
+
+inline uint32_t pack_state(const CrossState& s) {
+    const DC* cells[5] = {&s.A0, &s.A1, &s.A2_CAS, &s.A3, &s.A4};
+    uint32_t out = 0;
+    for (int i = 0; i < 5; ++i) out |= uint32_t(pack_val(cells[i]->D) | pack_val(cells[i]->C) << 2) << (4 * i);
+    return out;
+}
+inline CrossState unpack_state(uint32_t b) {
+    CrossState s;
+    DC* cells[5] = {&s.A0, &s.A1, &s.A2_CAS, &s.A3, &s.A4};
+    for (int i = 0; i < 5; ++i) { cells[i]->D = unpack_val(b >> (4 * i) & 3); cells[i]->C = unpack_val(b >> (4 * i + 2) & 3); }
+    return s;
+}
+
+// FNV-1a 64，再混入格式版本
+inline uint64_t content_hash(const string& bytes) {
+    uint64_t h = 1469598103934665603ull;
+    for (unsigned char c : bytes) { h ^= c; h *= 1099511628211ull; }
+    h ^= FAULT_TP_CACHE_VERSION; h *= 1099511628211ull;
+    return h;
+}
+
+inline string read_file(const string& path) {
+    ifstream ifs(path, std::ios::binary);
+    if (!ifs) throw runtime_error("Cannot open file: " + path);
+    std::ostringstream ss; ss << ifs.rdbuf();
+    return ss.str();
+}
+
+inline string cache_file_name(uint64_t hash) {
+    static const char* hex = "0123456789abcdef";
+    string name = "faults-";
+    for (int i = 15; i >= 0; --i) name += hex[hash >> (4 * i) & 15];
+    return name + ".fpc";
+}
+
+} // namespace fault_tp_cache
+
+// 寫出快取；faults 與 tps 必須是同一次產生的（tp.parent_fault_id 要找得到對應的 fault）
+inline void write_fault_tp_cache(const string& path, uint64_t content_hash, const FaultTpSet& set) {
+    using namespace fault_tp_cache;
+    vector<FaultRec> faults; vector<FpRec> fps; vector<OpRec> ops; vector<TpRec> tps; string chars;
+    unordered_map<string, uint32_t> fault_of_id;
+    auto put_side = [&](const SSpec& s) {
+        SideRec r{pack_val(s.pre_D), pack_val(s.Ci), pack_val(s.last_D), 0, (uint32_t)ops.size(), (uint32_t)s.ops.size()};
+        for (const Op& op : s.ops) ops.push_back(pack_op(op));
+        return r;
+    };
+    for (const Fault& f : set.faults) {
+        fault_of_id.emplace(f.fault_id, (uint32_t)faults.size());
+        FaultRec r{(uint32_t)chars.size(), (uint32_t)f.fault_id.size(), f.fault_idx,
+                   static_cast<uint8_t>(f.category), static_cast<uint8_t>(f.cell_scope), {0, 0},
+                   (uint32_t)fps.size(), (uint32_t)f.primitives.size()};
+        chars += f.fault_id;
+        for (const FPExpr& fp : f.primitives) {
+            FpRec p{};
+            p.has_sa = fp.Sa.has_value();
+            if (fp.Sa) p.sa = put_side(*fp.Sa);
+            p.sv = put_side(fp.Sv);
+            p.fd = pack_val(fp.F.FD); p.rd = pack_val(fp.R.RD); p.co = pack_val(fp.C.Co);
+            p.s_has_any_op = fp.s_has_any_op;
+            fps.push_back(p);
+        }
+        faults.push_back(r);
+    }
+    for (const TestPrimitive& tp : set.tps) {
+        auto it = fault_of_id.find(tp.parent_fault_id);
+        if (it == fault_of_id.end()) throw runtime_error("fault cache: TP of unknown fault " + tp.parent_fault_id);
+        TpRec r{};
+        r.fault = it->second;
+        r.fp_index = (uint32_t)tp.parent_fp_index;
+        r.group_idx = tp.group_idx;
+        r.state = pack_state(tp.state);
+        r.op_begin = (uint32_t)ops.size(); r.op_count = (uint32_t)tp.ops_before_detect.size();
+        for (const Op& op : tp.ops_before_detect) ops.push_back(pack_op(op));
+        r.detect_op = pack_op(tp.detector.detectOp);
+        r.group = static_cast<uint8_t>(tp.group);
+        r.pos = static_cast<uint8_t>(tp.detector.pos);
+        r.order = static_cast<uint8_t>(tp.detector.order);
+        r.flags = (tp.F_has_value ? TP_F : 0) | (tp.R_has_value ? TP_R : 0) | (tp.C_has_value ? TP_C : 0) |
+                  (tp.detector.has_set_Ci ? TP_SET_CI : 0);
+        tps.push_back(r);
+    }
+
+    Header h{};
+    std::memcpy(h.magic, MAGIC, sizeof(MAGIC));
+    h.version = FAULT_TP_CACHE_VERSION; h.byte_order = BYTE_ORDER_MARK; h.content_hash = content_hash;
+    h.n_faults = (uint32_t)faults.size(); h.n_fps = (uint32_t)fps.size(); h.n_ops = (uint32_t)ops.size();
+    h.n_tps = (uint32_t)tps.size(); h.n_chars = (uint32_t)chars.size();
+    string blob(sizeof(Header), '\0');
+    auto section = [&](const void* data, size_t bytes) {
+        blob.resize((blob.size() + 7) / 8 * 8, '\0');
+        const uint64_t off = blob.size();
+        blob.append(static_cast<const char*>(data), bytes);
+        return off;
+    };
+    h.off_faults = section(faults.data(), faults.size() * sizeof(FaultRec));
+    h.off_fps    = section(fps.data(), fps.size() * sizeof(FpRec));
+    h.off_ops    = section(ops.data(), ops.size() * sizeof(OpRec));
+    h.off_tps    = section(tps.data(), tps.size() * sizeof(TpRec));
+    h.off_chars  = section(chars.data(), chars.size());
+    std::memcpy(&blob[0], &h, sizeof(Header));
+
+    const string tmp = path + ".tmp." + std::to_string(::getpid());
+    {
+        std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+        if (!ofs) throw runtime_error("Cannot write file: " + tmp);
+        ofs.write(blob.data(), (std::streamsize)blob.size());
+        if (!ofs) throw runtime_error("Cannot write file: " + tmp);
+    }
+    std::filesystem::rename(tmp, path); // 同一檔案系統內為 atomic
+}
+
+// 唯讀映射一份快取；檔案不存在或格式不符時 valid() 為 false
+class MappedFaultTpCache {
+public:
+    explicit MappedFaultTpCache(const string& path);
+    ~MappedFaultTpCache();
+    MappedFaultTpCache(const MappedFaultTpCache&) = delete;
+    MappedFaultTpCache& operator=(const MappedFaultTpCache&) = delete;
+
+    bool valid() const { return header_ != nullptr; }
+    uint64_t content_hash() const { return header_ ? header_->content_hash : 0; }
+    size_t fault_count() const { return header_ ? header_->n_faults : 0; }
+    size_t tp_count() const { return header_ ? header_->n_tps : 0; }
+
+    // 還原成下游使用的 Fault / TestPrimitive；索引越界時丟 runtime_error
+    FaultTpSet materialize() const;
+
+private:
+    const uint8_t* base_{nullptr};
+    size_t size_{0};
+    const fault_tp_cache::Header* header_{nullptr};
+
+    template <class T> const T* section(uint64_t off, size_t n) const {
+        if (off % alignof(T) != 0 || off > size_ || n > (size_ - off) / sizeof(T)) return nullptr;
+        return reinterpret_cast<const T*>(base_ + off);
+    }
+};
+
+inline MappedFaultTpCache::MappedFaultTpCache(const string& path) {
+    using namespace fault_tp_cache;
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st{};
+    if (::fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(Header)) {
+        void* p = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (p != MAP_FAILED) { base_ = static_cast<const uint8_t*>(p); size_ = (size_t)st.st_size; }
+    }
+    ::close(fd); // 映射在 close 後仍有效
+    if (!base_) return;
+    const Header* h = reinterpret_cast<const Header*>(base_);
+    const bool ok = std::memcmp(h->magic, MAGIC, sizeof(MAGIC)) == 0 && h->version == FAULT_TP_CACHE_VERSION &&
+                    h->byte_order == BYTE_ORDER_MARK &&
+                    section<FaultRec>(h->off_faults, h->n_faults) && section<FpRec>(h->off_fps, h->n_fps) &&
+                    section<OpRec>(h->off_ops, h->n_ops) && section<TpRec>(h->off_tps, h->n_tps) &&
+                    section<char>(h->off_chars, h->n_chars);
+    if (ok) header_ = h;
+}
+
+inline MappedFaultTpCache::~MappedFaultTpCache() {
+    if (base_) ::munmap(const_cast<uint8_t*>(base_), size_);
+}
+
+inline FaultTpSet MappedFaultTpCache::materialize() const {
+    using namespace fault_tp_cache;
+    if (!header_) throw runtime_error("fault cache: not mapped");
+    const Header& h = *header_;
+    const FaultRec* faults = section<FaultRec>(h.off_faults, h.n_faults);
+    const FpRec* fps = section<FpRec>(h.off_fps, h.n_fps);
+    const OpRec* ops = section<OpRec>(h.off_ops, h.n_ops);
+    const TpRec* tps = section<TpRec>(h.off_tps, h.n_tps);
+    const char* chars = section<char>(h.off_chars, h.n_chars);
+    auto check = [](uint64_t begin, uint64_t count, uint64_t n) {
+        if (begin > n || count > n - begin) throw runtime_error("fault cache: index out of range");
+    };
+    auto get_ops = [&](uint32_t begin, uint32_t count) {
+        check(begin, count, h.n_ops);
+        vector<Op> out; out.reserve(count);
+        for (uint32_t i = 0; i < count; ++i) out.push_back(unpack_op(ops[begin + i]));
+        return out;
+    };
+    auto get_side = [&](const SideRec& r) {
+        SSpec s;
+        s.pre_D = unpack_opt_val(r.pre_d); s.Ci = unpack_opt_val(r.ci); s.last_D = unpack_opt_val(r.last_d);
+        s.ops = get_ops(r.op_begin, r.op_count);
+        return s;
+    };
+
+    FaultTpSet out;
+    out.faults.reserve(h.n_faults);
+    for (uint32_t i = 0; i < h.n_faults; ++i) {
+        const FaultRec& r = faults[i];
+        check(r.id_begin, r.id_len, h.n_chars);
+        check(r.fp_begin, r.fp_count, h.n_fps);
+        if (r.category > static_cast<uint8_t>(Category::MustCompute) || r.scope > static_cast<uint8_t>(CellScope::TwoCellCrossRow))
+            throw runtime_error("fault cache: bad fault record");
+        Fault f;
+        f.fault_id.assign(chars + r.id_begin, r.id_len);
+        f.fault_idx = r.fault_idx;
+        f.category = static_cast<Category>(r.category);
+        f.cell_scope = static_cast<CellScope>(r.scope);
+        f.primitives.reserve(r.fp_count);
+        for (uint32_t k = 0; k < r.fp_count; ++k) {
+            const FpRec& p = fps[r.fp_begin + k];
+            FPExpr fp;
+            if (p.has_sa) fp.Sa = get_side(p.sa);
+            fp.Sv = get_side(p.sv);
+            fp.F.FD = unpack_opt_val(p.fd); fp.R.RD = unpack_opt_val(p.rd); fp.C.Co = unpack_opt_val(p.co);
+            fp.s_has_any_op = p.s_has_any_op != 0;
+            f.primitives.push_back(std::move(fp));
+        }
+        out.faults.push_back(std::move(f));
+    }
+    out.tps.reserve(h.n_tps);
+    for (uint32_t i = 0; i < h.n_tps; ++i) {
+        const TpRec& r = tps[i];
+        if (r.fault >= h.n_faults || r.group > static_cast<uint8_t>(OrientationGroup::A_GT_V) ||
+            r.pos > static_cast<uint8_t>(PositionMark::NextElementHead) || r.order > static_cast<uint8_t>(Detector::AddrOrder::Decending))
+            throw runtime_error("fault cache: bad TP record");
+        const Fault& f = out.faults[r.fault];
+        TestPrimitive tp;
+        tp.parent_fault_id = f.fault_id;
+        tp.parent_fp_index = r.fp_index;
+        tp.parent_fault_idx = f.fault_idx;
+        tp.group_idx = r.group_idx;
+        tp.group = static_cast<OrientationGroup>(r.group);
+        tp.state = unpack_state(r.state);
+        tp.ops_before_detect = get_ops(r.op_begin, r.op_count);
+        tp.detector.detectOp = unpack_op(r.detect_op);
+        tp.detector.pos = static_cast<PositionMark>(r.pos);
+        tp.detector.order = static_cast<Detector::AddrOrder>(r.order);
+        tp.detector.has_set_Ci = r.flags & TP_SET_CI;
+        tp.F_has_value = r.flags & TP_F; tp.R_has_value = r.flags & TP_R; tp.C_has_value = r.flags & TP_C;
+        out.tps.push_back(std::move(tp));
+    }
+    return out;
+}
+
+// 直接 parse + 產生 TP（不經快取）
+// faults.json 以 SAX 串流讀入，每 batch 筆 fault 打包成一個工作：pool 非空時交給 worker 做
+// normalize + generate，呼叫端繼續往下讀；fault_idx 依檔案順序指派，結果依 batch 順序接回，
+// 所以 faults / tps 的順序與 group_idx 和序列版完全相同。例外依檔案順序轉拋第一個
+inline FaultTpSet build_fault_tp_set(const string& faults_json_path, ThreadPool* pool = nullptr, size_t batch = 64) {
+    struct Part { vector<Fault> faults; vector<TestPrimitive> tps; };
+    auto work = [](vector<RawFault> raws, FaultIdx base) {
+        Part part;
+        FaultNormalizer normalizer; TPGenerator gen;
+        part.faults.reserve(raws.size());
+        part.tps.reserve(raws.size() * 2);
+        for (size_t i = 0; i < raws.size(); ++i) {
+            part.faults.push_back(normalizer.normalize(raws[i], base + (FaultIdx)i));
+            auto v = gen.generate(part.faults.back());
+            part.tps.insert(part.tps.end(), std::make_move_iterator(v.begin()), std::make_move_iterator(v.end()));
+        }
+        return part;
+    };
+
+    batch = std::max<size_t>(1, batch);
+    vector<std::future<Part>> pending;
+    vector<Part> parts;
+    vector<RawFault> cur;
+    FaultIdx next_idx = 0;
+    auto flush = [&] {
+        if (cur.empty()) return;
+        FaultIdx base = next_idx;
+        next_idx += (FaultIdx)cur.size();
+        if (pool) pending.push_back(pool->submit([work, raws = std::move(cur), base]() mutable { return work(std::move(raws), base); }));
+        else parts.push_back(work(std::move(cur), base));
+        cur = vector<RawFault>();
+        cur.reserve(batch);
+    };
+    cur.reserve(batch);
+    std::exception_ptr err;
+    try {
+        FaultsJsonParser().parse_stream(faults_json_path, [&](RawFault&& rf) {
+            cur.push_back(std::move(rf));
+            if (cur.size() >= batch) flush();
+        });
+        flush();
+    } catch (...) { err = std::current_exception(); }
+    // 已送出的 batch 都等完（worker 裡的例外排在 parse 例外之前，因為它們對應檔案較前面的 fault）
+    std::exception_ptr work_err;
+    for (auto& f : pending) {
+        try { parts.push_back(pool->wait(f)); } catch (...) { if (!work_err) work_err = std::current_exception(); }
+    }
+    if (work_err) std::rethrow_exception(work_err);
+    if (err) std::rethrow_exception(err);
+
+    FaultTpSet out;
+    size_t nf = 0, nt = 0;
+    for (const Part& p : parts) { nf += p.faults.size(); nt += p.tps.size(); }
+    out.faults.reserve(nf); out.tps.reserve(nt);
+    for (Part& p : parts) {
+        out.faults.insert(out.faults.end(), std::make_move_iterator(p.faults.begin()), std::make_move_iterator(p.faults.end()));
+        out.tps.insert(out.tps.end(), std::make_move_iterator(p.tps.begin()), std::make_move_iterator(p.tps.end()));
+    }
+    return out;
+}
+
+// 預設快取目錄：環境變數 FAULT_TP_CACHE_DIR；未設定（或為空）則不使用快取。
+// 各工具都以 load_fault_tp_set(path) 載入 faults，所以設定這個變數就會全部改走快取
+inline string default_fault_tp_cache_dir() {
+    const char* dir = std::getenv("FAULT_TP_CACHE_DIR");
+    return dir ? string(dir) : string();
+}
+
+// 讀 faults.json 並產生 TPs；cache_dir 非空時先查快取，沒有（或損毀）就建好再寫回
+// pool 只用在快取沒命中、需要重新 parse 的時候
+inline FaultTpSet load_fault_tp_set(const string& faults_json_path, const string& cache_dir = default_fault_tp_cache_dir(),
+                                    ThreadPool* pool = nullptr) {
+    if (cache_dir.empty()) return build_fault_tp_set(faults_json_path, pool);
+    const uint64_t hash = fault_tp_cache::content_hash(fault_tp_cache::read_file(faults_json_path));
+    const string path = (std::filesystem::path(cache_dir) / fault_tp_cache::cache_file_name(hash)).string();
+    {
+        MappedFaultTpCache cache(path);
+        if (cache.valid() && cache.content_hash() == hash) {
+            try { return cache.materialize(); } catch (const runtime_error&) {} // 損毀：重建
+        }
+    }
+    FaultTpSet set = build_fault_tp_set(faults_json_path, pool);
+    try {
+        std::filesystem::create_directories(cache_dir);
+        write_fault_tp_cache(path, hash, set);
+    } catch (const std::exception&) {} // 快取寫不進去不影響這次執行
+    return set;
+}
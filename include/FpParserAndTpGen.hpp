@@ -17,6 +17,7 @@
 #include <cstddef>
 #include <cctype>
 #include <algorithm>
+#include <type_traits>
 
 #include "nlohmann/json.hpp"
 
@@ -91,8 +92,91 @@ struct RawFault { // JSON 解析結果的中介結構
 class FaultsJsonParser { // FaultsJsonParser：讀入 faults.json，回傳 RawFault 列表
 public:
     vector<RawFault> parse_file(const string& path);
+
+    // 串流版：以 SAX 逐 token 讀檔、不建 DOM，每讀完一個 fault 物件就呼叫 on_fault(RawFault&&)，
+    // 記憶體只留當下這一筆。欄位缺漏或型別不對時丟 runtime_error；on_fault 丟出的例外直接往外傳
+    template <class OnFault>
+    void parse_stream(const string& path, OnFault&& on_fault);
 };
 
+namespace fault_json_detail {
+// faults.json 的 SAX handler。depth：0 = 頂層、1 = 頂層陣列內、2 = fault 物件內、3+ = 欄位值的容器內
+template <class OnFault>
+class FaultSaxHandler : public nlohmann::json_sax<nlohmann::json> {
+public:
+    explicit FaultSaxHandler(OnFault& on_fault) : on_fault_(on_fault) {}
+
+    bool null() override { return scalar("null"); }
+    bool boolean(bool) override { return scalar("boolean"); }
+    bool number_integer(number_integer_t) override { return scalar("number"); }
+    bool number_unsigned(number_unsigned_t) override { return scalar("number"); }
+    bool number_float(number_float_t, const string_t&) override { return scalar("number"); }
+    bool binary(binary_t&) override { return scalar("binary"); }
+    bool string(string_t& val) override {
+        if (depth_ == 3 && in_fp_) { cur_.fp_raw.push_back(std::move(val)); return true; }
+        if (depth_ != 2) return scalar("string");
+        if (key_ == "fault_id")        { cur_.fault_id = std::move(val); seen_ |= 1; }
+        else if (key_ == "category")   { cur_.category = std::move(val); seen_ |= 2; }
+        else if (key_ == "cell_scope") { cur_.cell_scope = std::move(val); seen_ |= 4; }
+        else if (key_ == "fault_primitives") type_error();
+        return true;
+    }
+    bool start_object(std::size_t) override {
+        if (depth_ == 0) throw runtime_error("Top-level JSON is not an array");
+        if (depth_ == 1) { cur_ = RawFault{}; seen_ = 0; }
+        else if (depth_ == 2 && is_field()) type_error();
+        else if (depth_ == 3 && in_fp_) type_error();
+        ++depth_;
+        return true;
+    }
+    bool end_object() override {
+        if (--depth_ == 1) {
+            if (seen_ != 15) throw runtime_error("Fault entry missing fault_id / category / cell_scope / fault_primitives");
+            on_fault_(std::move(cur_));
+        }
+        return true;
+    }
+    bool start_array(std::size_t) override {
+        if (depth_ == 2 && key_ == "fault_primitives") { in_fp_ = true; seen_ |= 8; }
+        else if (depth_ == 2 && is_field()) type_error();
+        else if (depth_ == 3 && in_fp_) type_error();
+        else if (depth_ == 1) throw runtime_error("Fault entry is not an object");
+        ++depth_;
+        return true;
+    }
+    bool end_array() override {
+        if (--depth_ == 2) in_fp_ = false;
+        return true;
+    }
+    bool key(string_t& val) override {
+        if (depth_ == 2) key_ = std::move(val);
+        return true;
+    }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override {
+        throw runtime_error(std::string("Fault JSON parse error: ") + ex.what());
+    }
+
+private:
+    OnFault& on_fault_;
+    RawFault cur_;
+    std::string key_;
+    int depth_{0};
+    bool in_fp_{false};
+    unsigned seen_{0}; // 1 fault_id | 2 category | 4 cell_scope | 8 fault_primitives
+
+    bool is_field() const {
+        return key_ == "fault_id" || key_ == "category" || key_ == "cell_scope" || key_ == "fault_primitives";
+    }
+    [[noreturn]] void type_error() const { throw runtime_error("Fault field '" + key_ + "' has the wrong type"); }
+    bool scalar(const char* what) {
+        if (depth_ == 0) throw runtime_error("Top-level JSON is not an array");
+        if (depth_ == 1) throw runtime_error(std::string("Fault entry is not an object (got ") + what + ")");
+        if ((depth_ == 2 && is_field()) || (depth_ == 3 && in_fp_)) type_error();
+        return true; // 其他欄位的值直接略過
+    }
+};
+} // namespace fault_json_detail
+
 // 直接解析檔案；失敗時丟出 std::runtime_error
 inline vector<RawFault> FaultsJsonParser::parse_file(const string& path) {
     ifstream ifs(path);
@@ -119,6 +203,16 @@ inline vector<RawFault> FaultsJsonParser::parse_file(const string& path) {
     return out;
 }
 
+template <class OnFault>
+inline void FaultsJsonParser::parse_stream(const string& path, OnFault&& on_fault) {
+    ifstream ifs(path, std::ios::binary);
+    if (!ifs) {
+        throw runtime_error("Cannot open file: " + path);
+    }
+    fault_json_detail::FaultSaxHandler<std::remove_reference_t<OnFault>> handler(on_fault);
+    nlohmann::json::sax_parse(ifs, &handler);
+}
+
 // === FaultNormalizer ===
 /*
 FaultNormalizer — 簡易說明與使用範例
@@ -144,6 +238,7 @@ FaultNormalizer — 簡易說明與使用範例
     - Fault
         包含：
             - fault_id (複製自 RawFault)
+            - fault_idx (依 normalize 成功的順序 0,1,2,...；模擬器以此取代字串當索引)
             - category (enum Category)
             - cell_scope (enum CellScope)
             - primitives : vector<FPExpr>
@@ -251,8 +346,12 @@ struct FPExpr {
     bool s_has_any_op = false; // Sa/Sv 任一側只要有 Op 就為 true（你規則 #2 會用到）
 };
 
+// Fault 的整數索引：由 FaultNormalizer 依正規化順序指派（0,1,2,...），-1 表未指派
+using FaultIdx = int;
+
 struct Fault {
     string fault_id;
+    FaultIdx fault_idx{-1}; // 下游以此取代 fault_id 做索引；fault_id 只留給顯示
     Category category;
     CellScope cell_scope;
     vector<FPExpr> primitives; // 解析後的 primitives
@@ -262,6 +361,8 @@ class FaultNormalizer {
 public:
     // 主函式
     Fault normalize(const RawFault& rf);
+    // 指定 fault_idx、不動內部計數：平行正規化時由呼叫端依檔案順序給索引
+    Fault normalize(const RawFault& rf, FaultIdx fault_idx);
 
     // 主要解析函式
     Category  to_category(const string& s);
@@ -276,7 +377,13 @@ public:
     FSpec  parse_f (const string& s);     // e.g. "0D" 或空
     RSpec  parse_r (const string& s);     // e.g. "-" 或 "1D"
     CSpec  parse_c (const string& s);     // e.g. "1Co" / "0Co" 或空
+
+    // 下一個成功正規化的 Fault 取得的 fault_idx；換一份 fault 清單時呼叫 reset_index()
+    FaultIdx next_index() const { return next_fault_idx_; }
+    void reset_index() { next_fault_idx_ = 0; }
 private:
+    FaultIdx next_fault_idx_{0};
+
     // === 共同小工具（僅此類內可用） ===
     // 去除字串內部所有空白（保留 token 粒度）
     string strip_spaces(const string& s);
@@ -294,13 +401,21 @@ private:
 };
 
 inline Fault FaultNormalizer::normalize(const RawFault& rf) {
+    Fault f = normalize(rf, next_fault_idx_);
+    ++next_fault_idx_; // 解析失敗（丟例外）的 fault 不佔索引
+    return f;
+}
+
+inline Fault FaultNormalizer::normalize(const RawFault& rf, FaultIdx fault_idx) {
     Fault f;
     f.fault_id = rf.fault_id;
     f.category = to_category(rf.category);
     f.cell_scope = to_scope(rf.cell_scope);
+    f.primitives.reserve(rf.fp_raw.size());
     for (const auto& raw : rf.fp_raw) {
         f.primitives.push_back(parse_fp(raw, f.cell_scope));
     }
+    f.fault_idx = fault_idx;
     return f;
 }
 
@@ -545,6 +660,12 @@ inline string FaultNormalizer::trim(const string& s) {
 
 // 基本型別定義
 enum class OrientationGroup { Single, A_LT_V, A_GT_V };
+
+// (fault, orientation) 群組的整數索引：fault_idx * 3 + group，-1 表未指派
+using GroupIdx = int;
+inline GroupIdx make_group_idx(FaultIdx fault_idx, OrientationGroup og) {
+    return fault_idx < 0 ? -1 : fault_idx * 3 + static_cast<int>(og);
+}
 enum class PositionMark { Adjacent, SameElementHead, NextElementHead }; // #, ^, ;
 enum class WhoIsPivot { Victim, Aggressor };
 enum class DetectKind { Read, ComputeAnd };
@@ -621,6 +742,8 @@ struct TestPrimitive {
     // 溯源
     std::string parent_fault_id;
     std::size_t parent_fp_index{};
+    FaultIdx parent_fault_idx{-1}; // = Fault::fault_idx
+    GroupIdx group_idx{-1};        // = make_group_idx(parent_fault_idx, group)
 
     // 方向與 scope 群組
     OrientationGroup group{OrientationGroup::Single};
@@ -964,7 +1087,9 @@ inline TestPrimitive TPGenerator::assemble_tp(const Fault& fault, const size_t f
     TestPrimitive tp;
     tp.parent_fault_id = fault.fault_id;
     tp.parent_fp_index = fp_index;
+    tp.parent_fault_idx = fault.fault_idx;
     tp.group = plan.group;
+    tp.group_idx = make_group_idx(fault.fault_idx, plan.group);
     tp.state = state_assembler_.assemble(fault.primitives[fp_index], plan, detector);
     tp.ops_before_detect = state_assembler_.ops_before_detect(fault.primitives[fp_index], fault.category);
     tp.detector = detector;
@@ -1,7 +1,7 @@
 // MarchSynth.hpp
 // Simplified Greedy March Test Generator (no Beam, no Cache).
 // -------------------------------------------------------------
-// - 直接呼叫 FaultSimulator::simulate() 取得真實結果。
+// - 以 IncrementalSimulator 延伸前綴取得真實結果（與 FaultSimulator::simulate() 相同）。
 // - 無 SequenceHasher、無 SimCache。
 // - 關閉條件：若 Δstate/Δsens/Δdetect 全 0，或僅 detect>0 且 defer_detect_only=true。
 // - 寫法：Header-style（介面＋inline 實作），SRP原則，每個函式只負責一件事。
@@ -91,6 +91,10 @@ public:
     }
 
     void append_op_to_current_element(GenOp gop) {
+        mt_.elements.back().ops.push_back(to_op(gop));
+    }
+
+    static Op to_op(GenOp gop) {
         Op op;
         switch (gop) {
             case GenOp::W0:
@@ -125,7 +129,7 @@ public:
                 op.C_B = (offset & 0b001) ? Val::One : Val::Zero;
                 break;
         }
-        mt_.elements.back().ops.push_back(op);
+        return op;
     }
 
 private:
@@ -145,19 +149,21 @@ private:
 
 /**
  * @brief SimulatorAdaptor：包裝 FaultSimulator::simulate()
+ *        faults/tps 在建構時整理成 PreparedFaultSet，之後每次 run 不再重建 buckets
  */
 class SimulatorAdaptor {
 public:
     SimulatorAdaptor(const vector<Fault>& faults, const vector<TestPrimitive>& tps)
-        : faults_(faults), tps_(tps) {}
+        : prepared_(faults, tps) {}
 
     SimulationResult run(const MarchTest& mt) {
-        return fs_.simulate(mt, faults_, tps_);
+        return fs_.simulate(mt, prepared_);
     }
 
+    const PreparedFaultSet& prepared() const { return prepared_; }
+
 private:
-    const vector<Fault>& faults_;
-    const vector<TestPrimitive>& tps_;
+    PreparedFaultSet prepared_;
     FaultSimulator fs_;
 };
 
@@ -180,6 +186,11 @@ public:
     explicit DiffScorer(const SynthConfig& cfg) : cfg_(cfg) {}
 
     Delta compute(const SimulationResult& before, const SimulationResult& after) const {
+        return compute(CoverageSummary{before.state_coverage, before.sens_coverage, before.detect_coverage, before.total_coverage},
+                       CoverageSummary{after.state_coverage, after.sens_coverage, after.detect_coverage, after.total_coverage});
+    }
+
+    Delta compute(const CoverageSummary& before, const CoverageSummary& after) const {
         Delta d;
         d.dState    = after.state_coverage - before.state_coverage;
         d.dSens     = after.sens_coverage  - before.sens_coverage;
@@ -239,17 +250,20 @@ public:
                       const vector<Fault>& faults,
                       const vector<TestPrimitive>& tps)
         : cfg_(cfg),
-          simulator_(faults, tps),
+          session_(faults, tps),
           scorer_(cfg),
-          policy_(cfg) {}
+          policy_(cfg) {
+        session_.set_fault_dropping(true); // 只用覆蓋率：已偵測群組的 TP 不再模擬
+    }
 
     /**
      * @brief 執行貪婪式產生器
      */
     MarchTest run(const MarchTest& init_mt, double target_cov = 1.0) {
-        MarchTest get_cur_mt = ensure_has_element(init_mt);
-        SimulationResult cur_sim = simulator_.run(get_cur_mt);
-        AddrOrder cur_order = get_cur_mt.elements.back().order;
+        // 前綴保存在增量模擬器內：每個候選只重算最後一個 element
+        session_.assign(ensure_has_element(init_mt));
+        CoverageSummary cur_sim = session_.summary();
+        AddrOrder cur_order = session_.march_test().elements.back().order;
 
         for (int step = 0; step < cfg_.max_ops; ++step) {
             if (cur_sim.total_coverage >= target_cov) break;
@@ -259,13 +273,13 @@ public:
                                               GenOp::C_0_0_0, GenOp::C_0_0_1, GenOp::C_0_1_0, GenOp::C_0_1_1,
                                               GenOp::C_1_0_0, GenOp::C_1_0_1, GenOp::C_1_1_0, GenOp::C_1_1_1 };
             vector<Delta> deltas; deltas.reserve(candidates.size());
-            struct CandEval { GenOp gop; double gain; SimulationResult after; Delta d; };
+            struct CandEval { GenOp gop; double gain; CoverageSummary after; Delta d; };
             vector<CandEval> evals; evals.reserve(candidates.size());
 
-            // 模擬每個候選
+            // 模擬每個候選（append 後再退回前綴）
             for (auto gop : candidates) {
-                MarchTest mt_after = append_op(get_cur_mt, cur_order, gop);
-                SimulationResult after = simulator_.run(mt_after);
+                CoverageSummary after = session_.append_op(RawMarchEditor::to_op(gop)).after;
+                session_.pop_op();
                 Delta d = scorer_.compute(cur_sim, after);
                 double g = scorer_.gain(d);
                 deltas.push_back(d);
@@ -274,9 +288,10 @@ public:
 
             // 檢查關閉條件
             if (policy_.should_close(deltas)) {
-                get_cur_mt = close_element(get_cur_mt, cur_order);
-                cur_order = flip_order(cur_order);
-                cur_sim = simulator_.run(get_cur_mt);
+                MarchElement e;
+                e.order = flip_order(cur_order);
+                cur_sim = session_.append_element(e).after;
+                cur_order = e.order;
                 continue;
             }
 
@@ -285,16 +300,16 @@ public:
                                          [](const CandEval& a, const CandEval& b){ return a.gain < b.gain; });
             if (best == evals.end()) break;
 
-            get_cur_mt = append_op(get_cur_mt, cur_order, best->gop);
+            session_.append_op(RawMarchEditor::to_op(best->gop));
             cur_sim = best->after;
         }
 
-        return get_cur_mt;
+        return session_.march_test();
     }
 
 private:
     SynthConfig cfg_;
-    SimulatorAdaptor simulator_;
+    IncrementalSimulator session_;
     DiffScorer scorer_;
     ElementPolicy policy_;
 
@@ -310,23 +325,9 @@ private:
         return mt;
     }
 
-    static MarchTest append_op(const MarchTest& base, AddrOrder ord, GenOp gop) {
-        RawMarchEditor ed(base);
-        ed.set_current_order(ord);
-        ed.append_op_to_current_element(gop);
-        return ed.get_cur_mt();
-    }
-
     static AddrOrder flip_order(AddrOrder ord) {
         if (ord == AddrOrder::Up) return AddrOrder::Down;
         if (ord == AddrOrder::Down) return AddrOrder::Up;
         return AddrOrder::Up;
     }
-
-    static MarchTest close_element(MarchTest mt, AddrOrder cur_order) {
-        MarchElement e; 
-        e.order = flip_order(cur_order);
-        mt.elements.push_back(e);
-        return mt;
-    }
 };
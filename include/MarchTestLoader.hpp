@@ -0,0 +1,147 @@
+#pragma once
+// =============================================================
+//  MarchTestLoader.hpp — 大量 March pattern 的批次載入
+//  - load_march_tests(path, on_test, on_error)：唯讀 mmap 整個 JSON（[{"March_test", "Pattern"}, ...]），
+//    以 SAX 逐筆讀出，pattern 直接交給 MarchPatternParser，不建 DOM、不留 RawMarchTest
+//  - name / pattern 讀進重複使用的緩衝區，每讀完一個物件才 parse 一次，
+//    所以除了交出去的 MarchTest 本身以外，穩態下沒有逐筆的記憶體配置
+//  - pattern 不合法的項目交給 on_error(index, name, message) 後略過；JSON 結構錯誤丟 runtime_error
+// =============================================================
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+#include "FaultSimulator.hpp"
+
+namespace march_loader_detail {
+
+// 唯讀映射整個檔案；空檔案 data() 為 nullptr
+class MappedFile {
+public:
+    explicit MappedFile(const string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw runtime_error("Cannot open file: " + path);
+        struct stat st{};
+        if (::fstat(fd, &st) != 0) { ::close(fd); throw runtime_error("Cannot stat file: " + path); }
+        if (st.st_size > 0) {
+            void* p = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (p == MAP_FAILED) { ::close(fd); throw runtime_error("Cannot map file: " + path); }
+            data_ = static_cast<const char*>(p); size_ = (size_t)st.st_size;
+            ::madvise(p, size_, MADV_SEQUENTIAL);
+        }
+        ::close(fd); // 映射在 close 後仍有效
+    }
+    ~MappedFile() { if (data_) ::munmap(const_cast<char*>(data_), size_); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_{nullptr};
+    size_t size_{0};
+};
+
+// depth：0 = 頂層、1 = 頂層陣列內、2 = 物件內、3+ = 欄位值的容器內（略過）
+template <class OnTest, class OnError>
+class MarchSaxHandler : public nlohmann::json_sax<nlohmann::json> {
+public:
+    MarchSaxHandler(OnTest& on_test, OnError& on_error) : on_test_(on_test), on_error_(on_error) {}
+
+    bool null() override { return scalar(); }
+    bool boolean(bool) override { return scalar(); }
+    bool number_integer(number_integer_t) override { return scalar(); }
+    bool number_unsigned(number_unsigned_t) override { return scalar(); }
+    bool number_float(number_float_t, const string_t&) override { return scalar(); }
+    bool binary(binary_t&) override { return scalar(); }
+    bool string(string_t& val) override {
+        if (depth_ != 2) return scalar();
+        if (key_ == "March_test") { name_.assign(val); has_name_ = true; }
+        else if (key_ == "Pattern") { pattern_.assign(val); has_pattern_ = true; }
+        return true;
+    }
+    bool start_object(std::size_t) override {
+        if (depth_ == 0) throw runtime_error("March JSON root must be an array");
+        if (depth_ == 1) { has_name_ = has_pattern_ = false; key_.clear(); }
+        ++depth_;
+        return true;
+    }
+    bool end_object() override {
+        if (--depth_ == 1) emit();
+        return true;
+    }
+    bool start_array(std::size_t) override {
+        if (depth_ == 1) skip_entry("entry is not an object");
+        ++depth_;
+        return true;
+    }
+    bool end_array() override { --depth_; return true; }
+    bool key(string_t& val) override {
+        if (depth_ == 2) key_.assign(val);
+        return true;
+    }
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) override {
+        throw runtime_error(std::string("March JSON parse error: ") + ex.what());
+    }
+
+private:
+    OnTest& on_test_;
+    OnError& on_error_;
+    std::string key_, name_, pattern_; // 重複使用的緩衝區
+    MarchTest mt_;
+    size_t index_{0};
+    int depth_{0};
+    bool has_name_{false}, has_pattern_{false};
+
+    bool scalar() {
+        if (depth_ == 0) throw runtime_error("March JSON root must be an array");
+        if (depth_ == 1) skip_entry("entry is not an object");
+        return true;
+    }
+    void skip_entry(const char* why) {
+        on_error_(index_++, std::string(), std::string(why));
+    }
+    void emit() {
+        const size_t idx = index_++;
+        if (!has_name_) name_ = "(unnamed)";
+        if (!has_pattern_) { on_error_(idx, name_, std::string("missing \"Pattern\"")); return; }
+        std::string err;
+        if (!MarchPatternParser::try_parse(pattern_, mt_, &err)) { on_error_(idx, name_, err); return; }
+        mt_.name = name_;
+        on_test_(idx, std::move(mt_));
+        mt_ = MarchTest{};
+    }
+};
+
+} // namespace march_loader_detail
+
+// on_test(index, MarchTest&&)：index 是該項在 JSON 陣列中的位置（含被略過的項目）
+// on_error(index, name, message)：pattern 不合法、缺 "Pattern" 或不是物件的項目
+template <class OnTest, class OnError>
+inline void load_march_tests(const string& path, OnTest&& on_test, OnError&& on_error) {
+    march_loader_detail::MappedFile file(path);
+    if (file.size() == 0) throw runtime_error("March JSON is empty: " + path);
+    march_loader_detail::MarchSaxHandler<std::remove_reference_t<OnTest>, std::remove_reference_t<OnError>> handler(on_test, on_error);
+    nlohmann::json::sax_parse(file.data(), file.data() + file.size(), &handler);
+}
+
+// 全部載入；任何一項不合法就丟 runtime_error
+inline vector<MarchTest> load_march_tests(const string& path) {
+    vector<MarchTest> out;
+    load_march_tests(path,
+        [&](size_t, MarchTest&& mt) { out.push_back(std::move(mt)); },
+        [&](size_t i, const string& name, const string& msg) {
+            throw runtime_error("March JSON entry " + to_string(i) + (name.empty() ? string() : " (" + name + ")") + ": " + msg);
+        });
+    return out;
+}
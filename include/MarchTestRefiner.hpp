@@ -115,6 +115,7 @@ struct GroupNeedInfo {
     bool covered_detect{false};
     // 最後活路相關：能補救的 site 集合
     vector<int> candidate_site_indices; // 對應 MarchTestRefiner 內部 site 列表的索引
+    GroupId group{0};         // 群組緊密編號（assign_dense_groups），也是它在 needs 內的位置
 };
 
 // -------------------------------------------------------------
@@ -159,8 +160,7 @@ private:
     void apply_patch(MarchTest& mt, const InsertionSite& site, const PatchCandidate& patch) const;
     // 8. 更新 group 需求 (簡化：重新模擬後再計算)
     void update_group_needs(vector<GroupNeedInfo>& needs,
-                            const SimulationResult& sim,
-                            const vector<TestPrimitive>& tps) const;
+                            const SimulationResult& sim) const;
     // 9. 標記最後活路失敗的 group → second_round
     void collect_second_round(const vector<GroupNeedInfo>& needs,
                               vector<string>& second_round_out) const;
@@ -169,11 +169,10 @@ private:
     vector<PatchCandidate> generate_minimal_patches_from_uncovered(const vector<TestPrimitive>& tps,
                                                                    const vector<size_t>& tp_gids,
                                                                    int max_patch_len) const;
-    // 11. 建立 group→TP 列表對映
-    unordered_map<string, vector<size_t>> build_group_to_tp_map(const vector<TestPrimitive>& tps) const;
-    // 12. 從 SimulationResult 萃取已偵測到的 group key 集合
-    unordered_set<string> detected_groups_set(const SimulationResult& sim,
-                                              const vector<TestPrimitive>& tps) const;
+    // 11. 建立 group→TP 列表對映（以群組編號為索引）
+    vector<vector<size_t>> build_group_to_tp_map(const vector<TestPrimitive>& tps) const;
+    // 12. 從 SimulationResult 萃取已偵測到的群組（[group] → 是否已偵測）
+    vector<bool> detected_groups_set(const SimulationResult& sim) const;
     // 13. 為各 group 計算可補救的 site（有任一 patch 通過並使該 group 由未覆蓋→覆蓋）
     void compute_group_site_candidates(const MarchTest& mt,
                                        const vector<InsertionSite>& sites,
@@ -183,6 +182,10 @@ private:
                                        const RefineConfig& cfg,
                                        const SimulationResult& baseline_sim,
                                        vector<GroupNeedInfo>& group_needs) const;
+
+    // refine() 開始時建立：tp → 群組編號（整數索引，取代 fault_id + ":" + og 字串）
+    vector<GroupId> tp2group_;
+    size_t group_count_{0};
 };
 
 // -------------------------------------------------------------
@@ -205,35 +208,19 @@ inline vector<InsertionSite> MarchTestRefiner::build_sites(const MarchTest& mt,
 }
 
 inline vector<GroupNeedInfo> MarchTestRefiner::build_group_needs(const SimulationResult& base_sim, const vector<TestPrimitive>& tps) const {
-    // 建立 TP → group key 映射
-    unordered_map<string, GroupNeedInfo> map; // key = fault_id + ":" + orientation enum int
+    // 每個群組一筆，依群組編號（TP 首次出現順序）排列
+    vector<GroupNeedInfo> out(group_count_);
+    vector<bool> seen(group_count_, false);
     for (size_t gid = 0; gid < tps.size(); ++gid) {
-        const auto& tp = tps[gid];
-        string key = tp.parent_fault_id + ":" + std::to_string(int(tp.group));
-        auto it = map.find(key);
-        if (it == map.end()) {
-            map.emplace(key, GroupNeedInfo{tp.parent_fault_id, tp.group, false,false,false,{}});
-        }
+        GroupId g = tp2group_[gid];
+        if (seen[g]) continue;
+        seen[g] = true;
+        out[g].fault_id = tps[gid].parent_fault_id;
+        out[g].og = tps[gid].group;
+        out[g].group = g;
     }
     // 根據 base_sim 填充 covered 狀態
-    for (const auto& kv : base_sim.fault_detail_map) {
-        const auto& fd = kv.second;
-        // fd.state_tp_gids 等已分組 (但此處需迭代 tp，以判斷 orientation group)
-        auto mark = [&](const vector<TpGid>& tp_list, auto setter){
-            for (auto tp_gid : tp_list) {
-                const auto& tp = tps[tp_gid];
-                string key = tp.parent_fault_id + ":" + std::to_string(int(tp.group));
-                auto it = map.find(key);
-                if (it != map.end()) setter(it->second);
-            }
-        };
-        mark(fd.state_tp_gids, [](GroupNeedInfo& g){ g.covered_state = true; });
-        mark(fd.sens_tp_gids,  [](GroupNeedInfo& g){ g.covered_sens  = true; });
-        mark(fd.detect_tp_gids,[](GroupNeedInfo& g){ g.covered_detect= true; });
-    }
-    // 收集
-    vector<GroupNeedInfo> out; out.reserve(map.size());
-    for (auto& kv : map) out.push_back(kv.second);
+    update_group_needs(out, base_sim);
     return out;
 }
 
@@ -325,25 +312,16 @@ inline vector<PatchCandidate> MarchTestRefiner::generate_minimal_patches_from_un
     return out;
 }
 
-inline unordered_map<string, vector<size_t>> MarchTestRefiner::build_group_to_tp_map(const vector<TestPrimitive>& tps) const {
-    unordered_map<string, vector<size_t>> g2tp;
-    for (size_t i = 0; i < tps.size(); ++i) {
-        const auto& tp = tps[i];
-        string key = tp.parent_fault_id + ":" + std::to_string(int(tp.group));
-        g2tp[key].push_back(i);
-    }
+inline vector<vector<size_t>> MarchTestRefiner::build_group_to_tp_map(const vector<TestPrimitive>& tps) const {
+    vector<vector<size_t>> g2tp(group_count_);
+    for (size_t i = 0; i < tps.size(); ++i) g2tp[tp2group_[i]].push_back(i);
     return g2tp;
 }
 
-inline unordered_set<string> MarchTestRefiner::detected_groups_set(const SimulationResult& sim,
-                                                                   const vector<TestPrimitive>& tps) const {
-    unordered_set<string> out;
+inline vector<bool> MarchTestRefiner::detected_groups_set(const SimulationResult& sim) const {
+    vector<bool> out(group_count_, false);
     for (const auto& kv : sim.fault_detail_map) {
-        const auto& fd = kv.second;
-        for (auto gid : fd.detect_tp_gids) {
-            const auto& tp = tps[gid];
-            out.insert(tp.parent_fault_id + ":" + std::to_string(int(tp.group)));
-        }
+        for (auto gid : kv.second.detect_tp_gids) out[tp2group_[gid]] = true;
     }
     return out;
 }
@@ -358,16 +336,14 @@ inline void MarchTestRefiner::compute_group_site_candidates(const MarchTest& mt,
                                                             vector<GroupNeedInfo>& group_needs) const {
     if (sites.empty()) return;
     auto g2tp = build_group_to_tp_map(tps);
-    auto detected_base = detected_groups_set(baseline_sim, tps);
+    auto detected_base = detected_groups_set(baseline_sim);
 
     for (auto& g : group_needs) {
         g.candidate_site_indices.clear();
         if (g.covered_detect) continue;
-        string key = g.fault_id + ":" + std::to_string(int(g.og));
-        auto it = g2tp.find(key);
-        if (it == g2tp.end()) continue;
+        if (g2tp[g.group].empty()) continue;
         // 為此 group 準備候選 patch（來自未覆蓋 TP）
-        auto minimal_patches = generate_minimal_patches_from_uncovered(tps, it->second, cfg.max_patch_len);
+        auto minimal_patches = generate_minimal_patches_from_uncovered(tps, g2tp[g.group], cfg.max_patch_len);
         // 對每個 site 測試少量 patch（限前幾個以節流）
         int test_cap = std::min<int>((int)minimal_patches.size(), 8);
         for (int si = 0; si < (int)sites.size(); ++si) {
@@ -389,8 +365,7 @@ inline void MarchTestRefiner::compute_group_site_candidates(const MarchTest& mt,
                 if (sim.state_coverage + 1e-12 < baseline_sim.state_coverage) {
                     continue; // state coverage 降低則淘汰
                 }
-                auto detected_after = detected_groups_set(sim, tps);
-                bool improved = (detected_after.find(key) != detected_after.end()) && (detected_base.find(key) == detected_base.end());
+                bool improved = detected_groups_set(sim)[g.group] && !detected_base[g.group];
                 if (improved) { site_ok = true; break; }
             }
             if (site_ok) g.candidate_site_indices.push_back(si);
@@ -418,7 +393,7 @@ inline void MarchTestRefiner::evaluate_patches(vector<PatchCandidate>& patches,
                                                const SimulationResult& baseline_sim,
                                                const vector<GroupNeedInfo>& group_needs,
                                                int site_index) const {
-    auto detected_base = detected_groups_set(baseline_sim, tps);
+    auto detected_base = detected_groups_set(baseline_sim);
     for (auto& p : patches) {
         if (p.ops.empty()) continue;
         MarchTest tmp = mt;
@@ -442,13 +417,12 @@ inline void MarchTestRefiner::evaluate_patches(vector<PatchCandidate>& patches,
         if (!p.coverage_progress) { p.reject_reason = "no-improve"; }
 
         // 是否滿足最後活路需求：若本 site 在某 group 是唯一候選，且此 patch 使之從未覆蓋→覆蓋
-        auto detected_after = detected_groups_set(sim, tps);
+        auto detected_after = detected_groups_set(sim);
         bool fulfill = false;
         for (const auto& g : group_needs) {
             if (g.covered_detect) continue;
             if (g.candidate_site_indices.size() == 1 && g.candidate_site_indices[0] == site_index) {
-                string key = g.fault_id + ":" + std::to_string(int(g.og));
-                if (detected_base.find(key) == detected_base.end() && detected_after.find(key) != detected_after.end()) {
+                if (!detected_base[g.group] && detected_after[g.group]) {
                     fulfill = true; break;
                 }
             }
@@ -470,19 +444,13 @@ inline void MarchTestRefiner::apply_patch(MarchTest& mt, const InsertionSite& si
 }
 
 inline void MarchTestRefiner::update_group_needs(vector<GroupNeedInfo>& needs,
-                                                 const SimulationResult& sim,
-                                                 const vector<TestPrimitive>& tps) const {
+                                                 const SimulationResult& sim) const {
     // 重設並重新計算
     for (auto& n : needs) { n.covered_state = n.covered_sens = n.covered_detect = false; }
     for (const auto& kv : sim.fault_detail_map) {
         const auto& fd = kv.second;
         auto mark = [&](const vector<TpGid>& tp_list, auto setter){
-            for (auto tp_gid : tp_list) {
-                const auto& tp = tps[tp_gid];
-                for (auto& g : needs) {
-                    if (g.fault_id == tp.parent_fault_id && g.og == tp.group) setter(g);
-                }
-            }
+            for (auto tp_gid : tp_list) setter(needs[tp2group_[tp_gid]]);
         };
         mark(fd.state_tp_gids, [](GroupNeedInfo& g){ g.covered_state = true; });
         mark(fd.sens_tp_gids,  [](GroupNeedInfo& g){ g.covered_sens  = true; });
@@ -507,6 +475,7 @@ inline MarchRefineResult MarchTestRefiner::refine(const MarchTest& original,
                                                   const RefineConfig& cfg,
                                                   RefineLog* log) {
     MarchRefineResult result; result.refined = original;
+    group_count_ = assign_dense_groups(tps, tp2group_);
     // 初始模擬
     SimulationResult base = simulator.simulate(result.refined, faults, tps);
     double baseline_state = base.state_coverage;
@@ -519,6 +488,7 @@ inline MarchRefineResult MarchTestRefiner::refine(const MarchTest& original,
     compute_group_site_candidates(result.refined, sites, faults, tps, simulator, cfg, base, group_needs);
 
     PatchScoreWeights weights; // 預設權重
+    auto g2tp = build_group_to_tp_map(tps); // 只依 tps，整個 refine 不變
     int no_progress_rounds = 0;
     for (int iter = 1; iter <= cfg.max_iterations; ++iter) {
         int site_index = select_site(sites, group_needs, base);
@@ -528,14 +498,11 @@ inline MarchRefineResult MarchTestRefiner::refine(const MarchTest& original,
         // 生成一般候選 patch
         auto patches = generate_patches(result.refined, site, group_needs, cfg);
         // 補上針對本 site 的 group 未覆蓋最短敏化 patch
-        auto g2tp = build_group_to_tp_map(tps);
         for (const auto& g : group_needs) {
             if (g.covered_detect) continue;
             if (std::find(g.candidate_site_indices.begin(), g.candidate_site_indices.end(), site_index) == g.candidate_site_indices.end()) continue;
-            string key = g.fault_id + ":" + std::to_string(int(g.og));
-            auto it = g2tp.find(key);
-            if (it == g2tp.end()) continue;
-            auto mins = generate_minimal_patches_from_uncovered(tps, it->second, cfg.max_patch_len);
+            if (g2tp[g.group].empty()) continue;
+            auto mins = generate_minimal_patches_from_uncovered(tps, g2tp[g.group], cfg.max_patch_len);
             patches.insert(patches.end(), mins.begin(), mins.end());
         }
 
@@ -571,7 +538,7 @@ inline MarchRefineResult MarchTestRefiner::refine(const MarchTest& original,
             applied = true;
             // 重新模擬更新 baseline
             base = simulator.simulate(result.refined, faults, tps);
-            update_group_needs(group_needs, base, tps);
+            update_group_needs(group_needs, base);
             baseline_state = base.state_coverage; baseline_detect = base.detect_coverage; baseline_sens = base.sens_coverage;
             // 由於內容已變，重建 sites 與 group→site 候選
             sites = build_sites(result.refined, cfg);
@@ -22,7 +22,11 @@
 #include <sstream>
 #include <cstddef>
 #include <queue>
+#include <atomic>
+#include <unordered_map>
+#include <cstdint>
 
+#include "ThreadPool.hpp"
 #include "FaultSimulator.hpp" // uses your existing simulator types & simulate(). :contentReference[oaicite:1]{index=1}
 
 namespace css {
@@ -35,6 +39,7 @@ using std::vector;
 using std::array;
 using std::string;
 using std::size_t;
+using std::unordered_map;
 
 // Template-level op kind (slot-level)
 enum class TemplateOpKind { None, Read, Write, Compute };
@@ -115,6 +120,103 @@ private:
     }
 };
 
+// v12: 把 [0, total) 切成 shards 段中的第 shard 段（前 total % shards 段多一個）；
+// 下面各個空間（template / sequence / variant）都以 rank 區間走訪，切段後可直接交給不同 worker
+inline std::pair<size_t, size_t> shard_range(size_t total, size_t shard, size_t shards) {
+    if (shards == 0 || shard >= shards) return {total, total};
+    const size_t q = total / shards, r = total % shards;
+    const size_t begin = shard * q + std::min(shard, r);
+    return {begin, begin + q + (shard < r ? 1 : 0)};
+}
+
+// v12: 飽和乘法（組合數可能超過 size_t）
+inline size_t saturating_mul(size_t a, size_t b) {
+    if (a != 0 && b > std::numeric_limits<size_t>::max() / a) return std::numeric_limits<size_t>::max();
+    return a * b;
+}
+
+// v12: 一個 slot kind 的值組合（encode_op 碼）：R/W 為 0、1；Compute 的 (T,M,B) 依 T 變化最快
+inline vector<OpCode> slot_value_codes(TemplateOpKind kind) {
+    Op o;
+    switch (kind) {
+        case TemplateOpKind::None: return {};
+        case TemplateOpKind::Read:  o.kind = OpKind::Read;  break;
+        case TemplateOpKind::Write: o.kind = OpKind::Write; break;
+        case TemplateOpKind::Compute: {
+            vector<OpCode> v;
+            o.kind = OpKind::ComputeAnd;
+            for (int m = 0; m < 8; ++m) {
+                o.C_T = (m & 1) ? Val::One : Val::Zero; o.C_M = (m & 2) ? Val::One : Val::Zero; o.C_B = (m & 4) ? Val::One : Val::Zero;
+                v.push_back(encode_op(o));
+            }
+            return v;
+        }
+    }
+    o.value = Val::Zero; const OpCode c0 = encode_op(o);
+    o.value = Val::One;  const OpCode c1 = encode_op(o);
+    return {c0, c1};
+}
+
+// v12: 由 order + encode_op 碼組出 element（沿用 out.ops 的容量）
+inline void decode_element(AddrOrder order, const OpCode* codes, size_t n, MarchElement& out) {
+    out.order = order;
+    out.ops.resize(n);
+    for (size_t i = 0; i < n; ++i) out.ops[i] = decode_op(codes[i]);
+}
+
+// v12: make_bruce 的 template 空間（不展開）：合法 template = 非 None 的 slot 連續在前、R / W 各至多一個。
+// 編號順序同 make_bruce（Up 全部在 Down 之前；同 order 內依 slot 0 為最低位的 4 進位索引遞增），
+// 第 rank 個可直接解出，所以可切成不相交的 rank 區間；不再掃過 4^slot_count 種組合
+class BruceTemplateSpace {
+public:
+    explicit BruceTemplateSpace(size_t slot_count) : slots_(slot_count) {
+        if (slot_count == 0) return; // 同 make_bruce：0 個 slot 沒有 template
+        per_len_.resize(slot_count + 1);
+        for (size_t n = 0; n <= slot_count; ++n) {
+            per_len_[n] = completions(n, true, true);
+            per_order_ += per_len_[n];
+        }
+    }
+
+    size_t slot_count() const { return slots_; }
+    size_t size() const { return 2 * per_order_; }
+
+    ElementTemplate at(size_t rank) const {
+        if (rank >= size()) throw std::out_of_range("BruceTemplateSpace::at");
+        const AddrOrder order = rank < per_order_ ? AddrOrder::Up : AddrOrder::Down;
+        size_t q = rank % per_order_, n = 0;
+        while (q >= per_len_[n]) q -= per_len_[n++];
+        // 前 n 個 slot 非 None；由最高位（slot n-1）往下決定，R < W < C
+        std::vector<TemplateOpKind> kinds(slots_, TemplateOpKind::None);
+        bool r_ok = true, w_ok = true;
+        for (size_t p = n; p-- > 0;) {
+            for (TemplateOpKind k : {TemplateOpKind::Read, TemplateOpKind::Write, TemplateOpKind::Compute}) {
+                if ((k == TemplateOpKind::Read && !r_ok) || (k == TemplateOpKind::Write && !w_ok)) continue;
+                const size_t c = completions(p, r_ok && k != TemplateOpKind::Read, w_ok && k != TemplateOpKind::Write);
+                if (q < c) { kinds[p] = k; r_ok = r_ok && k != TemplateOpKind::Read; w_ok = w_ok && k != TemplateOpKind::Write; break; }
+                q -= c;
+            }
+        }
+        return ElementTemplate(order, kinds);
+    }
+
+    // fn(rank, const ElementTemplate&)，rank ∈ [begin, end) ∩ [0, size())
+    template <class Fn>
+    void for_each(size_t begin, size_t end, Fn&& fn) const {
+        for (size_t r = begin; r < std::min(end, size()); ++r) fn(r, at(r));
+    }
+
+private:
+    size_t slots_{0};
+    size_t per_order_{0};
+    vector<size_t> per_len_; // 非 None slot 數為 n 的合法 template 數
+
+    // 剩 m 個非 None slot、R / W 是否仍可用時的填法數
+    static size_t completions(size_t m, bool r_ok, bool w_ok) {
+        return 1 + (r_ok ? m : 0) + (w_ok ? m : 0) + (r_ok && w_ok ? m * (m - 1) : 0);
+    }
+};
+
 // TemplateLibrary: small hand-picked PoC library; extendable
 class TemplateLibrary {
 public:
@@ -123,36 +225,12 @@ public:
     TemplateLibrary() = default;
 
     // v3: static factory that enumerates all valid templates with dynamic slot count
+    // v12: 直接走訪 BruceTemplateSpace（順序不變），只產生合法的 template
     static TemplateLibrary make_bruce(std::size_t slot_count = 3) {
         TemplateLibrary lib;
-        if (slot_count == 0) return lib;
-
-        // Build all combinations via iterative counting over 4^slot_count
-        const TemplateOpKind kinds[4] = {
-            TemplateOpKind::None,
-            TemplateOpKind::Read,
-            TemplateOpKind::Write,
-            TemplateOpKind::Compute
-        };
-
-        // iterate for Up and Down
-        for (AddrOrder ord : {AddrOrder::Up, AddrOrder::Down}) {
-            // total combinations = 4^slot_count (use integer math to avoid fp rounding)
-            std::size_t combos = 1;
-            for (std::size_t i = 0; i < slot_count; ++i) combos *= 4u;
-            for (std::size_t idx = 0; idx < combos; ++idx) {
-                std::vector<TemplateOpKind> seq;
-                seq.resize(slot_count, TemplateOpKind::None);
-                std::size_t t = idx;
-                for (std::size_t p = 0; p < slot_count; ++p) {
-                    std::size_t digit = t % 4;
-                    t /= 4;
-                    seq[p] = kinds[digit];
-                }
-                ElementTemplate et(ord, seq);
-                if (et.is_valid()) lib.templates_.push_back(et);
-            }
-        }
+        const BruceTemplateSpace space(slot_count);
+        lib.templates_.reserve(space.size());
+        space.for_each(0, space.size(), [&](size_t, ElementTemplate&& et) { lib.templates_.push_back(std::move(et)); });
         return lib;
     }
 
@@ -165,6 +243,8 @@ private:
 };
 
 // TemplateEnumerator: generate all sequences of length L (with optional rule-set pruning later)
+// v12: 長度 L 的 sequence 依 DFS 順序（第一個位置在最外層）編號為 rank；count / at / for_each 不展開整個空間，
+// rank 區間可用 shard_range 切給不同 worker。count 超過 size_t 時飽和，只走得到前 size_t max 個
 class TemplateEnumerator {
 public:
     using TemplateId = TemplateLibrary::TemplateId;
@@ -172,26 +252,46 @@ public:
 
     TemplateEnumerator(const TemplateLibrary& lib) : lib_(lib) {}
 
+    size_t count(size_t num_elements) const {
+        if (num_elements == 0 || lib_.size() == 0) return 0;
+        size_t c = 1;
+        for (size_t i = 0; i < num_elements; ++i) c = saturating_mul(c, lib_.size());
+        return c;
+    }
+
+    void at(size_t num_elements, size_t rank, Sequence& out) const {
+        out.ids.resize(num_elements);
+        for (size_t p = num_elements; p-- > 0;) { out.ids[p] = rank % lib_.size(); rank /= lib_.size(); }
+    }
+
+    // fn(rank, const Sequence&)，rank ∈ [begin, end) ∩ [0, count)；同一個 Sequence 原地遞增
+    template <class Fn>
+    void for_each(size_t num_elements, size_t begin, size_t end, Fn&& fn) const {
+        end = std::min(end, count(num_elements));
+        if (begin >= end) return;
+        Sequence cur;
+        at(num_elements, begin, cur);
+        for (size_t r = begin; ; ) {
+            fn(r, static_cast<const Sequence&>(cur));
+            if (++r == end) break;
+            for (size_t p = num_elements; p-- > 0;) { // 最後一個位置變化最快
+                if (++cur.ids[p] < lib_.size()) break;
+                cur.ids[p] = 0;
+            }
+        }
+    }
+
     // Enumerate all sequences length num_elements (max_candidates=0 -> unlimited)
+    // 會展開成 vector；大的空間請用 for_each 分段走訪
     vector<Sequence> enumerate(size_t num_elements, size_t max_candidates = 0) const {
         vector<Sequence> out;
-        if (num_elements==0 || lib_.size()==0) return out;
-        Sequence cur; cur.ids.resize(num_elements);
-        enumerate_rec(0, num_elements, max_candidates, cur, out);
+        const size_t n = max_candidates > 0 ? std::min(max_candidates, count(num_elements)) : count(num_elements);
+        for_each(num_elements, 0, n, [&](size_t, const Sequence& s) { out.push_back(s); });
         return out;
     }
 
 private:
     const TemplateLibrary& lib_;
-    void enumerate_rec(size_t pos, size_t num_elements, size_t max_candidates, Sequence& cur, vector<Sequence>& out) const {
-        if (max_candidates>0 && out.size()>=max_candidates) return;
-        if (pos==num_elements) { out.push_back(cur); return; }
-        for (size_t tid=0; tid<lib_.size(); ++tid) {
-            cur.ids[pos]=tid;
-            enumerate_rec(pos+1, num_elements, max_candidates, cur, out);
-            if (max_candidates>0 && out.size()>=max_candidates) return;
-        }
-    }
 };
 
 // -----------------------------
@@ -202,94 +302,227 @@ private:
 // You can later implement ValueExpandingGenerator to expand R/W/C values, or WindowedGenerator.
 class ICandidateGenerator {
 public:
+    using VariantFn = std::function<void(size_t /*k*/, const MarchElement&)>;
+
     virtual ~ICandidateGenerator() = default;
     // Given library and a template id, produce candidate MarchElements (could be multiple if expanding values)
     virtual vector<MarchElement> generate(const TemplateLibrary& lib, TemplateLibrary::TemplateId tid) const = 0; // v2: make generator const
+
+    // v12: 不展開的介面：variant 數（可能飽和到 size_t max）與依 generate 順序逐一走訪第 [begin, end) 個。
+    // 預設退回 generate()；空間可能很大的 generator 應覆寫兩者
+    virtual size_t variant_count(const TemplateLibrary& lib, TemplateLibrary::TemplateId tid) const {
+        return generate(lib, tid).size();
+    }
+    virtual void for_each_variant(const TemplateLibrary& lib, TemplateLibrary::TemplateId tid,
+                                  size_t begin, size_t end, const VariantFn& fn) const {
+        const auto elems = generate(lib, tid);
+        for (size_t k = begin; k < std::min(end, elems.size()); ++k) fn(k, elems[k]);
+    }
 };
 
+// 依 slot 展開 R/W 值與 Compute 的 (T,M,B)：第一個非 None slot 變化最快（等同以 slot 0 為最低位的 bit mask 遞增）
+// v12: 以 mixed-radix 游標走訪，不再受 64-bit mask 限制；generate() 只在組合數放得進 size_t 時展開，否則丟例外
 class ValueExpandingGenerator : public ICandidateGenerator {
 public:
     vector<MarchElement> generate(const TemplateLibrary& lib,
                                   TemplateLibrary::TemplateId tid) const override { // v2: const override
+        const size_t n = variant_count(lib, tid);
+        if (n == std::numeric_limits<size_t>::max())
+            throw runtime_error("ValueExpandingGenerator: template " + std::to_string(tid) +
+                                " has too many value combinations to materialize; use for_each_variant");
         vector<MarchElement> out;
+        out.reserve(n);
+        for_each_variant(lib, tid, 0, n, [&](size_t, const MarchElement& e) { out.push_back(e); });
+        return out;
+    }
+
+    size_t variant_count(const TemplateLibrary& lib, TemplateLibrary::TemplateId tid) const override {
+        size_t n = 1; // 無任何操作：仍有一個空元素（只有 order）
+        for (const auto& s : lib.at(tid).get_slots()) n = saturating_mul(n, radix(s.kind));
+        return n;
+    }
+
+    void for_each_variant(const TemplateLibrary& lib, TemplateLibrary::TemplateId tid,
+                          size_t begin, size_t end, const VariantFn& fn) const override {
         const auto& et = lib.at(tid);
+        vector<vector<OpCode>> opts; // 非 None slot 的選項
+        for (const auto& s : et.get_slots()) if (s.kind != TemplateOpKind::None) opts.push_back(slot_value_codes(s.kind));
+        end = std::min(end, variant_count(lib, tid));
+        if (begin >= end) return;
+        // rank → 各 slot 的選項（第一個 slot 為最低位）
+        vector<size_t> digit(opts.size(), 0);
+        for (size_t d = 0, r = begin; d < opts.size(); ++d) { digit[d] = r % opts[d].size(); r /= opts[d].size(); }
+        MarchElement e; e.order = et.get_order();
+        e.ops.resize(opts.size());
+        for (size_t d = 0; d < opts.size(); ++d) e.ops[d] = decode_op(opts[d][digit[d]]);
+        for (size_t k = begin; ; ) {
+            fn(k, e);
+            if (++k == end) break;
+            for (size_t d = 0; d < opts.size(); ++d) { // 下一個組合
+                const bool carry = ++digit[d] == opts[d].size();
+                if (carry) digit[d] = 0;
+                e.ops[d] = decode_op(opts[d][digit[d]]);
+                if (!carry) break;
+            }
+        }
+    }
+
+private:
+    static size_t radix(TemplateOpKind k) {
+        return k == TemplateOpKind::None ? 1 : k == TemplateOpKind::Compute ? 8 : 2;
+    }
+};
 
-        const auto& slots = et.get_slots();
-        const auto order = et.get_order();
-
-        // 計算所需的 bit 數（R/W 1 bit；Compute 3 bits）
-        struct SlotBits { TemplateOpKind kind; std::size_t base; };
-        std::vector<SlotBits> specs;
-        specs.reserve(slots.size());
-        std::size_t cursor = 0;
-        for (std::size_t i = 0; i < slots.size(); ++i) {
-            SlotBits sb{slots[i].kind, cursor};
-            switch (slots[i].kind) {
-                case TemplateOpKind::None:    cursor += 0; break;
-                case TemplateOpKind::Read:    cursor += 1; break;
-                case TemplateOpKind::Write:   cursor += 1; break;
-                case TemplateOpKind::Compute: cursor += 3; break;
+// v12: run_stream 順序的 slot 值空間（不展開）：各 slot 的值依 DFS 組合，最後一個 slot 變化最快。
+// template tid 的第 k 個組合可直接解出（decode），或以 for_each_codes 從任一 rank 起依序走訪
+class SlotValueSpace {
+public:
+    explicit SlotValueSpace(const TemplateLibrary& lib) : order_(lib.size()), opts_(lib.size()), leaves_(lib.size(), 1) {
+        for (size_t tid = 0; tid < lib.size(); ++tid) {
+            const ElementTemplate& et = lib.at(tid);
+            order_[tid] = et.get_order();
+            for (const auto& s : et.get_slots()) {
+                if (s.kind == TemplateOpKind::None) continue;
+                opts_[tid].push_back(slot_value_codes(s.kind));
+                leaves_[tid] = saturating_mul(leaves_[tid], opts_[tid].back().size()); // 飽和乘法，避免 slot 很多時溢位
             }
-            specs.push_back(sb);
-        }
-
-        const std::size_t total_bits = cursor;
-        if (total_bits == 0) {
-            // 無任何操作：仍回傳一個空元素（只有 order）
-            MarchElement e; e.order = order; // ops 保持空
-            out.push_back(e);
-            return out;
-        }
-
-        if (total_bits >= (sizeof(std::size_t) * 8)) {
-            // 避免移位溢位；在極端情況下直接返回空（或可改為截斷）
-            return out;
-        }
-
-        const std::size_t total_masks = (static_cast<std::size_t>(1) << total_bits);
-        out.reserve(total_masks);
-
-        for (std::size_t mask = 0; mask < total_masks; ++mask) {
-            MarchElement e; e.order = order;
-            // 依 slot 順序建立 ops
-            for (std::size_t i = 0; i < specs.size(); ++i) {
-                const auto kind = specs[i].kind;
-                const std::size_t base = specs[i].base;
-                switch (kind) {
-                    case TemplateOpKind::None:
-                        break;
-                    case TemplateOpKind::Read: {
-                        Op o; o.kind = OpKind::Read;
-                        const std::size_t bit = (mask >> base) & 1u;
-                        o.value = bit ? Val::One : Val::Zero;
-                        e.ops.push_back(o);
-                        break;
-                    }
-                    case TemplateOpKind::Write: {
-                        Op o; o.kind = OpKind::Write;
-                        const std::size_t bit = (mask >> base) & 1u;
-                        o.value = bit ? Val::One : Val::Zero;
-                        e.ops.push_back(o);
-                        break;
-                    }
-                    case TemplateOpKind::Compute: {
-                        Op o; o.kind = OpKind::ComputeAnd;
-                        const std::size_t bT = (mask >> (base+0)) & 1u;
-                        const std::size_t bM = (mask >> (base+1)) & 1u;
-                        const std::size_t bB = (mask >> (base+2)) & 1u;
-                        o.C_T = bT ? Val::One : Val::Zero;
-                        o.C_M = bM ? Val::One : Val::Zero;
-                        o.C_B = bB ? Val::One : Val::Zero;
-                        e.ops.push_back(o);
-                        break;
-                    }
-                }
+        }
+    }
+
+    size_t template_count() const { return leaves_.size(); }
+    size_t leaves(TemplateLibrary::TemplateId tid) const { return leaves_[tid]; }
+    AddrOrder order(TemplateLibrary::TemplateId tid) const { return order_[tid]; }
+
+    void decode(TemplateLibrary::TemplateId tid, size_t k, MarchElement& out) const {
+        const auto& opts = opts_[tid];
+        out.order = order_[tid];
+        out.ops.resize(opts.size());
+        for (size_t d = opts.size(); d-- > 0;) { out.ops[d] = decode_op(opts[d][k % opts[d].size()]); k /= opts[d].size(); }
+    }
+
+    // fn(k, const vector<OpCode>& codes)，k ∈ [begin, end) ∩ [0, leaves)；codes 原地遞增
+    template <class Fn>
+    void for_each_codes(TemplateLibrary::TemplateId tid, size_t begin, size_t end, Fn&& fn) const {
+        const auto& opts = opts_[tid];
+        end = std::min(end, leaves_[tid]);
+        if (begin >= end) return;
+        vector<size_t> digit(opts.size(), 0);
+        for (size_t d = opts.size(), r = begin; d-- > 0;) { digit[d] = r % opts[d].size(); r /= opts[d].size(); }
+        vector<OpCode> codes(opts.size());
+        for (size_t d = 0; d < opts.size(); ++d) codes[d] = opts[d][digit[d]];
+        for (size_t k = begin; ; ) {
+            fn(k, static_cast<const vector<OpCode>&>(codes));
+            if (++k == end) break;
+            for (size_t d = opts.size(); d-- > 0;) { // 下一個組合
+                const bool carry = ++digit[d] == opts[d].size();
+                if (carry) digit[d] = 0;
+                codes[d] = opts[d][digit[d]];
+                if (!carry) break;
             }
-            out.push_back(std::move(e));
         }
+    }
 
-        return out;
-    }  
+private:
+    vector<AddrOrder> order_;
+    vector<vector<vector<OpCode>>> opts_; // [tid][非 None slot] → 選項
+    vector<size_t> leaves_;
+};
+
+// -----------------------------
+// VariantPool (v11)
+// -----------------------------
+// 一個 TemplateLibrary 的所有 element variant 只展開一次，之後 Greedy / Beam / sweep runner 共用：
+//  - 不同的 element 只存一份：order + 一段連續的 encode_op 碼（flat 陣列），以 VariantId 表示
+//  - template tid 的 variant 是 id(k)，k ∈ [begin(tid), end(tid))，依產生順序；重複的 element 指向同一個 id
+//  - 搜尋迴圈以 decode(id, elem) 解到重複使用的 MarchElement，不必每個 beam node / 位置重新產生 variant
+// 兩種順序：Generator = ICandidateGenerator::generate 的順序（Greedy、Beam::run）；
+// SlotDfs = run_stream 的順序（各 slot 的值依 DFS 組合，最後一個 slot 變化最快）。v12: 兩種都可給 cap，每個 template 最多存前 cap 個
+class VariantPool {
+public:
+    using VariantId = std::uint32_t;
+    enum class Kind { Generator, SlotDfs };
+
+    VariantPool() = default;
+    // v12: 經 for_each_variant 逐一展開，每個 template 最多前 cap 個（cap 讓很大的空間也能以有限記憶體建池）
+    VariantPool(const TemplateLibrary& lib, const ICandidateGenerator& gen, size_t cap = std::numeric_limits<size_t>::max())
+        : kind_(Kind::Generator) {
+        vector<OpCode> buf;
+        for (size_t tid = 0; tid < lib.size(); ++tid) {
+            const size_t leaves = gen.variant_count(lib, tid);
+            gen.for_each_variant(lib, tid, 0, std::min(leaves, cap), [&](size_t, const MarchElement& e) {
+                buf.clear();
+                for (const auto& op : e.ops) buf.push_back(encode_op(op));
+                ids_.push_back(intern(e.order, buf));
+            });
+            offset_.push_back(ids_.size());
+            leaves_.push_back(leaves);
+        }
+        index_.clear();
+    }
+
+    static VariantPool slot_dfs(const TemplateLibrary& lib, size_t cap = std::numeric_limits<size_t>::max()) {
+        return slot_dfs(SlotValueSpace(lib), cap);
+    }
+    static VariantPool slot_dfs(const SlotValueSpace& space, size_t cap = std::numeric_limits<size_t>::max()) {
+        VariantPool pool;
+        pool.kind_ = Kind::SlotDfs;
+        for (size_t tid = 0; tid < space.template_count(); ++tid) {
+            space.for_each_codes(tid, 0, cap, [&](size_t, const vector<OpCode>& codes) {
+                pool.ids_.push_back(pool.intern(space.order(tid), codes));
+            });
+            pool.offset_.push_back(pool.ids_.size());
+            pool.leaves_.push_back(space.leaves(tid));
+        }
+        pool.index_.clear();
+        return pool;
+    }
+
+    Kind kind() const { return kind_; }
+    size_t template_count() const { return leaves_.size(); }
+    size_t begin(TemplateLibrary::TemplateId tid) const { return offset_[tid]; }
+    size_t end(TemplateLibrary::TemplateId tid) const { return offset_[tid + 1]; }
+    // template 的完整組合數（可能因 cap 只存了前面一段；飽和到 size_t max）
+    size_t leaves(TemplateLibrary::TemplateId tid) const { return leaves_[tid]; }
+    VariantId id(size_t k) const { return ids_[k]; }
+
+    size_t distinct() const { return order_.size(); }
+    AddrOrder order(VariantId v) const { return order_[v]; }
+    size_t op_count(VariantId v) const { return code_at_[v + 1] - code_at_[v]; }
+    const OpCode* codes(VariantId v) const { return codes_.data() + code_at_[v]; }
+
+    // 解到 out（沿用 out.ops 的容量）
+    void decode(VariantId v, MarchElement& out) const { decode_element(order_[v], codes(v), op_count(v), out); }
+    MarchElement element(VariantId v) const { MarchElement e; decode(v, e); return e; }
+
+    // SlotDfs 且每個 template 的前 cap 個組合都在池中（run_stream(L, cap) 可直接使用）
+    bool covers(size_t cap) const {
+        if (kind_ != Kind::SlotDfs) return false;
+        for (size_t tid = 0; tid < leaves_.size(); ++tid)
+            if (end(tid) - begin(tid) < std::min(leaves_[tid], cap)) return false;
+        return true;
+    }
+
+private:
+    Kind kind_{Kind::Generator};
+    vector<AddrOrder> order_;        // per VariantId
+    vector<std::uint32_t> code_at_{0}; // VariantId v 的碼在 codes_[code_at_[v], code_at_[v+1])
+    vector<OpCode> codes_;
+    vector<VariantId> ids_;          // 各 template 的 variant，依 offset_ 分段
+    vector<size_t> offset_{0};
+    vector<size_t> leaves_;
+    unordered_map<string, VariantId> index_; // 只在建池時用來去重
+
+    VariantId intern(AddrOrder ord, const vector<OpCode>& c) {
+        string key(1, static_cast<char>(ord));
+        key.append(c.begin(), c.end());
+        auto it = index_.emplace(std::move(key), static_cast<VariantId>(order_.size()));
+        if (it.second) {
+            order_.push_back(ord);
+            codes_.insert(codes_.end(), c.begin(), c.end());
+            code_at_.push_back(static_cast<std::uint32_t>(codes_.size()));
+        }
+        return it.first->second;
+    }
 };
 
 // -----------------------------
@@ -332,14 +565,33 @@ inline double score_state_total_ops(const SimulationResult& sim, const MarchTest
 
 // v4: factory 建立具權重參數的 ScoreFunc（使用 lambda capture）
 // 允許呼叫端自訂 w_state, w_total, op_penalty，而不需要改動搜尋器介面或增加繁雜結構。
-inline ScoreFunc make_score_state_total_ops(double w_state, double w_total, double op_penalty) {
-    return [=](const SimulationResult& sim, const MarchTest& mt) -> double {
+// v5: 改用具名 functor，讓搜尋器能認出它只讀覆蓋率欄位
+struct StateTotalOpsScore {
+    double w_state{0.9};
+    double w_total{0.5};
+    double op_penalty{0.01};
+    double operator()(const SimulationResult& sim, const MarchTest& mt) const {
         std::size_t ops_count = 0;
         for (const auto& e : mt.elements) ops_count += e.ops.size();
         return w_state * sim.state_coverage
              + w_total * sim.total_coverage
              - op_penalty * static_cast<double>(ops_count);
-    };
+    }
+};
+
+inline ScoreFunc make_score_state_total_ops(double w_state, double w_total, double op_penalty) {
+    return StateTotalOpsScore{w_state, w_total, op_penalty};
+}
+
+// v5: 內建打分函式只讀四個覆蓋率 → 候選可用 SimulationMode::Summary 模擬，
+// 只有最後回報的結果才補完整模擬。自訂函式（例如讀 cover_lists 的 OpScorer）一律用 Full。
+inline SimulationMode simulation_mode_for(const ScoreFunc& scorer) {
+    using FnPtr = double (*)(const SimulationResult&, const MarchTest&);
+    if (const FnPtr* fp = scorer.target<FnPtr>()) {
+        if (*fp == &default_score_func || *fp == &score_state_total_ops) return SimulationMode::Summary;
+    }
+    if (scorer.target<StateTotalOpsScore>()) return SimulationMode::Summary;
+    return SimulationMode::Full;
 }
 
 // v2: lightweight prefix state for sequence constraints
@@ -497,8 +749,22 @@ public:
         , gen_(std::move(gen))
         , scorer_(std::move(scorer)) // v2
         , constraints_(constraints)   // v2
+        , prepared_(faults, tps)      // v3: buckets / group ids built once
+        , session_(prepared_)         // v3: incremental prefix simulation
+        , sim_mode_(simulation_mode_for(scorer_)) // v5
     {}
 
+    // v5: 自訂 ScoreFunc 若只讀覆蓋率，可手動切成 Summary
+    void set_simulation_mode(SimulationMode mode) { sim_mode_ = mode; }
+
+    // v11: 共用預先展開的 variant（Generator 順序，須由同一個 lib 與等價的 generator 建立）；
+    // nullptr = 第一次 run() 時依 gen_ 自建一份
+    void set_variant_pool(const VariantPool* pool) {
+        if (pool && (pool->kind() != VariantPool::Kind::Generator || pool->template_count() != lib_.size()))
+            throw runtime_error("GreedyTemplateSearcher: variant pool must be a Generator pool of the same library");
+        shared_pool_ = pool;
+    }
+
     // Run greedy for skeleton length L. Returns chosen CandidateResult (single best path)
     CandidateResult run(size_t L) {
         CandidateResult best_overall;
@@ -510,41 +776,56 @@ public:
 
         PrefixState prefix_state; // v2: track D / length for sequence constraints
 
-        // Remaining faults are tracked implicitly by sim reports; for now we always
-        // re-simulate the full prefix to get accurate remaining coverage.
-        // For efficiency you may modify FaultSimulator to support incremental simulation; PoC uses full simulate each time.
+        // v3: the prefix lives in an IncrementalSimulator; each trial only simulates the
+        // appended element (plus detections still pending from the prefix) and is popped afterwards.
+        // v8: Summary mode drops faults already detected by the prefix (coverages unchanged)
+        session_.set_fault_dropping(sim_mode_ == SimulationMode::Summary);
+        session_.reset();
 
         vector<TemplateLibrary::TemplateId> chosen_ids;
         chosen_ids.reserve(L);
+        const VariantPool& pool = variant_pool(); // v11
 
         for (size_t pos = 0; pos < L; ++pos) {
             double best_score_this_pos = -std::numeric_limits<double>::infinity();
             TemplateLibrary::TemplateId best_tid = 0;
-            MarchElement best_elem;
-            SimulationResult best_sim;
+            VariantPool::VariantId best_v = 0;
+            // v10: 這一層已試過的 trial（前綴固定，所以 trial 由 element 決定；v11: 以 VariantId 標記，
+            // 所有空 element 都是同一個 trial）。分數相同且只有嚴格較高才替換，所以略過重複不影響結果
+            tried_.assign(pool.distinct(), 0);
+            bool tried_empty = false;
+            // v11: trial = prefix + 一個 element 的暫存，variant 直接解進最後一格
+            trial_mt_ = prefix_mt;
+            trial_mt_.elements.emplace_back();
+            MarchElement& elem_variant = trial_mt_.elements.back();
 
-            // For each candidate template id, generate element variants (e.g., different values)
             for (size_t tid = 0; tid < lib_.size(); ++tid) {
-                auto elems = gen_->generate(lib_, tid);
-                for (auto &elem_variant : elems) {
+                for (size_t k = pool.begin(tid); k < pool.end(tid); ++k) {
+                    const VariantPool::VariantId v = pool.id(k);
+                    const bool empty = pool.op_count(v) == 0;
+                    if (empty) { if (tried_empty) continue; tried_empty = true; }
+                    else { if (tried_[v]) continue; tried_[v] = 1; }
+                    pool.decode(v, elem_variant);
                     // v2: apply sequence-level constraints before simulating
                     if (constraints_ && !constraints_->allow(prefix_state, elem_variant, pos)) {
                         continue;
                     }
 
-                    // form a trial MT = prefix + candidate element
-                    MarchTest trial_mt = prefix_mt;
-                    if (!elem_variant.ops.empty()) trial_mt.elements.push_back(elem_variant);
-
-                    // simulate trial_mt against current (static) fault list to get coverage
-                    SimulationResult simres = sim_.simulate(trial_mt, faults_, tps_);
-                    double score = scorer_(simres, trial_mt); // v2: use pluggable scorer
+                    // simulate trial (prefix + candidate element) against current (static) fault list to get coverage
+                    if (!empty) session_.append_element(elem_variant);
+                    if (sim_mode_ == SimulationMode::Summary) {
+                        trial_sim_ = SimulationResult::from_summary(session_.summary()); // v5: coverage only
+                    } else {
+                        session_.result(trial_sim_); // v7: reuse buffers across trials
+                    }
+                    if (!empty) session_.pop_element();
+                    double score = scorer_(trial_sim_, empty ? prefix_mt : trial_mt_); // v2: use pluggable scorer
 
                     if (score > best_score_this_pos) {
                         best_score_this_pos = score;
                         best_tid = tid;
-                        best_elem = elem_variant;
-                        best_sim = std::move(simres);
+                        best_v = v;
+                        std::swap(best_sim_, trial_sim_); // v7: trial/best buffers alternate, no copy
                     }
                 }
             }
@@ -555,7 +836,9 @@ public:
                 break;
             }
             // push to prefix
+            const MarchElement best_elem = pool.element(best_v);
             prefix_mt.elements.push_back(best_elem);
+            session_.append_element(best_elem);
             chosen_ids.push_back(best_tid);
 
             // v2: update prefix_state for constraints (D / length)
@@ -569,9 +852,12 @@ public:
             CandidateResult cr;
             cr.sequence = chosen_ids;
             cr.march_test = prefix_mt;
-            cr.sim_result = best_sim;
+            cr.sim_result = best_sim_;
             cr.score = scorer_(cr.sim_result, cr.march_test); // v2: keep score consistent with scorer_
-            if (cr.score > best_overall.score) best_overall = std::move(cr);
+            if (cr.score > best_overall.score) {
+                if (sim_mode_ == SimulationMode::Summary) cr.sim_result = sim_.simulate(prefix_mt, prepared_); // v5: materialize reported prefix only (v8: session_ drops faults)
+                best_overall = std::move(cr);
+            }
         }
 
         // At the end, return best_overall (could be full-length or shorter if stopping earlier)
@@ -586,6 +872,20 @@ private:
     std::unique_ptr<ICandidateGenerator> gen_;
     ScoreFunc scorer_;                        // v2: scoring strategy
     const SequenceConstraintSet* constraints_; // v2: optional sequence constraints
+    PreparedFaultSet prepared_;               // v3: shared read-only fault/TP context
+    IncrementalSimulator session_;            // v3: prefix state reused across trials
+    SimulationMode sim_mode_;                 // v5: Summary when scorer only reads coverages
+    SimulationResult trial_sim_, best_sim_;   // v7: Full-mode buffers reused across trials
+    vector<std::uint8_t> tried_;              // v10: per-level transposition table (v11: by VariantId)
+    MarchTest trial_mt_;                      // v11: prefix + trial element, reused across trials
+    const VariantPool* shared_pool_{nullptr}; // v11: set_variant_pool
+    std::unique_ptr<VariantPool> own_pool_;   // v11: built from gen_ on first run() when none is shared
+
+    const VariantPool& variant_pool() {
+        if (shared_pool_) return *shared_pool_;
+        if (!own_pool_) own_pool_ = std::make_unique<VariantPool>(lib_, *gen_);
+        return *own_pool_;
+    }
 };
 
 // -----------------------------
@@ -613,193 +913,190 @@ public:
         , scorer_(std::move(scorer)) // v2
         , constraints_(constraints)   // v2
         , progress_cb_(std::move(progress_cb)) // v3
+        , prepared_(faults, tps)      // v3: buckets / group ids built once
+        , sim_mode_(simulation_mode_for(scorer_)) // v5
         {}
 
+    // v5: 自訂 ScoreFunc 若只讀覆蓋率，可手動切成 Summary
+    void set_simulation_mode(SimulationMode mode) { sim_mode_ = mode; }
+
+    // v9: run() / run_stream() 的展開在 pool 上平行（nullptr = 呼叫端序列執行）；結果與執行緒數無關。
+    // 有 pool 時 scorer 會被多條執行緒同時呼叫，必須是 thread-safe（內建的都是無狀態函式）
+    void set_thread_pool(ThreadPool* pool) { pool_ = pool; }
+
+    // v11: 共用預先展開的 variant：Generator pool 給 run()（須由同一個 lib 與等價的 generator 建立），
+    // SlotDfs pool 給 run_stream()（cap 不夠時 run_stream 自建）。未設定的那種在第一次使用時自建
+    void set_variant_pool(const VariantPool* pool) {
+        if (!pool) { shared_gen_pool_ = shared_stream_pool_ = nullptr; return; }
+        if (pool->template_count() != lib_.size())
+            throw runtime_error("BeamTemplateSearcher: variant pool was built from a different library");
+        (pool->kind() == VariantPool::Kind::Generator ? shared_gen_pool_ : shared_stream_pool_) = pool;
+    }
+
+    // v12: run_stream 自建 pool 的上限（每個 beam node 的組合數，預設 2^20）；超過時不建池，逐段解出組合
+    void set_stream_pool_limit(size_t leaves) { stream_pool_limit_ = leaves; }
+
     // Run beam search for length L, produce up to top_k final candidates (sorted by score desc)
+    // v9: 每個 beam node 的子節點由一個 worker 展開、模擬並打分（各自的模擬器與工作區），
+    // 只回傳該 node 內的前 beam_width_ 名；呼叫端依 beam 順序收回，以 (score desc, sequence,
+    // 產生順序) 的全序保留前 beam_width_ 名，所以不必排序整層候選，結果也與執行緒數無關
     vector<CandidateResult> run(size_t L, size_t top_k = 1) {
-        struct BeamNode {
-            vector<TemplateLibrary::TemplateId> seq;
-            MarchTest mt;
-            SimulationResult sim; // simulation of mt
-            double score{0.0};
-            PrefixState prefix_state; // v2: per-path sequence state (D / length)
-        };
-
         // initialize beam with empty prefix
         vector<BeamNode> beam;
         BeamNode root;
         root.mt.name = "beam_root";
-        root.score = 0.0;
+        root.score = scorer_(SimulationResult{}, root.mt); // v7: conversion below reuses node.score
         // root.prefix_state is default-initialized (Unknown / length=0)
         beam.push_back(std::move(root));
 
+        const VariantSource variants{&gen_pool(), nullptr}; // v11
+        const size_t workers = pool_ ? pool_->concurrency() : 1;
+        prepare_workspaces(workers, variants.pool->distinct());
+
         for (size_t pos = 0; pos < L; ++pos) {
-            vector<BeamNode> candidates;
-            candidates.reserve(beam.size() * lib_.size());
-
-            // expand each beam node
-            for (const auto& node : beam) {
-                // for each template id
-                for (size_t tid = 0; tid < lib_.size(); ++tid) {
-                    auto elems = gen_->generate(lib_, tid);
-                    for (auto &elem_variant : elems) {
-                        // skip empty element (no ops) to avoid useless candidates, but allow if wanted
-                        if (elem_variant.ops.empty()) continue;
-
-                        // v2: apply sequence-level constraints before simulating
-                        if (constraints_ && !constraints_->allow(node.prefix_state, elem_variant, pos)) {
-                            continue;
-                        }
-
-                        BeamNode nb;
-                        nb.seq = node.seq;
-                        nb.seq.push_back(tid);
-                        nb.mt = node.mt;
-                        nb.mt.elements.push_back(elem_variant);
-
-                        // v2: update prefix_state for this new path
-                        nb.prefix_state = node.prefix_state;
-                        if (constraints_) {
-                            constraints_->update(nb.prefix_state, elem_variant, pos);
-                        } else {
-                            ++nb.prefix_state.length;
-                        }
-
-                        // simulate nb.mt to get accurate coverage given the progressive nature
-                        nb.sim = sim_.simulate(nb.mt, faults_, tps_);
-                        nb.score = scorer_(nb.sim, nb.mt); // v2: use pluggable scorer
-
-                        candidates.push_back(std::move(nb));
-                    }
+            const RankBetter better{&beam};
+            const NodeGroups groups = group_duplicates(beam); // v10
+            vector<Expansion> kept; // heap：最差的在頂端
+            size_t total_candidates = 0;
+            auto collect = [&](size_t i, ExpandedNode&& ex) {
+                const auto& copies = groups.copies[i];
+                total_candidates += ex.candidates * (1 + copies.size());
+                for (auto& c : ex.best) {
+                    for (size_t d : copies) { Expansion dup = c; dup.parent = d; offer_top_k(kept, beam_width_, std::move(dup), better); }
+                    offer_top_k(kept, beam_width_, std::move(c), better);
                 }
+            };
+            // v10: 重複的 node 不展開（回空結果），由 collect 複製代表 node 的候選
+            auto expand = [&](size_t i, size_t worker) {
+                return groups.rep[i] == i ? expand_node(*workspaces_[worker], variants, beam, i, pos, better) : ExpandedNode{};
+            };
+            if (pool_) {
+                pool_->ordered_map(beam.size(), expand, collect);
+            } else {
+                for (size_t i = 0; i < beam.size(); ++i) collect(i, expand(i, 0));
             }
 
-            // sort candidates by score desc and pick top beam_width_
-            std::sort(candidates.begin(), candidates.end(),
-                      [](const BeamNode& a, const BeamNode& b){ return a.score > b.score; });
-
-            if (candidates.empty()) {
+            if (kept.empty()) {
                 // no expansions -> break early
                 break;
             }
-
-            size_t keep = std::min(beam_width_, candidates.size());
-            beam.clear();
-            beam.insert(beam.end(), candidates.begin(), candidates.begin() + keep);
+            std::sort_heap(kept.begin(), kept.end(), better); // best first
+            beam = next_beam(variants, beam, kept);
 
             // v3: progress callback per level
             if (progress_cb_) {
-                progress_cb_(pos+1, candidates.size(), keep);
+                progress_cb_(pos+1, total_candidates, beam.size());
             }
         }
 
-        // beam now contains final prefixes; convert to CandidateResult and sort by score
+        // beam now contains final prefixes, already best first; convert to CandidateResult
         vector<CandidateResult> results;
         for (const auto& node : beam) {
             CandidateResult cr;
             cr.sequence = node.seq;
             cr.march_test = node.mt;
-            cr.sim_result = node.sim;
-            cr.score = scorer_(cr.sim_result, cr.march_test); // v2: consistent score
+            cr.score = node.score; // v7: already scorer_(node's simulation)
             results.push_back(std::move(cr));
         }
-        std::sort(results.begin(), results.end(), [](const CandidateResult& a, const CandidateResult& b){
-            return a.score > b.score;
-        });
 
         if (top_k>0 && results.size()>top_k) results.resize(top_k);
+        materialize(results); // v5
         return results;
     }
 
-    // Streaming beam search (DFS enumeration):
-    //  - Enumerates all value permutations for each template slot via DFS (R/W/Compute), avoiding generator ordering bias
-    //  - Keeps only top beam_width_ nodes per level using min-heap (score ascending)
-    //  - expand_cap limits variants per template; default = unlimited (numeric_limits::max())
+    // Streaming beam search (slot-value enumeration):
+    //  - Enumerates all value permutations for each template slot (R/W/Compute) in DFS order, avoiding generator ordering bias
+    //  - Keeps only top beam_width_ nodes per level
+    //  - expand_cap limits variants per template (the first expand_cap slot-value combinations in DFS order,
+    //    including ones rejected as empty or by constraints); default = unlimited (numeric_limits::max())
     //  - PrefixState is per node; greedy prefix_state not reused (separate state)
     //  - Constraints are read-only strategy objects; no shared mutable state
+    //  - v9: the slot-value space of every beam node is cut into chunks (node, template range, combination
+    //    range); idle workers claim the next chunk, simulate it over a prefix trie in their own workspace
+    //    and keep their own bounded heap. Heaps are merged at the end of the level under the same total
+    //    order as run(), so the kept beam does not depend on the thread count. Workers share the k-th
+    //    best score seen so far (relaxed atomic) and skip candidates that fall below it
+    //  - v12: combinations come from a SlotDfs VariantPool while the capped space has at most stream_pool_limit_
+    //    combinations per node; larger spaces are not pooled and each chunk decodes its range lazily from a
+    //    SlotValueSpace, so memory stays bounded by the chunk size
     //  - Returns up to beam_width_ final candidates sorted by score desc
     vector<CandidateResult> run_stream(size_t L,
                                        size_t expand_cap = std::numeric_limits<size_t>::max()) {
-        struct StreamNode {
-            vector<TemplateLibrary::TemplateId> seq;
-            MarchTest mt;
-            SimulationResult sim;
-            double score{0.0};
-            PrefixState prefix_state; // per-path sequence state
-        };
-        auto betterScore = [](const StreamNode& a, const StreamNode& b){ return a.score > b.score; };
-
         // Initialize beam with root
-        vector<StreamNode> beam;
-        beam.push_back(StreamNode{}); beam.back().mt.name = "stream_root"; // empty
+        vector<BeamNode> beam;
+        beam.push_back(BeamNode{}); beam.back().mt.name = "stream_root"; // empty
+        beam.back().score = scorer_(SimulationResult{}, beam.back().mt); // v7: conversion below reuses node.score
+
+        // 各 template（截斷後）的組合數；leaf_begin 是各 template 在一個 beam node 組合空間中的起點（飽和加法）
+        const SlotValueSpace space(lib_); // v12
+        vector<size_t> leaf_begin(lib_.size() + 1, 0);
+        for (size_t tid = 0; tid < lib_.size(); ++tid) {
+            const size_t n = std::min(space.leaves(tid), expand_cap);
+            leaf_begin[tid + 1] = leaf_begin[tid] > std::numeric_limits<size_t>::max() - n ? std::numeric_limits<size_t>::max() : leaf_begin[tid] + n;
+        }
+        const size_t leaves_per_node = leaf_begin.back();
+        const size_t chunks_per_node = leaves_per_node / STREAM_CHUNK + (leaves_per_node % STREAM_CHUNK != 0);
+        // v11: 組合來自 SlotDfs pool；v12: 太大時不建池（pool == nullptr），由 space 逐段解出
+        const VariantSource variants{stream_pool(space, expand_cap, leaves_per_node), &space};
 
-        for(std::size_t level=0; level<L; ++level){
-            // min-heap (score ascending) storing top beam_width_ nodes
-            auto cmpMin = [](const StreamNode& a, const StreamNode& b){ return a.score > b.score; };
-            std::priority_queue<StreamNode, std::vector<StreamNode>, decltype(cmpMin)> heap(cmpMin);
-            std::size_t total_candidates = 0;
+        const size_t workers = pool_ ? pool_->concurrency() : 1;
+        prepare_workspaces(workers, variants.pool ? variants.pool->distinct() : 0);
 
-            for(const auto& node : beam){
-                for(std::size_t tid=0; tid<lib_.size(); ++tid){
-                    const auto& et = lib_.at(tid);
-                    // Enumerate element variants on-the-fly with cap
-                    // Build slot option lists
-                    struct SlotChoices { TemplateOpKind kind; std::vector<Op> opts; };
-                    std::vector<SlotChoices> slots; slots.reserve(et.slot_count());
-                    auto add_compute = [](std::vector<Op>& v){ for(int m=0;m<8;++m){ Op o; o.kind=OpKind::ComputeAnd; o.C_T=(m&1)?Val::One:Val::Zero; o.C_M=(m&2)?Val::One:Val::Zero; o.C_B=(m&4)?Val::One:Val::Zero; v.push_back(o);} };
-                    for(const auto& s : et.get_slots()){
-                        SlotChoices sc{ s.kind, {} };
-                        switch(s.kind){
-                            case TemplateOpKind::None: break;
-                            case TemplateOpKind::Read: {
-                                Op r0; r0.kind=OpKind::Read; r0.value=Val::Zero; Op r1; r1.kind=OpKind::Read; r1.value=Val::One; sc.opts={r0,r1};
-                            } break;
-                            case TemplateOpKind::Write: {
-                                Op w0; w0.kind=OpKind::Write; w0.value=Val::Zero; Op w1; w1.kind=OpKind::Write; w1.value=Val::One; sc.opts={w0,w1};
-                            } break;
-                            case TemplateOpKind::Compute: {
-                                add_compute(sc.opts);
-                            } break;
-                        }
-                        slots.push_back(std::move(sc));
-                    }
-                    std::vector<int> choice(slots.size(),0);
-                    std::size_t visited=0;
-                    std::function<void(std::size_t)> dfs = [&](std::size_t idx){
-                        if(visited>=expand_cap) return;
-                        if(idx==slots.size()){
-                            MarchElement elem; elem.order = et.get_order();
-                            for(std::size_t si=0; si<slots.size(); ++si){ if(slots[si].kind==TemplateOpKind::None) continue; elem.ops.push_back(slots[si].opts[choice[si]]); }
-                            // skip empty element (no ops)
-                            if(elem.ops.empty()) { ++visited; return; }
-                            if(constraints_ && !constraints_->allow(node.prefix_state, elem, level)){ ++visited; return; }
-                            StreamNode child; child.seq = node.seq; child.seq.push_back(tid); child.mt = node.mt; child.mt.elements.push_back(elem); child.prefix_state = node.prefix_state;
-                            if(constraints_) constraints_->update(child.prefix_state, elem, level); else ++child.prefix_state.length;
-                            child.sim = sim_.simulate(child.mt, faults_, tps_);
-                            child.score = scorer_(child.sim, child.mt);
-                            ++visited; ++total_candidates;
-                            if(heap.size()<beam_width_) heap.push(std::move(child));
-                            else if(child.score > heap.top().score){ heap.pop(); heap.push(std::move(child)); }
-                            return;
-                        }
-                        if(slots[idx].kind==TemplateOpKind::None){ dfs(idx+1); return; }
-                        for(int opt_i=0; opt_i<(int)slots[idx].opts.size(); ++opt_i){ if(visited>=expand_cap) break; choice[idx]=opt_i; dfs(idx+1); }
+        for(std::size_t level=0; level<L; ++level){
+            const RankBetter better{&beam};
+            const NodeGroups groups = group_duplicates(beam); // v10: 只切代表 node 的組合空間
+            const size_t tasks = groups.distinct.size() * chunks_per_node;
+            std::atomic<size_t> next_task{0};
+            std::atomic<double> kth_best{-std::numeric_limits<double>::infinity()};
+            vector<vector<Expansion>> heaps(workers); // 各 worker 的前 beam_width_ 名（最差的在頂端）
+            vector<size_t> accepted(workers, 0);
+
+            auto work = [&](size_t, size_t, size_t w) {
+                Workspace& ws = *workspaces_[w];
+                vector<Expansion>& heap = heaps[w];
+                for (size_t t; (t = next_task.fetch_add(1, std::memory_order_relaxed)) < tasks; ) {
+                    const size_t ni = groups.distinct[t / chunks_per_node];
+                    const size_t lo = (t % chunks_per_node) * STREAM_CHUNK;
+                    const size_t hi = std::min(lo + STREAM_CHUNK, leaves_per_node);
+                    expand_leaves(ws, variants, beam, ni, level, leaf_begin, lo, hi);
+                    const auto& copies = groups.copies[ni];
+                    accepted[w] += ws.batch.size() * (1 + copies.size());
+                    if (ws.batch.empty()) continue;
+                    score_expansions(ws, variants, beam[ni], ws.batch);
+                    auto offer = [&](Expansion&& e) {
+                        offer_top_k(heap, beam_width_, std::move(e), better);
+                        if (heap.size() < beam_width_) return;
+                        const double mine = heap.front().score; // 本 worker 的第 k 名，全域第 k 名不會比它差
+                        double cur = kth_best.load(std::memory_order_relaxed);
+                        while (mine > cur && !kth_best.compare_exchange_weak(cur, mine, std::memory_order_relaxed)) {}
                     };
-                    dfs(0);
+                    for (auto& e : ws.batch) {
+                        if (e.score < kth_best.load(std::memory_order_relaxed)) continue; // 已進不了全域前 k 名
+                        for (size_t d : copies) { Expansion dup = e; dup.parent = d; offer(std::move(dup)); } // v10
+                        offer(std::move(e));
+                    }
                 }
+            };
+            if (pool_) pool_->parallel_for(workers, workers, work);
+            else work(0, 1, 0);
+
+            // merge per-worker heaps into the next beam
+            vector<Expansion> kept;
+            std::size_t total_candidates = 0;
+            for (size_t w = 0; w < workers; ++w) {
+                total_candidates += accepted[w];
+                for (auto& e : heaps[w]) offer_top_k(kept, beam_width_, std::move(e), better);
             }
-            // materialize heap into next beam
-            std::vector<StreamNode> next; next.reserve(heap.size());
-            while(!heap.empty()){ next.push_back(std::move(const_cast<StreamNode&>(heap.top()))); heap.pop(); }
-            std::sort(next.begin(), next.end(), betterScore);
+            std::sort_heap(kept.begin(), kept.end(), better); // best first
+            vector<BeamNode> next = next_beam(variants, beam, kept);
             if(progress_cb_) progress_cb_(level+1, total_candidates, next.size());
             if(next.empty()) break;
             beam = std::move(next);
         }
-        // Convert final beam to results
+        // Convert final beam to results (already best first)
         vector<CandidateResult> out; out.reserve(beam.size());
-        for(auto& n : beam){ CandidateResult cr; cr.sequence = n.seq; cr.march_test = n.mt; cr.sim_result = n.sim; cr.score = scorer_(cr.sim_result, cr.march_test); out.push_back(std::move(cr)); }
-        std::sort(out.begin(), out.end(), [](const CandidateResult& a, const CandidateResult& b){ return a.score > b.score; });
+        for(auto& n : beam){ CandidateResult cr; cr.sequence = n.seq; cr.march_test = n.mt; cr.score = n.score; /* v7 */ out.push_back(std::move(cr)); }
+        materialize(out); // v5
         return out; // size <= beam_width_
     }
 
@@ -813,6 +1110,291 @@ private:
     ScoreFunc scorer_;                        // v2: scoring strategy
     const SequenceConstraintSet* constraints_; // v2: optional sequence constraints
     std::function<void(std::size_t,std::size_t,std::size_t)> progress_cb_; // v3
+    PreparedFaultSet prepared_;               // v3: shared read-only fault/TP context
+    SimulationMode sim_mode_;                 // v5: Summary when scorer only reads coverages
+    ThreadPool* pool_{nullptr};               // v9: run() / run_stream() 的平行展開
+    const VariantPool* shared_gen_pool_{nullptr};    // v11: run() 的 variant（set_variant_pool）
+    const VariantPool* shared_stream_pool_{nullptr}; // v11: run_stream() 的 variant（set_variant_pool）
+    std::unique_ptr<VariantPool> own_gen_pool_, own_stream_pool_; // v11: 未共用時自建，之後的 run 重複使用
+    size_t stream_pool_limit_{size_t(1) << 20};       // v12: set_stream_pool_limit
+
+    struct BeamNode {
+        vector<TemplateLibrary::TemplateId> seq;
+        MarchTest mt;
+        double score{0.0};
+        PrefixState prefix_state; // v2: per-path sequence state (D / length)
+    };
+    // v9: 已打分、尚未實體化的候選：beam[parent] + element（v11: 以 VariantId 表示，不複製 ops）
+    struct Expansion {
+        double score{0.0};
+        size_t parent{0};
+        TemplateLibrary::TemplateId tid{0};
+        size_t ordinal{0}; // 在 parent 的展開中的產生順序
+        VariantPool::VariantId variant{0};
+        PrefixState prefix_state;
+    };
+    // v12: 候選 element 的來源：VariantPool（Expansion::variant 有效），或不建池時由 (tid, ordinal) 從 SlotValueSpace 解出
+    static constexpr VariantPool::VariantId NO_VARIANT = std::numeric_limits<VariantPool::VariantId>::max();
+    struct VariantSource {
+        const VariantPool* pool{nullptr};
+        const SlotValueSpace* space{nullptr};
+        void element(const Expansion& e, MarchElement& out) const {
+            if (pool) pool->decode(e.variant, out);
+            else space->decode(e.tid, e.ordinal, out);
+        }
+    };
+    struct ExpandedNode {
+        vector<Expansion> best; // 該 node 內的前 beam_width_ 名
+        size_t candidates{0};
+    };
+
+    // v9: 每個 worker 一份的模擬器與暫存（v6 / v7 的批次模擬緩衝區也搬到這裡）
+    struct Workspace {
+        explicit Workspace(const PreparedFaultSet& prepared) : prefix_sim(prepared), session(prepared) {}
+        PrefixSummarySimulator prefix_sim;    // v6: Summary batches over a prefix trie
+        IncrementalSimulator session;         // v6: Full batches over a prefix trie
+        vector<CoverageSummary> batch_cov;    // v6: per trie node coverage (Summary)
+        SimulationResult batch_sim;           // v7: Full-mode scoring buffer reused across candidates
+        MarchPrefixTrie trie;
+        vector<MarchPrefixTrie::NodeId> node_of;
+        vector<int> cand_at;
+        vector<double> node_score;
+        MarchTest scratch;                    // v9: 打分用的 parent.mt + 候選 element，不逐一複製前綴
+        vector<Expansion> batch;              // v9: 這次展開的候選
+        MarchElement elem;                    // v11: 目前 variant 解碼後的 element
+        // v11: 同一次展開中重複的 variant 共用 trie 節點；variant_epoch[v] == epoch 時 variant_node[v] 有效
+        vector<MarchPrefixTrie::NodeId> variant_node;
+        vector<std::uint32_t> variant_epoch;
+        std::uint32_t epoch{0};
+    };
+    vector<std::unique_ptr<Workspace>> workspaces_;
+
+    void prepare_workspaces(size_t workers, size_t distinct_variants) {
+        while (workspaces_.size() < workers) workspaces_.push_back(std::make_unique<Workspace>(prepared_));
+        for (auto& ws : workspaces_) {
+            ws->variant_node.resize(distinct_variants);
+            ws->variant_epoch.assign(distinct_variants, 0);
+            ws->epoch = 0;
+        }
+    }
+    // 開始一次新的展開：換 epoch 即清掉 variant → trie 節點的對應
+    static void begin_expansion(Workspace& ws) {
+        if (++ws.epoch == 0) { std::fill(ws.variant_epoch.begin(), ws.variant_epoch.end(), 0); ws.epoch = 1; }
+    }
+
+    const VariantPool& gen_pool() {
+        if (shared_gen_pool_) return *shared_gen_pool_;
+        if (!own_gen_pool_) own_gen_pool_ = std::make_unique<VariantPool>(lib_, *gen_);
+        return *own_gen_pool_;
+    }
+    const VariantPool* stream_pool(const SlotValueSpace& space, size_t cap, size_t leaves_per_node) {
+        if (shared_stream_pool_ && shared_stream_pool_->covers(cap)) return shared_stream_pool_;
+        if (own_stream_pool_ && own_stream_pool_->covers(cap)) return own_stream_pool_.get();
+        if (leaves_per_node > stream_pool_limit_) return nullptr;
+        own_stream_pool_ = std::make_unique<VariantPool>(VariantPool::slot_dfs(space, cap));
+        return own_stream_pool_.get();
+    }
+
+    // v9: 保留前 k 名；heap 頂端是目前最差的，新候選比它好才替換
+    template <class T, class Better>
+    static void offer_top_k(vector<T>& heap, size_t k, T&& x, const Better& better) {
+        if (k == 0) return;
+        if (heap.size() < k) {
+            heap.push_back(std::move(x));
+            std::push_heap(heap.begin(), heap.end(), better);
+        } else if (better(x, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), better);
+            heap.back() = std::move(x);
+            std::push_heap(heap.begin(), heap.end(), better);
+        }
+    }
+
+    // v9: 全序：分數高者先；同分比 sequence（父節點 seq + tid），再比父節點在 beam 中的名次與產生順序
+    struct RankBetter {
+        const vector<BeamNode>* beam;
+        bool operator()(const Expansion& a, const Expansion& b) const {
+            if (a.score != b.score) return a.score > b.score;
+            if (a.parent != b.parent) {
+                const auto& sa = (*beam)[a.parent].seq; const auto& sb = (*beam)[b.parent].seq;
+                if (sa != sb) return std::lexicographical_compare(sa.begin(), sa.end(), sb.begin(), sb.end());
+            }
+            if (a.tid != b.tid) return a.tid < b.tid;
+            if (a.parent != b.parent) return a.parent < b.parent;
+            return a.ordinal < b.ordinal;
+        }
+    };
+
+    // v10: 同一層中 mt 相同的 beam node（不同 template 序列走到同一個 test）只展開代表（最前面那個）。
+    // 子節點的 prefix_state、是否被 constraint 接受與分數都只由 mt + element 決定，
+    // 所以重複 node 的候選就是代表 node 的候選換掉 parent；node 內的排序也相同（同 parent 只比 tid / ordinal）
+    struct NodeGroups {
+        vector<size_t> rep;              // rep[i]：beam[i] 的代表 node
+        vector<vector<size_t>> copies;   // copies[r]：以 r 為代表的其他 node
+        vector<size_t> distinct;         // 所有代表 node（beam 順序）
+    };
+    static NodeGroups group_duplicates(const vector<BeamNode>& beam) {
+        NodeGroups g;
+        g.rep.resize(beam.size());
+        g.copies.resize(beam.size());
+        unordered_map<MarchTestHash, size_t, MarchTestHashHasher> first; // per-level transposition table
+        first.reserve(beam.size());
+        for (size_t i = 0; i < beam.size(); ++i) {
+            auto it = first.emplace(hash_march_test(beam[i].mt), i).first;
+            g.rep[i] = it->second;
+            if (it->second == i) g.distinct.push_back(i);
+            else g.copies[it->second].push_back(i);
+        }
+        return g;
+    }
+
+    // v9: 依 kept（已排好）實體化下一層 beam
+    static vector<BeamNode> next_beam(const VariantSource& variants, const vector<BeamNode>& beam, vector<Expansion>& kept) {
+        vector<BeamNode> next;
+        next.reserve(kept.size());
+        for (auto& e : kept) {
+            const BeamNode& parent = beam[e.parent];
+            BeamNode nb;
+            nb.seq = parent.seq;
+            nb.seq.push_back(e.tid);
+            nb.mt = parent.mt;
+            nb.mt.elements.emplace_back();
+            variants.element(e, nb.mt.elements.back());
+            nb.prefix_state = e.prefix_state;
+            nb.score = e.score;
+            next.push_back(std::move(nb));
+        }
+        return next;
+    }
+
+    // v9: 展開 beam[i]：所有 template × variant 放進 ws 的前綴樹一起模擬（v6），只回傳前 beam_width_ 名
+    ExpandedNode expand_node(Workspace& ws, const VariantSource& source, const vector<BeamNode>& beam, size_t i, size_t pos,
+                             const RankBetter& better) const {
+        const VariantPool& variants = *source.pool;
+        const BeamNode& node = beam[i];
+        ExpandedNode out;
+        vector<Expansion>& all = ws.batch;
+        all.clear();
+        ws.trie.clear();
+        ws.node_of.clear();
+        begin_expansion(ws);
+        const MarchPrefixTrie::NodeId parent = ws.trie.insert(node.mt);
+        for (size_t tid = 0; tid < lib_.size(); ++tid) {
+            for (size_t k = variants.begin(tid); k < variants.end(tid); ++k) {
+                const VariantPool::VariantId v = variants.id(k);
+                // skip empty element (no ops) to avoid useless candidates, but allow if wanted
+                if (variants.op_count(v) == 0) continue;
+                variants.decode(v, ws.elem); // v11
+                // v2: apply sequence-level constraints before simulating
+                if (constraints_ && !constraints_->allow(node.prefix_state, ws.elem, pos)) continue;
+                add_expansion(ws, node, i, tid, all.size(), parent, v, pos);
+            }
+        }
+        out.candidates = all.size();
+        if (all.empty()) return out;
+        score_expansions(ws, source, node, all);
+        for (auto& e : all) offer_top_k(out.best, beam_width_, std::move(e), better);
+        return out;
+    }
+
+    // ws.elem 是 variant v 解碼後的 element（v12: 不建池時 v == NO_VARIANT，不共用 trie 節點）
+    void add_expansion(Workspace& ws, const BeamNode& node, size_t i, size_t tid, size_t ordinal,
+                       MarchPrefixTrie::NodeId parent, VariantPool::VariantId v, size_t pos) const {
+        Expansion e;
+        e.parent = i;
+        e.tid = tid;
+        e.ordinal = ordinal;
+        e.variant = v;
+        // v2: update prefix_state for this new path
+        e.prefix_state = node.prefix_state;
+        if (constraints_) constraints_->update(e.prefix_state, ws.elem, pos);
+        else ++e.prefix_state.length;
+        // v11: 同一次展開中重複的 variant（例如只差 None slot 位置的 template）接到同一個 trie 節點
+        if (v == NO_VARIANT) {
+            ws.node_of.push_back(ws.trie.add_child(parent, ws.elem));
+        } else {
+            if (ws.variant_epoch[v] != ws.epoch) {
+                ws.variant_epoch[v] = ws.epoch;
+                ws.variant_node[v] = ws.trie.add_child(parent, ws.elem);
+            }
+            ws.node_of.push_back(ws.variant_node[v]);
+        }
+        ws.batch.push_back(std::move(e));
+    }
+
+    // v9: all[k] 的 element 是 ws.trie 中 ws.node_of[k] 的最後一個 element（前綴 = node.mt）；
+    // 每個不同前綴只模擬一次（v6），在 ws.scratch 上打分，分數與逐一 sim_.simulate 後打分相同
+    void score_expansions(Workspace& ws, const VariantSource& variants, const BeamNode& node, vector<Expansion>& all) const {
+        ws.scratch = node.mt;
+        ws.scratch.elements.emplace_back();
+        // 同一個 trie 節點（不同 template / variant 展開出相同 element）只模擬、打分一次（v10: Summary 也是）
+        ws.cand_at.assign(ws.trie.size(), -1);
+        for (size_t k = all.size(); k-- > 0;) ws.cand_at[ws.node_of[k]] = (int)k;
+        ws.node_score.assign(ws.trie.size(), 0.0);
+        if (sim_mode_ == SimulationMode::Summary) {
+            ws.prefix_sim.reset();
+            ws.prefix_sim.simulate_batch(ws.trie, ws.batch_cov);
+            for (size_t n = 0; n < ws.trie.size(); ++n) {
+                if (ws.cand_at[n] < 0) continue;
+                variants.element(all[ws.cand_at[n]], ws.scratch.elements.back());
+                ws.node_score[n] = scorer_(SimulationResult::from_summary(ws.batch_cov[n]), ws.scratch);
+            }
+        } else {
+            ws.session.reset();
+            ws.session.simulate_batch(ws.trie, [&](MarchPrefixTrie::NodeId n, const IncrementalSimulator& s) {
+                if (ws.cand_at[n] < 0) return;
+                s.result(ws.batch_sim);
+                variants.element(all[ws.cand_at[n]], ws.scratch.elements.back());
+                ws.node_score[n] = scorer_(ws.batch_sim, ws.scratch);
+            });
+        }
+        for (size_t k = 0; k < all.size(); ++k) all[k].score = ws.node_score[ws.node_of[k]];
+    }
+
+    static constexpr size_t STREAM_CHUNK = 256; // run_stream 一個 task 的組合數
+
+    // v9: 把 beam[ni] 組合空間中的 [lo, hi) 展開到 ws.batch / ws.trie（ordinal = template 內的組合編號）
+    // v11: 組合直接取自 SlotDfs pool；v12: 沒有 pool 時由 SlotValueSpace 從 rank 起依序解出
+    void expand_leaves(Workspace& ws, const VariantSource& variants, const vector<BeamNode>& beam, size_t ni, size_t level,
+                       const vector<size_t>& leaf_begin, size_t lo, size_t hi) const {
+        const BeamNode& node = beam[ni];
+        ws.batch.clear();
+        ws.trie.clear();
+        ws.node_of.clear();
+        begin_expansion(ws);
+        const MarchPrefixTrie::NodeId parent = ws.trie.insert(node.mt);
+        // 沒有非 None slot 的 template 只有一個空 element：略過，但仍計入 expand_cap
+        auto offer = [&](size_t tid, size_t k, VariantPool::VariantId v) {
+            if (!constraints_ || constraints_->allow(node.prefix_state, ws.elem, level))
+                add_expansion(ws, node, ni, tid, k, parent, v, level);
+        };
+        size_t tid = std::upper_bound(leaf_begin.begin(), leaf_begin.end(), lo) - leaf_begin.begin() - 1;
+        for (size_t leaf = lo; leaf < hi; ++tid) {
+            const size_t end = std::min(hi, leaf_begin[tid + 1]);
+            const size_t k0 = leaf - leaf_begin[tid], k1 = k0 + (end - leaf);
+            if (const VariantPool* pool = variants.pool) {
+                for (size_t k = k0; k < k1; ++k) {
+                    const VariantPool::VariantId v = pool->id(pool->begin(tid) + k);
+                    if (pool->op_count(v) == 0) continue;
+                    pool->decode(v, ws.elem);
+                    offer(tid, k, v);
+                }
+            } else {
+                const AddrOrder order = variants.space->order(tid);
+                variants.space->for_each_codes(tid, k0, k1, [&](size_t k, const vector<OpCode>& codes) {
+                    if (codes.empty()) return;
+                    decode_element(order, codes.data(), codes.size(), ws.elem);
+                    offer(tid, k, NO_VARIANT);
+                });
+            }
+            leaf = end;
+        }
+    }
+
+    // v5: 只替最後回報的候選補上完整模擬（cover_lists / fault_detail_map）；
+    // v7: Full 模式的候選也不保留模擬結果，一樣在這裡補
+    void materialize(vector<CandidateResult>& results) {
+        for (auto& cr : results) cr.sim_result = sim_.simulate(cr.march_test, prepared_);
+    }
 };
 
 // -----------------------------
@@ -0,0 +1,235 @@
+#pragma once
+// =============================================================
+//  ThreadPool.hpp — 固定大小的工作執行緒池
+//  - submit(f)：丟一個工作，回傳 future（例外經由 future 轉拋）
+//  - parallel_for(n, shards, fn)：把 [0, n) 切成 shards 段連續區間，
+//    fn(begin, end, shard) 各段各跑一次；呼叫端執行緒也處理一段
+//  - ordered_map(n, fn, sink)：[0, n) 逐項動態分派（誰先閒下來誰取下一項），
+//    fn(i, worker) 的結果依 i 的順序在呼叫端執行緒交給 sink(i, result)
+//  - 等待時呼叫端會順手執行佇列中的工作，所以在 worker 內再呼叫
+//    parallel_for（巢狀平行）不會因為 worker 全部在等待而卡死；ordered_map 的
+//    worker 迴圈也不阻塞（視窗滿了就收工），fn 內可再用同一個 pool
+// =============================================================
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <chrono>
+#include <type_traits>
+#include <algorithm>
+#include <optional>
+#include <exception>
+
+class ThreadPool {
+public:
+    // threads == 0 時不建立 worker，所有工作都在呼叫端執行（等同序列版）
+    explicit ThreadPool(size_t threads = default_threads());
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers_.size(); }
+    // 可同時執行的段數（worker + 呼叫端）
+    size_t concurrency() const { return workers_.size() + 1; }
+
+    template <class F>
+    auto submit(F&& f) -> std::future<std::invoke_result_t<std::decay_t<F>>>;
+
+    template <class F>
+    void parallel_for(size_t n, size_t shards, F&& fn);
+
+    // worker ∈ [0, concurrency())，同一個 worker 不會同時跑兩項，可拿來索引
+    // 每條執行緒自己的模擬器；0 是呼叫端。最多 window 項領先 sink（0 = 4 × concurrency()），
+    // 限制暫存結果的記憶體。sink 只在呼叫端執行，不需要上鎖
+    template <class Fn, class Sink>
+    void ordered_map(size_t n, Fn&& fn, Sink&& sink, size_t window = 0);
+
+    // 等 future 完成；等待期間執行佇列中的其他工作
+    template <class T>
+    T wait(std::future<T>& fut);
+
+    // hardware_concurrency() - 1（呼叫端自己也算一條），至少 0
+    static size_t default_threads() {
+        unsigned hc = std::thread::hardware_concurrency();
+        return hc > 1 ? hc - 1 : 0;
+    }
+
+private:
+    std::vector<std::thread> workers_;
+    std::queue<std::function<void()>> tasks_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_{false};
+
+    void worker_loop();
+    bool run_one(); // 取出並執行一個工作；佇列為空回 false
+};
+
+inline ThreadPool::ThreadPool(size_t threads) {
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i) workers_.emplace_back([this] { worker_loop(); });
+}
+
+inline ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : workers_) t.join();
+}
+
+inline void ThreadPool::worker_loop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            cv_.wait(lk, [this] { return stop_ || !tasks_.empty(); });
+            if (stop_ && tasks_.empty()) return;
+            task = std::move(tasks_.front());
+            tasks_.pop();
+        }
+        task();
+    }
+}
+
+inline bool ThreadPool::run_one() {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (tasks_.empty()) return false;
+        task = std::move(tasks_.front());
+        tasks_.pop();
+    }
+    task();
+    return true;
+}
+
+template <class F>
+inline auto ThreadPool::submit(F&& f) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+    using R = std::invoke_result_t<std::decay_t<F>>;
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+    std::future<R> fut = task->get_future();
+    if (workers_.empty()) { (*task)(); return fut; } // 沒有 worker：就地執行
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        tasks_.emplace([task] { (*task)(); });
+    }
+    cv_.notify_one();
+    return fut;
+}
+
+template <class T>
+inline T ThreadPool::wait(std::future<T>& fut) {
+    while (fut.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        if (!run_one()) fut.wait_for(std::chrono::microseconds(50));
+    }
+    return fut.get();
+}
+
+template <class F>
+inline void ThreadPool::parallel_for(size_t n, size_t shards, F&& fn) {
+    if (n == 0) return;
+    shards = std::max<size_t>(1, std::min(shards, n));
+    auto bound = [&](size_t s) { return n * s / shards; };
+    std::vector<std::future<void>> futs;
+    futs.reserve(shards - 1);
+    for (size_t s = 1; s < shards; ++s) {
+        futs.push_back(submit([&fn, s, b = bound(s), e = bound(s + 1)] { fn(b, e, s); }));
+    }
+    // 第 0 段由呼叫端執行；所有段都等完再轉拋第一個例外，避免 fn 的參照懸空
+    std::exception_ptr err;
+    try { fn(bound(0), bound(1), size_t(0)); } catch (...) { err = std::current_exception(); }
+    for (auto& f : futs) {
+        try { wait(f); } catch (...) { if (!err) err = std::current_exception(); }
+    }
+    if (err) std::rethrow_exception(err);
+}
+
+template <class Fn, class Sink>
+inline void ThreadPool::ordered_map(size_t n, Fn&& fn, Sink&& sink, size_t window) {
+    using R = std::decay_t<std::invoke_result_t<Fn&, size_t, size_t>>;
+    if (n == 0) return;
+    if (window == 0) window = 4 * concurrency();
+    std::vector<std::optional<R>> done(n); // 已算好、尚未交給 sink 的結果
+    std::mutex m;
+    std::condition_variable cv;
+    size_t next = 0, emitted = 0;
+    bool failed = false;
+    std::exception_ptr err;
+    auto claimable = [&] { return next < n && next < emitted + window; };
+    auto fail = [&](std::exception_ptr e) {
+        { std::lock_guard<std::mutex> lk(m); if (!err) err = e; failed = true; }
+        cv.notify_all();
+    };
+    auto run = [&](size_t i, size_t worker) {
+        try {
+            R r = fn(i, worker);
+            { std::lock_guard<std::mutex> lk(m); done[i].emplace(std::move(r)); }
+            cv.notify_all();
+        } catch (...) { fail(std::current_exception()); }
+    };
+
+    // worker 迴圈在視窗關閉時就收工、歸還編號，不在 cv 上等 sink：它可能是呼叫端在
+    // fn 內巢狀 parallel_for 的 wait() 中順手執行的，此時在這裡等就會卡住唯一會推進
+    // emitted 的呼叫端。呼叫端每交出一項再把閒著的編號重新排進佇列
+    std::vector<size_t> idle;
+    for (size_t w = size(); w >= 1; --w) idle.push_back(w);
+    auto loop = [&](size_t w) {
+        for (;;) {
+            size_t i;
+            {
+                std::lock_guard<std::mutex> lk(m);
+                if (failed || !claimable()) { idle.push_back(w); return; }
+                i = next++;
+            }
+            run(i, w);
+        }
+    };
+    std::vector<std::future<void>> futs;
+    auto spawn = [&] {
+        std::vector<size_t> ws;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            if (failed || !claimable()) return;
+            // 最多補到視窗剩下的空位數
+            size_t k = std::min(idle.size(), std::min(n, emitted + window) - next);
+            ws.assign(idle.end() - k, idle.end());
+            idle.resize(idle.size() - k);
+        }
+        for (size_t w : ws) futs.push_back(submit([&loop, w] { loop(w); }));
+    };
+    spawn();
+
+    // 呼叫端：依序交出結果；第 i 項還沒好時自己也領一項來算
+    for (size_t i = 0; i < n; ++i) {
+        std::unique_lock<std::mutex> lk(m);
+        for (;;) {
+            if (failed || done[i]) break;
+            if (claimable()) {
+                size_t j = next++;
+                lk.unlock();
+                run(j, 0);
+                lk.lock();
+                continue;
+            }
+            // 第 i 項正由 worker 計算中（worker 不會等呼叫端，所以一定算得完）
+            cv.wait(lk, [&] { return failed || done[i].has_value() || claimable(); });
+        }
+        if (failed) break;
+        R r = std::move(*done[i]);
+        done[i].reset();
+        ++emitted;
+        lk.unlock();
+        spawn();
+        try { sink(i, std::move(r)); } catch (...) { fail(std::current_exception()); break; }
+    }
+    // 所有 worker 收工後才轉拋，避免 fn / sink 的參照懸空
+    for (auto& f : futs) wait(f);
+    if (err) std::rethrow_exception(err);
+}
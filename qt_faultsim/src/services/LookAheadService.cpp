@@ -57,6 +57,10 @@ std::vector<StepResult> LookAheadService::evaluate(const LookAheadRequest& req)
     // Step 1 only (MVP). Enumerate candidates and evaluate.
     std::vector<Op> cands; enumerateCandidates(cands);
     StepResult s1; s1.stepIndex = 1;
+    // faults/tps 與 scorer 的群組索引對所有候選都相同：只建一次
+    PreparedFaultSet prepared(req.faults, req.tps);
+    FaultSimulator sim;
+    OpScorer scorer; scorer.set_group_index(prepared); scorer.set_weights(req.weights);
     for (const auto& op : cands) {
         // Insert and simulate with provided faults and tps
         MarchTest test = req.base;
@@ -64,8 +68,7 @@ std::vector<StepResult> LookAheadService::evaluate(const LookAheadRequest& req)
         int pos = std::clamp(req.insertPos, 0, (int)ops.size());
         ops.insert(ops.begin()+pos, op);
 
-        FaultSimulator sim;
-        auto simres = sim.simulate(test, req.faults, req.tps);
+        auto simres = sim.simulate(test, prepared);
         // Find flattened index for inserted op
         int flatIndex = -1;
         for (size_t i=0;i<simres.op_table.size();++i){
@@ -74,7 +77,6 @@ std::vector<StepResult> LookAheadService::evaluate(const LookAheadRequest& req)
         }
         CandidateScore cs; cs.candidate = op;
         if (flatIndex >= 0) {
-            OpScorer scorer; scorer.set_group_index(req.tps); scorer.set_weights(req.weights);
             auto outcomes = scorer.score_ops(simres.cover_lists);
             if ((int)outcomes.size() > flatIndex) cs.outcome = outcomes[flatIndex];
             cs.delta.delta = simres.cover_lists[flatIndex];
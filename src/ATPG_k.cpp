@@ -10,14 +10,13 @@
 
 #include "../include/FpParserAndTpGen.hpp"
 #include "../include/FaultSimulator.hpp"
+#include "../include/FaultTpCache.hpp"
 #include "../include/MarchSynth.hpp"
 #include "../include/LookaheadSynth.hpp"
 #include "../include/SynthConfigCLI.hpp"
 
 using std::cout; using std::cerr; using std::endl; using std::string; using std::vector;
 
-static vector<Fault> load_faults(const string& path){ FaultsJsonParser p; FaultNormalizer n; auto raws = p.parse_file(path); vector<Fault> out; for(const auto& rf: raws) out.push_back(n.normalize(rf)); return out; }
-static vector<TestPrimitive> gen_tps(const vector<Fault>& faults){ TPGenerator g; vector<TestPrimitive> tps; for(const auto& f: faults){ auto v=g.generate(f); tps.insert(tps.end(), v.begin(), v.end()); } return tps; }
 
 static void print_mt(const MarchTest& mt){
     cout << "MarchTest '"<< mt.name <<"' ("<< mt.elements.size() <<" elements)\n";
@@ -143,8 +142,9 @@ int main(int argc, char** argv){
             target = std::max(0.0, std::min(1.0, std::atof(argv[3])));
         }
 
-        auto faults = load_faults(faults_json);
-        auto tps = gen_tps(faults);
+        auto fault_set = load_fault_tp_set(faults_json);
+        auto& faults = fault_set.faults;
+        auto& tps = fault_set.tps;
 
         SynthConfig cfg; // defaults; can be overridden by flags
         // Parse optional flags anywhere after faults.json (positional k/target may be overridden by flags)
@@ -0,0 +1,59 @@
+// Cross-check TP-model coverage against concrete fault injection on a rows x cols array
+// (known semantic differences from the TP model are listed in ArrayFaultSimulator.hpp)
+// g++ -std=c++17 -O2 -pthread -Iinclude src/ArrayCoverageCheck.cpp -o ArrayCoverageCheck
+// ./ArrayCoverageCheck [march.json] [faults.json] [rows] [cols]
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include "FpParserAndTpGen.hpp"
+#include "FaultSimulator.hpp"
+#include "FaultTpCache.hpp"
+#include "ArrayFaultSimulator.hpp"
+#include "ThreadPool.hpp"
+
+int main(int argc, char** argv){
+    std::string march_path  = (argc > 1) ? argv[1] : std::string("input/MarchTest.json");
+    std::string faults_path = (argc > 2) ? argv[2] : std::string("input/S_C_faults.json");
+    ArrayGeometry geo;
+    if(argc > 3) geo.rows = std::stoul(argv[3]);
+    if(argc > 4) geo.cols = std::stoul(argv[4]);
+
+    try{
+        ThreadPool pool;
+        auto fault_set = load_fault_tp_set(faults_path, default_fault_tp_cache_dir(), &pool);
+        auto& faults = fault_set.faults;
+        auto& tps    = fault_set.tps;
+        PreparedFaultSet prepared(faults, tps);
+        auto raws = MarchTestJsonParser().parse_file(march_path);
+
+        ArrayFaultSimulator array_sim(faults, geo);
+        array_sim.set_thread_pool(&pool);
+        FaultSimulator sim;
+        using clock = std::chrono::steady_clock;
+        std::cout << "[Array] " << geo.rows << " x " << geo.cols << " cells, threads=" << pool.concurrency() << std::endl;
+        size_t mismatched_tests = 0;
+        for(const auto& raw : raws){
+            MarchTest mt = MarchTestNormalizer().normalize(raw);
+            auto t0 = clock::now();
+            ArraySimulationResult concrete = array_sim.simulate(mt);
+            long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - t0).count();
+            SimulationResult model = sim.simulate(mt, prepared);
+            std::cout << "[Array] " << mt.name << ": concrete=" << concrete.total_coverage
+                      << " model=" << model.detect_coverage << " (" << ms << " ms)" << std::endl;
+            bool mismatch = false;
+            for(size_t i = 0; i < faults.size(); ++i){
+                double m = model.fault_detail_map.at(faults[i].fault_id).detect_coverage;
+                if(m == concrete.fault_coverage[i]) continue;
+                mismatch = true;
+                std::cout << "    " << faults[i].fault_id << ": concrete=" << concrete.fault_coverage[i] << " model=" << m << std::endl;
+            }
+            mismatched_tests += mismatch ? 1 : 0;
+        }
+        std::cout << "[Array] " << mismatched_tests << " / " << raws.size() << " tests disagree with the TP model" << std::endl;
+    } catch(const std::exception& e){
+        std::cerr << "[Array] " << e.what() << std::endl; return 2;
+    }
+    return 0;
+}
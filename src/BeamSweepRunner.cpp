@@ -13,6 +13,8 @@
 #include "TemplateSearchReport.hpp"
 #include "FpParserAndTpGen.hpp"
 #include "FaultSimulator.hpp"
+#include "FaultTpCache.hpp"
+#include "ThreadPool.hpp"
 
 using css::template_search::TemplateLibrary;
 using css::template_search::BeamTemplateSearcher;
@@ -21,13 +23,7 @@ using css::template_search::SequenceConstraintSet;
 using css::template_search::FirstElementWriteOnlyConstraint;
 using css::template_search::DataReadPolarityConstraint;
 using css::template_search::ValueExpandingGenerator;
-
-static std::vector<Fault> load_faults(const std::string& path){
-    FaultsJsonParser p; FaultNormalizer n; auto raws=p.parse_file(path); std::vector<Fault> out; out.reserve(raws.size()); for(const auto& rf: raws) out.push_back(n.normalize(rf)); return out;
-}
-static std::vector<TestPrimitive> gen_tps(const std::vector<Fault>& faults){
-    TPGenerator g; std::vector<TestPrimitive> tps; tps.reserve(faults.size()*2); for(const auto& f: faults){ auto v=g.generate(f); tps.insert(tps.end(), v.begin(), v.end()); } return tps;
-}
+using css::template_search::VariantPool;
 
 int main(int argc, char** argv){
     if (argc < 3) {
@@ -43,9 +39,11 @@ int main(int argc, char** argv){
     std::string out_html = (argc > 6) ? argv[6] : std::string("output/BeamSweep_Bests.html");
 
     // Load faults & tps
-    auto faults = load_faults(faults_path);
-    auto tps    = gen_tps(faults);
+    auto fault_set = load_fault_tp_set(faults_path);
+    auto& faults = fault_set.faults;
+    auto& tps    = fault_set.tps;
     FaultSimulator sim;
+    ThreadPool pool; // run_stream expands candidates on all cores
 
     // Constraints as used elsewhere in project
     SequenceConstraintSet constraints;
@@ -61,6 +59,7 @@ int main(int argc, char** argv){
     for (std::size_t slots = 1; slots <= max_ops; ++slots) {
         TemplateLibrary lib = TemplateLibrary::make_bruce(slots);
         std::cout << "[Sweep] slots=" << slots << " lib.size=" << lib.size() << std::endl;
+        const VariantPool variants = VariantPool::slot_dfs(lib, 1024); // expanded once, shared by every L
         for (std::size_t L = 1; L <= max_elements; ++L) {
             std::cout << "  [Beam] L=" << L << ", BW=" << beam_width << std::endl;
             BeamTemplateSearcher searcher(
@@ -71,6 +70,8 @@ int main(int argc, char** argv){
                 &constraints,
                 nullptr // no progress callback to reduce logs
             );
+            searcher.set_thread_pool(&pool);
+            searcher.set_variant_pool(&variants);
             auto t0 = std::chrono::steady_clock::now();
             auto results = searcher.run_stream(L, 1024);
             auto t1 = std::chrono::steady_clock::now();
@@ -1,4 +1,4 @@
-// g++ -std=c++20 -O2 -Wall -Wextra -Iinclude src/FaultSimulationEvent.cpp -o build/FaultSimulationEvent
+// g++ -std=c++20 -O2 -Wall -Wextra -pthread -Iinclude src/FaultSimulationEvent.cpp -o build/FaultSimulationEvent
 // ./build/FaultSimulationEvent input/S_C_faults.json input/MarchTest.json output/March_Sim_Report_event.html
 
 #include <iostream>
@@ -425,10 +425,17 @@ int main(int argc, char** argv){
         if (!warnings.empty()){ ofs << "<details open><summary>Warnings ("<< warnings.size() <<")</summary><ul>"; for (const auto& w: warnings) ofs << "<li>"<< html_escape(w) <<"</li>"; ofs << "</ul></details>"; }
         write_fault_anchors(ofs, raw_faults);
 
-        FaultSimulatorEvent simulator; // new encapsulated event simulator from header
+        // 各 test 平行模擬（每條執行緒一個 FaultSimulatorEvent），結果依輸入順序交回主執行緒寫 HTML
+        ThreadPool pool; vector<FaultSimulatorEvent> simulators(pool.concurrency());
+        // test 數少於核心數時（例如單一長 test）再把每個 test 的 op 迴圈切段平行
+        if (marchTests.size() < pool.concurrency()) for (auto& s : simulators) s.set_thread_pool(&pool);
+        struct TestRun { SimulationEventResult sim; long long us; };
         auto t3s=clock::now(); long long per_tests_sum_us=0;
-        for (size_t mi=0; mi<marchTests.size(); ++mi){ const auto& mt = marchTests[mi]; auto tms=clock::now();
-            auto sim = simulator.simulate(mt, faults, all_tps); auto tme=clock::now(); auto us = to_us(tme-tms); per_tests_sum_us += us;
+        pool.ordered_map(marchTests.size(),
+            [&](size_t mi, size_t worker){ auto tms=clock::now();
+                TestRun run{simulators[worker].simulate(marchTests[mi], faults, all_tps), 0}; run.us = to_us(clock::now()-tms); return run; },
+            [&](size_t mi, TestRun&& run){ const auto& mt = marchTests[mi];
+            const auto& sim = run.sim; const auto us = run.us; per_tests_sum_us += us;
             
             // --- Coverage Calculation ---
             unordered_set<size_t> detected_tp_set;
@@ -625,8 +632,8 @@ int main(int argc, char** argv){
             ofs << "  </div>\n"; // end fa-panel
 
             ofs << "</div>\n"; // end march-section
-            cout << "[時間] 3) 模擬+輸出 March Test '"<< mt.name <<"': "<< us <<" us (ops="<< sim.op_table.size() <<")\n";
-        }
+            cout << "[時間] 3) 模擬 March Test '"<< mt.name <<"': "<< us <<" us (ops="<< sim.op_table.size() <<")\n";
+            });
         auto t3e=clock::now(); cout << "[時間] 3) 執行時間(包含撰寫報告)總耗時: "<< to_us(t3e-t3s) <<" us (單測累計="<< per_tests_sum_us <<" us)\n";
         ofs << "</body></html>\n"; ofs.close();
         cout << "HTML report written to: "<< opt.output_html <<"\n";
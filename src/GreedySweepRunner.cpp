@@ -14,6 +14,7 @@
 #include "TemplateSearchReport.hpp"
 #include "FpParserAndTpGen.hpp"
 #include "FaultSimulator.hpp"
+#include "FaultTpCache.hpp"
 
 using css::template_search::TemplateLibrary;
 using css::template_search::GreedyTemplateSearcher;
@@ -22,13 +23,7 @@ using css::template_search::SequenceConstraintSet;
 using css::template_search::FirstElementWriteOnlyConstraint;
 using css::template_search::DataReadPolarityConstraint;
 using css::template_search::ValueExpandingGenerator;
-
-static std::vector<Fault> load_faults(const std::string& path){
-    FaultsJsonParser p; FaultNormalizer n; auto raws=p.parse_file(path); std::vector<Fault> out; out.reserve(raws.size()); for(const auto& rf: raws) out.push_back(n.normalize(rf)); return out;
-}
-static std::vector<TestPrimitive> gen_tps(const std::vector<Fault>& faults){
-    TPGenerator g; std::vector<TestPrimitive> tps; tps.reserve(faults.size()*2); for(const auto& f: faults){ auto v=g.generate(f); tps.insert(tps.end(), v.begin(), v.end()); } return tps;
-}
+using css::template_search::VariantPool;
 
 int main(int argc, char** argv){
     if (argc < 3) {
@@ -67,8 +62,9 @@ int main(int argc, char** argv){
 #endif
 
     // Load faults & tps
-    auto faults = load_faults(faults_path);
-    auto tps    = gen_tps(faults);
+    auto fault_set = load_fault_tp_set(faults_path);
+    auto& faults = fault_set.faults;
+    auto& tps    = fault_set.tps;
     FaultSimulator sim;
 
     // Collect per-configuration bests
@@ -80,6 +76,7 @@ int main(int argc, char** argv){
     for (std::size_t slots = 1; slots <= max_ops; ++slots) {
         TemplateLibrary lib = TemplateLibrary::make_bruce(slots);
         std::cout << "[Sweep] slots=" << slots << " lib.size=" << lib.size() << std::endl;
+        const VariantPool variants(lib, ValueExpandingGenerator()); // expanded once, shared by every L
 
         // constraints used during greedy
         SequenceConstraintSet constraints;
@@ -115,6 +112,7 @@ int main(int argc, char** argv){
                 scorer,
                 &constraints
             );
+            searcher.set_variant_pool(&variants);
             auto t0 = std::chrono::steady_clock::now();
             CandidateResult best = searcher.run(L);
             auto t1 = std::chrono::steady_clock::now();
@@ -1,17 +1,17 @@
 // # 編譯（需 C++17 以上）
-// g++ -std=c++17 -O2 -Wall -Wextra -o src/MarchSimHtml src/MarchSimHtml.cpp
+// g++ -std=c++17 -O2 -Wall -Wextra -pthread -o src/MarchSimHtml src/MarchSimHtml.cpp
 
 // # 執行
 // ./src/MarchSimHtml input/S_C_faults.json input/MarchTest.json output/March_Sim_Report.html
 
 // # 合併
-// g++ -std=c++17 -O2 -Wall -Wextra -o src/MarchSimHtml src/MarchSimHtml.cpp && ./src/MarchSimHtml input/S_C_faults.json input/MarchTest.json output/March_Sim_Report.html
+// g++ -std=c++17 -O2 -Wall -Wextra -pthread -o src/MarchSimHtml src/MarchSimHtml.cpp && ./src/MarchSimHtml input/S_C_faults.json input/MarchTest.json output/March_Sim_Report.html
 
 // MarchSimHtml.cpp — 產生 March 模擬後的 cover lists HTML 報告（以 argv 指定輸入輸出）
 // -------------------------------------------------------------------------------------------------
 // 功能總覽：
 // 1) 讀取 faults.json → 以 FaultNormalizer 正規化為 Fault → 以 TPGenerator 產生所有 TestPrimitive
-// 2) 讀取 MarchTest.json → 正規化 → 逐一呼叫 FaultSimulator::simulate
+// 2) 讀取 MarchTest.json → 正規化 → 各 test 平行呼叫 FaultSimulator::simulate（依輸入順序輸出）
 // 3) 每個 MarchTest 輸出四段內容：State / Sens / Detect cover 三張表 + Fault coverage summary
 //
 // 風格與維護性：
@@ -61,7 +61,7 @@
 //       std::vector<size_t> detect_tp_gids; // 命中 detect 的 TP gids
 //   };
 //   struct SimulationResult {
-//       std::vector<OpContext> op_table;                        // 模擬展開後的 op 清單（含 pre-state）
+//       OpTable op_table;                                       // 模擬展開後的 op 清單（SoA；op_table[i] 回傳 OpContext 檢視）
 //       std::vector<CoverListPerOp> cover_lists;                // 對應每個 op 的 cover 結果
 //       std::unordered_map<std::string, FaultCoverageDetail> fault_detail_map; // 依 fault_id 彙總
 //       double total_coverage;                                  // 全體 fault coverage
@@ -573,8 +573,13 @@ static void write_opscore_table(std::ostream& os, const SimulationResult& sim,
 		}
 		{
 			std::ostringstream oss; oss.setf(std::ios::fixed);
-			oss<< std::setprecision(4) << outcome.S_cov;
-			os << "<li><b>S_cov</b>: "<< oss.str() <<"</li>";
+			oss<< std::setprecision(4) << outcome.state_cov;
+			os << "<li><b>state_cov</b>: "<< oss.str() <<"</li>";
+		}
+		{
+			std::ostringstream oss; oss.setf(std::ios::fixed);
+			oss<< std::setprecision(4) << outcome.sens_cov;
+			os << "<li><b>sens_cov</b>: "<< oss.str() <<"</li>";
 		}
 		os << "<li><b>D_cov</b>: "<< outcome.D_cov <<"</li>";
 		os << "<li><b>part_M_num</b>: "<< outcome.part_M_num <<"</li>";
@@ -848,7 +853,10 @@ int main(int argc, char** argv){
 			if (it.contains("OpScoreWeights") && it["OpScoreWeights"].is_object()){
 				WeightCfg wc; wc.has = true;
 				const auto& W = it["OpScoreWeights"];
-				if (W.contains("alpha_S")) wc.w.alpha_S = W["alpha_S"].get<double>();
+				// 舊版 JSON 只有一個 alpha_S（state 與 sens 共用）
+				if (W.contains("alpha_S")) wc.w.alpha_state = wc.w.alpha_sens = W["alpha_S"].get<double>();
+				if (W.contains("alpha_state")) wc.w.alpha_state = W["alpha_state"].get<double>();
+				if (W.contains("alpha_sens")) wc.w.alpha_sens = W["alpha_sens"].get<double>();
 				if (W.contains("beta_D")) wc.w.beta_D = W["beta_D"].get<double>();
 				if (W.contains("gamma_MPart")) wc.w.gamma_MPart = W["gamma_MPart"].get<double>();
 				if (W.contains("lambda_MAll")) wc.w.lambda_MAll = W["lambda_MAll"].get<double>();
@@ -874,16 +882,27 @@ int main(int argc, char** argv){
 		}
 
 		// 逐個 March Test 模擬並輸出
-		FaultSimulator simulator;
+		// 各 test 平行模擬（每條執行緒一個 FaultSimulator，共用同一份 PreparedFaultSet），
+		// 結果依輸入順序交回主執行緒寫 HTML，報告內容與序列版相同
+		PreparedFaultSet prepared(faults, all_tps);
+		ThreadPool pool;
+		vector<FaultSimulator> simulators(pool.concurrency());
+		// test 數少於核心數時（例如單一長 test）再把每個 test 的 op 迴圈切段平行
+		if (marchTests.size() < pool.concurrency()) for (auto& s : simulators) s.set_thread_pool(&pool);
+		struct TestRun { SimulationResult sim; long long us; };
 		auto t3_start = clock::now();
 	long long per_tests_sum_us = 0;
-		for (size_t mi=0; mi<marchTests.size(); ++mi){
+		pool.ordered_map(marchTests.size(),
+			[&](size_t mi, size_t worker){
+				auto t_mt_start = clock::now();
+				TestRun run{simulators[worker].simulate(marchTests[mi], prepared), 0};
+				run.us = to_us(clock::now() - t_mt_start);
+				return run;
+			},
+			[&](size_t mi, TestRun&& run){
 			const auto& mt = marchTests[mi];
-			auto t_mt_start = clock::now();
-			auto sim = simulator.simulate(mt, faults, all_tps);
-			auto t_mt_end = clock::now();
-			auto us = to_us(t_mt_end - t_mt_start);
-			per_tests_sum_us += us;
+			const auto& sim = run.sim;
+			per_tests_sum_us += run.us;
 
 			std::ostringstream covss; covss.setf(std::ios::fixed); covss<< std::setprecision(2) << (sim.total_coverage*100.0) << "%";
 			ofs << "<details open><summary>March Test: "<<html_escape(mt.name)
@@ -908,9 +927,9 @@ int main(int argc, char** argv){
 
 			ofs << "</details>\n";
 			
-		  cout << "[時間] 3) 模擬+輸出 March Test '" << mt.name << "': " << us
+		  cout << "[時間] 3) 模擬 March Test '" << mt.name << "': " << run.us
 			  << " us (ops=" << sim.op_table.size() << ")\n";
-		}
+			});
 		auto t3_end = clock::now();
 	   cout << "[時間] 3) 執行時間(包含撰寫報告)總耗時: " << to_us(t3_end - t3_start)
 		   << " us (單測累計=" << per_tests_sum_us << " us)\n";
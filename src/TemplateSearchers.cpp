@@ -15,6 +15,7 @@
 
 #include "FpParserAndTpGen.hpp"
 #include "FaultSimulator.hpp"
+#include "FaultTpCache.hpp"
 #include "TemplateSearchers.hpp"
 #include "TemplateSearchReport.hpp" // new HTML report class
 
@@ -31,22 +32,6 @@ using css::template_search::FirstElementHasWriteNoReadConstraint; // v3: first e
 // Single-responsibility helpers
 // ------------------------------
 
-// Load faults from JSON
-static vector<Fault> load_faults(const string& path){
-    FaultsJsonParser p; FaultNormalizer n;
-    auto raws = p.parse_file(path);
-    vector<Fault> out; out.reserve(raws.size());
-    for (const auto& rf: raws) out.push_back(n.normalize(rf));
-    return out;
-}
-
-// Generate test primitives from faults
-static vector<TestPrimitive> gen_tps(const vector<Fault>& faults){
-    TPGenerator g; vector<TestPrimitive> tps; tps.reserve(faults.size()*2);
-    for (const auto& f: faults){ auto v=g.generate(f); tps.insert(tps.end(), v.begin(), v.end()); }
-    return tps;
-}
-
 // Build a brute-force template library (valid elements only)
 static TemplateLibrary make_bruce_lib(std::size_t slot_count){
     TemplateLibrary lib = TemplateLibrary::make_bruce(slot_count);
@@ -156,6 +141,8 @@ static vector<CandidateResult> run_beam_topk(FaultSimulator& sim,
         std::cout << "[Beam] Level "<< level << "/"<< L << ": candidates="<< candidates << ", kept="<< kept << std::endl;
     };
     BeamTemplateSearcher searcher(sim, lib, faults, tps, beam_width, std::move(gen), std::move(scorer), &seq_constraints, progress); // custom scorer + progress
+    ThreadPool pool; // v9: expand beam nodes on all cores (result does not depend on thread count)
+    searcher.set_thread_pool(&pool);
     return searcher.run(L, top_k);
 }
 
@@ -170,8 +157,9 @@ int run_template_search_html(const string& faults_json_path,
                              double w_total,
                              double op_penalty,
                              std::size_t slot_count){
-    auto faults = load_faults(faults_json_path);
-    auto tps    = gen_tps(faults);
+    auto fault_set = load_fault_tp_set(faults_json_path);
+    auto& faults = fault_set.faults;
+    auto& tps    = fault_set.tps;
 
     FaultSimulator sim;
     auto lib = make_bruce_lib(slot_count);
@@ -252,7 +240,7 @@ static vector<CandidateResult> run_greedy_prefixes(FaultSimulator& sim,
                                                    css::template_search::ScoreFunc scorer){
     vector<CandidateResult> out;
 
-    css::template_search::ValueExpandingGenerator defGen; // v2: value-expanding generator (enumerates R/W/C permutations)
+    const css::template_search::VariantPool variants(lib, css::template_search::ValueExpandingGenerator()); // v11: R/W/C permutations expanded once
 
     // v2: install sequence constraints (first element W-only + data read polarity)
     SequenceConstraintSet seq_constraints; // v2
@@ -267,10 +255,10 @@ static vector<CandidateResult> run_greedy_prefixes(FaultSimulator& sim,
     std::cout << "[Greedy] Start: L="<< L << ", lib="<< lib.size() << std::endl;
 
     for(size_t pos=0; pos<L && out.size()<top_k; ++pos){
-        double best_score = -1e100; TemplateLibrary::TemplateId best_tid=0; MarchElement best_elem; SimulationResult best_sim;
+        double best_score = -1e100; TemplateLibrary::TemplateId best_tid=0; MarchElement best_elem, elem_variant; SimulationResult best_sim;
         for(size_t tid=0; tid<lib.size(); ++tid){
-            auto elems = defGen.generate(lib, tid);
-            for(auto &elem_variant : elems){
+            for(size_t k=variants.begin(tid); k<variants.end(tid); ++k){
+                variants.decode(variants.id(k), elem_variant);
                 // v2: apply sequence constraints before simulate
                 if(!seq_constraints.allow(prefix_state, elem_variant, pos)) continue; // v2
 
@@ -327,8 +315,9 @@ int main(int argc, char** argv){
     auto scorer = css::template_search::make_score_state_total_ops(w_state, w_total, op_penalty);
 
     // Load data and build lib
-    auto faults_vec = load_faults(faults);
-    auto tps_vec    = gen_tps(faults_vec);
+    auto fault_set  = load_fault_tp_set(faults);
+    auto& faults_vec = fault_set.faults;
+    auto& tps_vec    = fault_set.tps;
     FaultSimulator sim;
     auto lib = make_bruce_lib(slot_count);
 
@@ -7,10 +7,17 @@
 #include <string>
 #include <algorithm>
 #include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <atomic>
 
 #include "FpParserAndTpGen.hpp"
 #include "FaultSimulator.hpp"
 #include "MarchSynth.hpp"
+#include "ArrayFaultSimulator.hpp"
+#include "FaultTpCache.hpp"
+#include "MarchTestLoader.hpp"
+#include "TemplateSearchers.hpp"
 
 using std::cout; using std::endl; using std::string; using std::vector;
 
@@ -30,6 +37,16 @@ static void test_FaultsJsonParser(){
     FaultsJsonParser p; auto raws = p.parse_file("input/S_C_faults.json");
     CHECK(!raws.empty(), "parse_file returns non-empty");
     CHECK(!raws[0].fault_id.empty(), "first fault has id");
+    vector<RawFault> streamed;
+    p.parse_stream("input/S_C_faults.json", [&](RawFault&& rf){ streamed.push_back(std::move(rf)); });
+    bool same = streamed.size()==raws.size();
+    for (size_t i=0; same && i<raws.size(); ++i)
+        same = streamed[i].fault_id==raws[i].fault_id && streamed[i].category==raws[i].category &&
+               streamed[i].cell_scope==raws[i].cell_scope && streamed[i].fp_raw==raws[i].fp_raw;
+    CHECK(same, "parse_stream emits the same faults as parse_file");
+    bool threw = false;
+    try { p.parse_stream("input/MarchTest.json", [](RawFault&&){}); } catch (const std::runtime_error&) { threw = true; }
+    CHECK(threw, "parse_stream rejects a non-fault JSON file");
 }
 
 static void test_FaultNormalizer(){
@@ -54,6 +71,24 @@ static void test_MarchTestJson_and_Normalizer(){
     CHECK(!raws.empty(), "parse march tests json non-empty");
     MarchTestNormalizer n; auto mt = n.normalize(raws[0]);
     CHECK(!mt.elements.empty(), "normalized test has elements");
+    MarchTest pt; string err;
+    MarchPatternParser::parse(" b ( W0 ) ; a(R0,W1, C (1)(0)(1),) ;;d(R1)", pt);
+    CHECK(pt.elements.size()==3 && pt.elements[0].order==AddrOrder::Any && pt.elements[1].ops.size()==3 &&
+          pt.elements[1].ops[2].kind==OpKind::ComputeAnd && pt.elements[1].ops[2].C_M==Val::Zero && pt.elements[2].order==AddrOrder::Down,
+          "MarchPatternParser handles spaces, empty elements and trailing commas");
+    CHECK(!MarchPatternParser::try_parse("a(R0,,W1)", pt, &err) && !MarchPatternParser::try_parse("x(R0)", pt) &&
+          !MarchPatternParser::try_parse("a(C(1)(2)(0))", pt) && err.find("column 6")!=string::npos, "MarchPatternParser rejects malformed patterns");
+    auto bulk = load_march_tests("input/MarchTest.json");
+    bool same = bulk.size()==raws.size();
+    for (size_t i=0; same && i<raws.size(); ++i){
+        auto ref = n.normalize(raws[i]);
+        same = bulk[i].name==ref.name && bulk[i].elements.size()==ref.elements.size();
+        for (size_t e=0; same && e<ref.elements.size(); ++e){
+            same = bulk[i].elements[e].order==ref.elements[e].order && bulk[i].elements[e].ops.size()==ref.elements[e].ops.size();
+            for (size_t k=0; same && k<ref.elements[e].ops.size(); ++k) same = encode_op(bulk[i].elements[e].ops[k])==encode_op(ref.elements[e].ops[k]);
+        }
+    }
+    CHECK(same, "load_march_tests matches parse_file + normalize");
 }
 
 static void test_RawMarchEditor(){
@@ -73,13 +108,49 @@ static void test_OpTableBuilder(){
     cout << "[Class] OpTableBuilder\n";
     auto mt = mk_simple_march(); OpTableBuilder b; auto opt = b.build(mt);
     CHECK(!opt.empty(), "build produces op table");
+    // SoA 表的 OpContext 檢視：op 與 pre_state 由 1-byte 編碼與 state key 還原
+    bool view_ok = true;
+    for (size_t i=0;i<opt.size();++i){
+        auto oc = opt[i];
+        view_ok = view_ok && encode_op(oc.op)==opt.code((OpId)i) && encode_to_key(oc.pre_state)==oc.pre_state_key;
+        CrossState enforced = oc.pre_state; enforced.enforceDCrule();
+        view_ok = view_ok && encode_to_key(enforced)==oc.pre_state_key && enforced.A0.D==oc.pre_state.A0.D && enforced.A1.C==oc.pre_state.A1.C;
+    }
+    CHECK(view_ok, "lazy OpContext view round-trips op code and pre_state");
+    bool codes_ok = true;
+    for (int c=0;c<OP_CODE_NUM;++c) codes_ok = codes_ok && encode_op(decode_op((OpCode)c))==c && op_code_match((OpCode)c,(OpCode)c);
+    CHECK(codes_ok, "all 33 op codes decode/encode and self-match");
+    // next Write / next detector 索引需與逐 op 往後掃描一致
+    bool next_ok = true;
+    for (OpId i=0;i<(OpId)opt.size();++i){
+        OpId w=-1; for (OpId j=i;j<(OpId)opt.size() && w<0;++j) if (op_code_kind(opt.code(j))==OpKind::Write) w=j;
+        next_ok = next_ok && opt.next_write(i)==w;
+        for (int p=0;p<OP_CODE_NUM;++p){
+            OpId m=-1; if (p>=3) for (OpId j=i;j<(OpId)opt.size() && m<0;++j) if (op_code_match((OpCode)p,opt.code(j))) m=j;
+            next_ok = next_ok && opt.next_detect(i,(OpCode)p)==m;
+        }
+    }
+    CHECK(next_ok, "next write/detector index equals linear scan");
 }
 
 static void test_CoverLUT(){
     cout << "[Class] CoverLUT\n";
     CoverLUT lut; CrossState cs{}; cs.enforceDCrule();
-    auto& keys = lut.get_compatible_tp_keys(cs);
+    auto keys = lut.get_compatible_tp_keys(cs);
     CHECK(!keys.empty(), "some compatible keys exist for default state");
+    // 編譯期 CSR 表需與逐位比對的 729x729 定義一致（含遞增順序）
+    bool same = true;
+    for (int op=0; op<CSS_EXPANDED_NUM; ++op){
+        vector<size_t> naive;
+        for (int tp=0; tp<CSS_EXPANDED_NUM; ++tp){
+            bool ok = true;
+            for (int i=0, a=op, b=tp; i<KEY_BIT; ++i, a/=3, b/=3) if (b%3!=2 && b%3!=a%3) ok = false;
+            if (ok) naive.push_back(tp);
+        }
+        auto span = CoverLUT::get_compatible_tp_keys_by_key(op);
+        same = same && vector<size_t>(span.begin(), span.end())==naive;
+    }
+    CHECK(same, "CSR table equals naive compatibility table");
 }
 
 static void test_StateCoverEngine(){
@@ -95,22 +166,40 @@ static void test_SensEngine(){
     cout << "[Class] SensEngine\n";
     auto mt = mk_simple_march(); OpTableBuilder b; auto opt=b.build(mt);
     TestPrimitive tp; tp.ops_before_detect = { opt[0].op };
-    SensEngine s; int end = s.cover(opt, 0, tp);
+    SensEngine s; int end = s.cover(opt, 0, tp).sens_end_op;
     CHECK(end==0, "single-step sens matches at 0");
 }
 
+static void test_TPPatternAutomaton(){
+    cout << "[Class] TPPatternAutomaton\n";
+    auto mt = mk_simple_march(); OpTableBuilder b; auto opt=b.build(mt);
+    auto tps = gen_tps(load_faults("input/S_C_faults.json"));
+    // 手工序列：共用前綴、X don't care、超出 element 的長序列
+    Op rx; rx.kind=OpKind::Read; rx.value=Val::X;
+    vector<vector<Op>> seqs = { {}, {opt[0].op}, {opt[0].op, opt[1].op}, {opt[0].op, rx}, {rx}, {opt[1].op, opt[0].op}, {opt[0].op, opt[1].op, opt[0].op, opt[1].op} };
+    for (auto& sq : seqs){ TestPrimitive tp; tp.ops_before_detect = sq; tps.push_back(tp); }
+    TPPatternAutomaton a; a.build(tps); TPPatternAutomaton::MatchBuffer buf; SensEngine s;
+    bool same = true;
+    for (OpId i=0;i<(OpId)opt.size();++i) for (TpGid t=0;t<tps.size();++t){
+        auto x = s.cover(opt, i, tps[t]); auto y = a.cover(opt, i, t, buf);
+        same = same && x.status==y.status && x.sens_end_op==y.sens_end_op && x.sens_mask_at_op==y.sens_mask_at_op;
+    }
+    CHECK(same, "trie sens outcome equals SensEngine::cover for every (op, tp)");
+    CHECK(a.seq_of_tp(tps.size()-seqs.size()+1)!=a.seq_of_tp(tps.size()-seqs.size()+2) && a.seq_length(a.seq_of_tp(tps.size()-1))==4, "distinct sequences get distinct ids");
+}
+
 static void test_DetectEngine(){
     cout << "[Class] DetectEngine\n";
     auto mt = mk_simple_march(); OpTableBuilder b; auto opt=b.build(mt);
     // First, compute a valid sensitization end using SensEngine
     TestPrimitive tpSens; tpSens.ops_before_detect = { opt[0].op, opt[1].op }; // W0, R0
-    SensEngine s; int end = s.cover(opt, 0, tpSens);
+    SensEngine s; int end = s.cover(opt, 0, tpSens).sens_end_op;
     CHECK(end==1, "sens end at index 1");
 
     // Then detect compute C(1)(1)(1) at index 2 using NextElementHead (';') anchor
     DetectEngine d; TestPrimitive tpDet; tpDet.R_has_value=false; tpDet.ops_before_detect = tpSens.ops_before_detect;
     tpDet.detector.detectOp.kind=OpKind::ComputeAnd; tpDet.detector.detectOp.C_T=Val::One; tpDet.detector.detectOp.C_M=Val::One; tpDet.detector.detectOp.C_B=Val::One; tpDet.detector.pos=PositionMark::NextElementHead;
-    int id = d.cover(opt, end, tpDet);
+    int id = d.cover(opt, end, tpDet).det_op;
     CHECK(id==2, ";-anchor detect compute at index 2");
 }
 
@@ -131,6 +220,600 @@ static void test_FaultSimulator(){
     CHECK(res.op_table.size()==mt.elements[0].ops.size()+mt.elements[1].ops.size(), "op table size matches ops");
 }
 
+static void test_PreparedFaultSet(){
+    cout << "[Class] PreparedFaultSet\n";
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    PreparedFaultSet prep(faults, tps);
+    StateCoverEngine eng; eng.build_tp_buckets(tps);
+    bool same = true;
+    for (int key=0; key<CSS_EXPANDED_NUM; ++key){ auto v = eng.cover(key); auto s = prep.state_cover(key); same = same && vector<TpGid>(s.begin(), s.end())==v; }
+    CHECK(same, "flattened state cover equals StateCoverEngine::cover");
+    CHECK(prep.fault_of_tp(0)>=0 && faults[prep.fault_of_tp(0)].fault_id==tps[0].parent_fault_id, "tp -> fault index");
+    FaultSimulator sim; auto mt = mk_simple_march();
+    auto a = sim.simulate(mt, faults, tps); auto b = sim.simulate(mt, prep);
+    CHECK(a.detect_coverage==b.detect_coverage && a.sens_coverage==b.sens_coverage && a.fault_detail_map.size()==b.fault_detail_map.size(), "simulate(mt, prepared) matches legacy");
+    // 行為類別：成員與代表的模擬輸入相同，代表是編號最小的成員
+    bool cls_ok = prep.class_count()>0 && prep.class_count()<=tps.size();
+    for (TpGid t=0;t<tps.size();++t){
+        TpGid r = prep.class_rep(prep.class_of_tp(t));
+        cls_ok = cls_ok && r<=t && encode_to_key(tps[r].state)==encode_to_key(tps[t].state)
+              && prep.sens_automaton().seq_of_tp(r)==prep.sens_automaton().seq_of_tp(t)
+              && encode_op(tps[r].detector.detectOp)==encode_op(tps[t].detector.detectOp) && tps[r].detector.pos==tps[t].detector.pos
+              && tps[r].F_has_value==tps[t].F_has_value && tps[r].R_has_value==tps[t].R_has_value;
+    }
+    CHECK(cls_ok, "behaviour classes group TPs with identical simulation inputs");
+}
+
+static void test_FaultGroupInterning(){
+    cout << "[Class] FaultIdx/GroupIdx interning\n";
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    bool idx_ok = true;
+    for (size_t i=0;i<faults.size();++i) idx_ok = idx_ok && faults[i].fault_idx==(FaultIdx)i;
+    CHECK(idx_ok, "FaultNormalizer assigns dense fault_idx");
+    bool tp_ok = true;
+    for (const auto& tp : tps) tp_ok = tp_ok && faults[tp.parent_fault_idx].fault_id==tp.parent_fault_id && tp.group_idx==make_group_idx(tp.parent_fault_idx, tp.group);
+    CHECK(tp_ok, "TPGenerator copies fault_idx and group_idx");
+    // 去掉整數索引後應退回字串路徑，結果相同
+    auto plain = tps; for (auto& tp : plain){ tp.parent_fault_idx = -1; tp.group_idx = -1; }
+    vector<GroupId> a, b;
+    CHECK(assign_dense_groups(tps, a)==assign_dense_groups(plain, b) && a==b, "dense groups match string fallback");
+    FaultSimulator sim; auto mt = mk_simple_march();
+    auto r1 = sim.simulate(mt, faults, tps); auto r2 = sim.simulate(mt, faults, plain);
+    CHECK(r1.fault_detail_map.at(faults[0].fault_id).state_tp_gids==r2.fault_detail_map.at(faults[0].fault_id).state_tp_gids && r1.detect_coverage==r2.detect_coverage, "reporter result independent of interning");
+}
+
+static void test_SimulationMode(){
+    cout << "[Class] SimulationMode::Summary\n";
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    PreparedFaultSet prep(faults, tps);
+    FaultSimulator sim; auto mt = mk_simple_march();
+    auto full = sim.simulate(mt, prep);
+    auto sum = sim.simulate(mt, prep, SimulationMode::Summary);
+    CHECK(sum.state_coverage==full.state_coverage && sum.sens_coverage==full.sens_coverage &&
+          sum.detect_coverage==full.detect_coverage && sum.total_coverage==full.total_coverage, "summary coverages equal full");
+    CHECK(sum.cover_lists.empty() && sum.op_table.empty() && sum.fault_detail_map.empty(), "summary allocates no per-op lists or detail map");
+}
+
+static void test_SimulationWorkspace(){
+    cout << "[Class] FaultSimulator::simulate into reused result\n";
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    PreparedFaultSet prep(faults, tps);
+    FaultSimulator sim, fresh;
+    IncrementalSimulator inc(prep);
+    const char* pats[] = {"b(W0);a(R0,W1,C(0)(1)(0));d(R1,W0,C(1)(1)(1),R0);a(R0,W1);d(R1,W0);b(R0)", "b(W1);a(R1,W0)", "", "b(W0);a(R0,W1);d(R1,W0);b(R0)"};
+    auto same_result = [](const SimulationResult& a, const SimulationResult& b){
+        bool ok = a.total_coverage==b.total_coverage && a.state_coverage==b.state_coverage && a.sens_coverage==b.sens_coverage &&
+                  a.op_table.size()==b.op_table.size() && a.cover_lists.size()==b.cover_lists.size() && a.fault_detail_map.size()==b.fault_detail_map.size();
+        for (size_t i=0; ok && i<a.cover_lists.size(); ++i)
+            ok = a.cover_lists[i].state_cover==b.cover_lists[i].state_cover && a.cover_lists[i].sens_cover==b.cover_lists[i].sens_cover &&
+                 a.cover_lists[i].det_cover==b.cover_lists[i].det_cover && a.cover_lists[i].masked.size()==b.cover_lists[i].masked.size();
+        for (const auto& kv : a.fault_detail_map){
+            if (!ok) break;
+            auto it = b.fault_detail_map.find(kv.first);
+            ok = it!=b.fault_detail_map.end() && it->second.detect_coverage==kv.second.detect_coverage &&
+                 it->second.state_tp_gids==kv.second.state_tp_gids && it->second.detect_tp_gids==kv.second.detect_tp_gids;
+        }
+        return ok;
+    };
+    SimulationResult ws, ws_inc; bool same = true;
+    for (int r=0; r<2; ++r) for (const char* p : pats){
+        MarchTest mt = *p ? MarchTestNormalizer().normalize(RawMarchTest{"WS", p}) : MarchTest{};
+        sim.simulate(mt, prep, ws);
+        inc.assign(mt); inc.result(ws_inc);
+        auto ref = fresh.simulate(mt, prep);
+        same = same && same_result(ws, ref) && same_result(ws_inc, ref);
+    }
+    CHECK(same, "reused result equals fresh simulate (longer / shorter / empty tests)");
+    MarchTest mt = MarchTestNormalizer().normalize(RawMarchTest{"WS", pats[0]});
+    sim.simulate(mt, prep, ws);
+    const void* lists = ws.cover_lists.data();
+    const void* gids = ws.fault_detail_map.begin()->second.state_tp_gids.data();
+    sim.simulate(mt, prep, ws);
+    CHECK(ws.cover_lists.data()==lists && ws.fault_detail_map.begin()->second.state_tp_gids.data()==gids, "buffers kept across calls");
+}
+
+static void test_BitParallelSimulator(){
+    cout << "[Class] BitParallelSimulator\n";
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    PreparedFaultSet prep(faults, tps);
+    // 70 個候選（跨兩批）：共用前綴，最後一個 element 不同；含空 March test
+    const char* tails[] = {"a(R0,W1)", "d(R1,W0,R0)", "b(C(0)(1)(0),R0)", "a(W1,C(1)(1)(1),R1)", "d(R0)", "b(W0,W1,R1,C(0)(0)(1))", "a(C(1)(0)(1))"};
+    vector<MarchTest> mts;
+    for (int i=0;i<70;++i){
+        string text = string("b(W0);a(R0,W1);") + tails[i%7] + (i%3==0 ? ";d(R1,W0)" : "");
+        mts.push_back(i==5 ? MarchTest{} : MarchTestNormalizer().normalize(RawMarchTest{"BP"+std::to_string(i), text}));
+    }
+    BitParallelSimulator bp(prep); FaultSimulator sim;
+    auto got = bp.simulate(mts);
+    bool same = got.size()==mts.size();
+    for (size_t i=0; same && i<mts.size(); ++i){
+        auto ref = sim.simulate_summary(mts[i], prep);
+        same = ref.state_coverage==got[i].state_coverage && ref.sens_coverage==got[i].sens_coverage &&
+               ref.detect_coverage==got[i].detect_coverage && ref.total_coverage==got[i].total_coverage;
+    }
+    CHECK(same, "64-lane batch coverages equal simulate_summary per test");
+}
+
+static void test_TpDominance(){
+    cout << "[Class] PreparedFaultSet dominance\n";
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    // 把含 X 的 state 第一個 X 固定成 0，做出同群組、較特定的 TP
+    size_t n0 = tps.size();
+    for (size_t t=0;t<n0;++t){
+        size_t key = encode_to_key(tps[t].state), p = 1, k = key;
+        while (k && k%3!=2) { k/=3; p*=3; }
+        if (k%3!=2) continue;
+        TestPrimitive cp = tps[t]; cp.state = decode_from_key(key - 2*p); tps.push_back(cp);
+    }
+    PreparedFaultSet prep(faults, tps);
+    bool map_ok = prep.dominated_class_count()>0;
+    for (TpGid t=n0;t<tps.size();++t){ auto d = prep.dominator_of(t); map_ok = map_ok && d && prep.group_of_tp(*d)==prep.group_of_tp(t); }
+    for (TpGid t=0;t<n0;++t) map_ok = map_ok && (!prep.dominator_of(t) || prep.group_of_tp(*prep.dominator_of(t))==prep.group_of_tp(t));
+    CHECK(map_ok, "specialized copies are dominated by a TP in the same group");
+    FaultSimulator sim; bool same = true;
+    for (auto mt : {mk_simple_march(), MarchTestNormalizer().normalize(RawMarchTest{"UT2","b(W0);a(R0,W1,C(0)(1)(0));d(R1,W0,C(1)(1)(1),R0);b(R0)"})}){
+        auto full = sim.simulate(mt, prep); auto sum = sim.simulate(mt, prep, SimulationMode::Summary);
+        same = same && sum.state_coverage==full.state_coverage && sum.sens_coverage==full.sens_coverage && sum.detect_coverage==full.detect_coverage;
+    }
+    CHECK(same, "pruning dominated classes keeps summary coverages equal to full");
+}
+
+static void test_ParallelSimulate(){
+    cout << "[Class] FaultSimulator with ThreadPool\n";
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    PreparedFaultSet prep(faults, tps);
+    ThreadPool pool(2);
+    FaultSimulator ser, par; par.set_thread_pool(&pool, 1);
+    FaultSimulatorEvent eser, epar; epar.set_thread_pool(&pool);
+    auto mt = MarchTestNormalizer().normalize(RawMarchTest{"UT3","b(W0);a(R0,W1,C(0)(1)(0));d(R1,W0,C(1)(1)(1),R0);a(R0,W1);d(R1,W0);b(R0)"});
+    auto a = ser.simulate(mt, prep), b = par.simulate(mt, prep);
+    bool same = a.cover_lists.size()==b.cover_lists.size() && a.detect_coverage==b.detect_coverage && a.total_coverage==b.total_coverage;
+    for (size_t i=0; same && i<a.cover_lists.size(); ++i){
+        const auto& x = a.cover_lists[i]; const auto& y = b.cover_lists[i];
+        same = x.state_cover==y.state_cover && x.sens_cover==y.sens_cover && x.det_cover==y.det_cover && x.masked.size()==y.masked.size();
+        for (size_t k=0; same && k<x.masked.size(); ++k) same = x.masked[k].tp_gid==y.masked[k].tp_gid && x.masked[k].status==y.masked[k].status;
+    }
+    CHECK(same, "op-parallel simulate equals serial (cover lists in same order)");
+    auto ea = eser.simulate(mt, faults, tps), eb = epar.simulate(mt, faults, tps);
+    CHECK(ea.events.events().size()==eb.events.events().size() && ea.events.detectDone()==eb.events.detectDone() && ea.events.sensMasked()==eb.events.sensMasked(), "event simulator ids identical with pool");
+}
+
+static void test_OrderedBatch(){
+    cout << "[Class] ThreadPool::ordered_map batch\n";
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    PreparedFaultSet prep(faults, tps);
+    const char* pats[] = {"b(W0);a(R0,W1);d(R1,W0);b(R0)", "b(W1);a(R1,W0,R0);d(R0,W1,R1)",
+                          "b(W0);a(R0,W1,C(0)(1)(0));d(R1,W0,C(1)(1)(1),R0);a(R0,W1);d(R1,W0);b(R0)", "b(W0);b(R0)"};
+    vector<MarchTest> mts;
+    for (int r=0; r<6; ++r) for (const char* p : pats) mts.push_back(MarchTestNormalizer().normalize(RawMarchTest{"B"+std::to_string(mts.size()), p}));
+    ThreadPool pool(3);
+    vector<FaultSimulator> sims(pool.concurrency());
+    FaultSimulator ser;
+    vector<size_t> order; bool same = true;
+    pool.ordered_map(mts.size(), [&](size_t i, size_t w){ return sims[w].simulate(mts[i], prep).total_coverage; },
+        [&](size_t i, double cov){ order.push_back(i); same = same && cov==ser.simulate(mts[i], prep).total_coverage; }, 2);
+    bool in_order = order.size()==mts.size();
+    for (size_t i=0; in_order && i<order.size(); ++i) in_order = order[i]==i;
+    CHECK(in_order && same, "results delivered in input order and equal to serial");
+    bool thrown = false;
+    try { pool.ordered_map(8, [](size_t i, size_t){ if (i==5) throw std::runtime_error("x"); return i; }, [](size_t, size_t){}); }
+    catch (const std::runtime_error&) { thrown = true; }
+    CHECK(thrown, "worker exception rethrown to caller");
+
+    // 巢狀：fn 內再用同一個 pool。唯一的 worker 被佔住時，ordered_map 的 worker 迴圈只會在
+    // 呼叫端 parallel_for 的 wait() 裡被執行，不能在那裡等 sink
+    ThreadPool one(1);
+    std::promise<void> release; std::atomic<bool> started{false};
+    auto busy = one.submit([&started, f = release.get_future()]{ started = true; f.wait(); });
+    while (!started) std::this_thread::yield();
+    size_t sum = 0;
+    one.ordered_map(16, [&](size_t i, size_t){
+            std::atomic<size_t> s{0};
+            one.parallel_for(4, 4, [&](size_t b, size_t e, size_t){ for (size_t k=b; k<e; ++k) s += i*k; });
+            return s.load(); },
+        [&](size_t, size_t v){ sum += v; }, 1);
+    release.set_value(); busy.get();
+    CHECK(sum==720, "nested parallel_for inside ordered_map with a busy worker finishes");
+    // op 層級的 pool 與測試層級的 ordered_map 共用同一個 pool
+    vector<FaultSimulator> psims(pool.concurrency());
+    for (auto& s : psims) s.set_thread_pool(&pool, 1);
+    same = true;
+    pool.ordered_map(mts.size(), [&](size_t i, size_t w){ return psims[w].simulate(mts[i], prep).total_coverage; },
+        [&](size_t i, double cov){ same = same && cov==ser.simulate(mts[i], prep).total_coverage; }, 1);
+    CHECK(same, "op-parallel simulators sharing the ordered_map pool equal serial");
+}
+
+static void test_IncrementalSimulator(){
+    cout << "[Class] IncrementalSimulator\n";
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    FaultSimulator sim; IncrementalSimulator inc(faults, tps);
+    MarchTest mt = mk_simple_march();
+    inc.assign(mt);
+    auto full = sim.simulate(mt, faults, tps);
+    auto s = inc.summary();
+    CHECK(s.detect_coverage==full.detect_coverage && s.state_coverage==full.state_coverage, "assign matches full simulate");
+    // 加在最後一個 element 會改變其哨兵 → 之前 op 的 pre_state 也要跟著變
+    Op w; w.kind=OpKind::Write; w.value=Val::One;
+    auto d = inc.append_op(w);
+    mt.elements.back().ops.push_back(w);
+    full = sim.simulate(mt, faults, tps);
+    CHECK(d.after.sens_coverage==full.sens_coverage && d.after.detect_coverage==full.detect_coverage, "append_op matches full simulate");
+    CHECK(d.first_changed_op==(OpId)mt.elements[0].ops.size(), "only last element is recomputed");
+    bool same_states = true;
+    for (size_t i=0;i<full.op_table.size();++i) same_states = same_states && inc.op_table()[i].pre_state_key==full.op_table[i].pre_state_key;
+    CHECK(same_states, "pre_state keys follow new sentinel");
+    // 新 element 讓前綴的 ; 錨點與往後掃描有機會完成
+    MarchElement e; e.order=AddrOrder::Up; Op r; r.kind=OpKind::Read; r.value=Val::One; e.ops={r};
+    inc.append_element(e); mt.elements.push_back(e);
+    full = sim.simulate(mt, faults, tps);
+    CHECK(inc.summary().detect_coverage==full.detect_coverage, "append_element resolves pending detections");
+    CHECK(inc.result().cover_lists.size()==full.cover_lists.size(), "materialized result has all ops");
+    inc.pop_element(); inc.pop_op();
+    CHECK(inc.summary().detect_coverage==sim.simulate(mk_simple_march(), faults, tps).detect_coverage, "pop restores prefix");
+}
+
+static void test_FaultDropping(){
+    cout << "[Class] IncrementalSimulator fault dropping\n";
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    PreparedFaultSet prep(faults, tps);
+    IncrementalSimulator ref(prep), drop(prep); drop.set_fault_dropping(true);
+    auto mt = MarchTestNormalizer().normalize(RawMarchTest{"FD","b(W0);a(R0,W1,C(0)(1)(0));d(R1,W0,C(1)(1)(1),R0);a(R0,W1);d(R1,W0)"});
+    ref.assign(mt); drop.assign(mt);
+    auto same = [](CoverageSummary a, CoverageSummary b){ return a.state_coverage==b.state_coverage && a.sens_coverage==b.sens_coverage && a.detect_coverage==b.detect_coverage; };
+    bool ok = same(ref.summary(), drop.summary());
+    const char* ops[] = {"R0","W1","R1","C(1)(0)(1)","W0"};
+    for (const char* o : ops){
+        auto e = MarchTestNormalizer().normalize(RawMarchTest{"e", string("a(") + o + ")"}).elements[0];
+        ok = ok && same(ref.append_op(e.ops[0]).after, drop.append_op(e.ops[0]).after);
+        ref.pop_op(); drop.pop_op();
+        ok = ok && same(ref.summary(), drop.summary());
+    }
+    CHECK(ok, "coverages equal with and without dropping across append / pop");
+    size_t ref_n = 0, drop_n = 0;
+    for (const auto& l : ref.cover_lists()) ref_n += l.state_cover.size();
+    for (const auto& l : drop.cover_lists()) drop_n += l.state_cover.size();
+    CHECK(drop_n < ref_n, "detected groups are skipped in later ops");
+}
+
+static void test_ArrayFaultSimulator(){
+    cout << "[Class] ArrayFaultSimulator\n";
+    auto faults = load_faults("input/S_faults.json"); auto tps = gen_tps(faults);
+    PreparedFaultSet prep(faults, tps);
+    auto norm = [](const char* text){ return MarchTestNormalizer().normalize(RawMarchTest{"AF", text}); };
+    ArrayFaultSimulator arr(faults, ArrayGeometry{4, 70}); // 70 欄：跨 64-bit word 邊界
+    auto mc = arr.simulate(norm("b(W0);a(R0,W1);a(R1,W0);d(R0,W1);d(R1,W0);b(R0)"));
+    auto ref = FaultSimulator().simulate(norm("b(W0);a(R0,W1);a(R1,W0);d(R0,W1);d(R1,W0);b(R0)"), prep);
+    bool same = mc.total_coverage==1.0;
+    for (size_t i=0;i<faults.size();++i) same = same && mc.fault_coverage[i]>=ref.fault_detail_map.at(faults[i].fault_id).detect_coverage;
+    CHECK(same, "March C- detects every classic fault at every position (never below the TP model)");
+    bool pos_ok = true;
+    for (const auto& l : mc.lanes){
+        size_t expect = l.placement==ArrayPlacement::Single ? 4*70 : l.placement==ArrayPlacement::SameRow ? 4*69 : 3*70;
+        pos_ok = pos_ok && l.positions==expect;
+    }
+    CHECK(pos_ok, "positions exclude victims whose aggressor falls off the array");
+    // MATS+：最後沒有讀 0，TFd 測不到
+    auto mats = arr.simulate(norm("b(W0);a(R0,W1);d(R1,W0)"));
+    CHECK(mats.fault_coverage[0]==1.0 && mats.fault_coverage[2]==1.0 && mats.fault_coverage[3]==0.0, "MATS+ misses TFd only among single-cell faults");
+    ThreadPool pool; arr.set_thread_pool(&pool);
+    auto par = arr.simulate(norm("b(W0);a(R0,W1);d(R1,W0)"));
+    bool par_ok = par.total_coverage==mats.total_coverage;
+    for (size_t i=0;i<par.lanes.size();++i) par_ok = par_ok && par.lanes[i].detected==mats.lanes[i].detected;
+    CHECK(par_ok, "thread pool result equals serial");
+
+    // Ci / compute 路徑：手推的預期值（3 列，跨列 aggressor 只有兩列的 victim 放得下）
+    auto sim1 = [&](const char* cat, const char* scope, const char* fp, const char* text){
+        vector<Fault> fs{FaultNormalizer().normalize(RawFault{"UT", cat, scope, {fp}})};
+        return ArrayFaultSimulator(fs, ArrayGeometry{3, 5}).simulate(norm(text));
+    };
+    auto cov = [&](const char* cat, const char* scope, const char* fp, const char* text){ return sim1(cat, scope, fp, text).total_coverage; };
+    // 0Co 只有在 fault-free 輸出為 1（D = 1）時看得到
+    CHECK(cov("must_compute", "single cell", "< AND1Ci/-/-/0Co >", "b(W0);b(C(0)(1)(0))")==0.0 &&
+          cov("must_compute", "single cell", "< AND1Ci/-/-/0Co >", "b(W1);b(C(0)(1)(0))")==1.0, "compute fault seen only when fault-free output differs");
+    // 同一個 state fault：只有 compute 看得到時，must_read 不算偵測
+    CHECK(cov("either_read_or_compute", "single cell", "< 1Ci0D/1D/-/- >", "b(W0);b(C(0)(1)(0))")==1.0 &&
+          cov("must_read", "single cell", "< 1Ci0D/1D/-/- >", "b(W0);b(C(0)(1)(0))")==0.0, "fault category selects the observing output");
+    // compute 的 T / B 把 aggressor 列的 Ci 拉成 0，fault 在同一個 AND 就看得到（含第一列之後的第一格）
+    CHECK(cov("either_read_or_compute", "two cell cross row", "< 0Ci; 0D/1D/-/- >", "b(W0);b(C(0)(1)(0))")==1.0, "Ci driven before the AND");
+    // 別列的 compute 在兩次 visit 之間改 aggressor 列的 Ci：下次 visit 前補算。
+    // C(0)(0)(1) 由上上一列把 aggressor 列拉成 1，所以 aggressor 在第 0 列（victim 在第 1 列）時初值 0 測不到
+    auto third = sim1("must_read", "two cell cross row", "< 1Ci; 0D/1D/-/- >", "b(W0);a(C(0)(0)(1));b(R0)");
+    CHECK(third.lanes.size()==2 && third.lanes[0].group==OrientationGroup::A_LT_V && third.lanes[0].detected==5 &&
+          third.lanes[1].detected==10, "Ci changed by other rows between visits");
+    // 兩列都要 Ci = 1：C(0)(1)(0) 讓兩列在 visit 之間輪流為 1 但從不同時（初值 0 時不成立），C(1)(1)(1) 同時拉高
+    auto apart = sim1("must_read", "two cell cross row", "< 1Ci; 1Ci0D/1D/-/- >", "b(W0);d(C(0)(1)(0));b(R0)");
+    bool none = true;
+    for (const auto& l : apart.lanes) none = none && l.detected==0;
+    CHECK(none && cov("must_read", "two cell cross row", "< 1Ci; 1Ci0D/1D/-/- >", "b(W0);a(C(1)(1)(1));b(R0)")==1.0, "cross-row Ci conditions must hold at the same time");
+}
+
+static void test_FaultTpCache(){
+    cout << "[Class] FaultTpCache\n";
+    const string dir = (std::filesystem::temp_directory_path() / ("fault_tp_cache_ut_" + std::to_string(::getpid()))).string();
+    std::filesystem::remove_all(dir);
+    auto ref = build_fault_tp_set("input/S_C_faults.json");
+    auto first = load_fault_tp_set("input/S_C_faults.json", dir);  // miss：建好並寫入
+    auto second = load_fault_tp_set("input/S_C_faults.json", dir); // hit：由 mmap 還原
+    size_t files = 0; string file;
+    for (const auto& e : std::filesystem::directory_iterator(dir)) { ++files; file = e.path().string(); }
+    CHECK(files==1 && MappedFaultTpCache(file).valid() && MappedFaultTpCache(file).tp_count()==ref.tps.size(), "one cache file written and mappable");
+    auto same_op = [](const Op& a, const Op& b){ return encode_op(a)==encode_op(b); };
+    auto same_ops = [&](const vector<Op>& a, const vector<Op>& b){
+        if (a.size()!=b.size()) return false;
+        for (size_t i=0;i<a.size();++i) if (!same_op(a[i], b[i])) return false;
+        return true;
+    };
+    auto same_state = [](const CrossState& a, const CrossState& b){
+        const DC* x[5] = {&a.A0, &a.A1, &a.A2_CAS, &a.A3, &a.A4}; const DC* y[5] = {&b.A0, &b.A1, &b.A2_CAS, &b.A3, &b.A4};
+        for (int i=0;i<5;++i) if (x[i]->D!=y[i]->D || x[i]->C!=y[i]->C) return false;
+        return true;
+    };
+    bool same = second.faults.size()==ref.faults.size() && second.tps.size()==ref.tps.size();
+    for (size_t i=0; same && i<ref.faults.size(); ++i){
+        const Fault& a = ref.faults[i]; const Fault& b = second.faults[i];
+        same = a.fault_id==b.fault_id && a.fault_idx==b.fault_idx && a.category==b.category && a.cell_scope==b.cell_scope && a.primitives.size()==b.primitives.size();
+        for (size_t k=0; same && k<a.primitives.size(); ++k){
+            const FPExpr& x = a.primitives[k]; const FPExpr& y = b.primitives[k];
+            same = x.Sa.has_value()==y.Sa.has_value() && (!x.Sa || (x.Sa->pre_D==y.Sa->pre_D && x.Sa->Ci==y.Sa->Ci && same_ops(x.Sa->ops, y.Sa->ops))) &&
+                   x.Sv.pre_D==y.Sv.pre_D && x.Sv.Ci==y.Sv.Ci && x.Sv.last_D==y.Sv.last_D && same_ops(x.Sv.ops, y.Sv.ops) &&
+                   x.F.FD==y.F.FD && x.R.RD==y.R.RD && x.C.Co==y.C.Co && x.s_has_any_op==y.s_has_any_op;
+        }
+    }
+    for (size_t i=0; same && i<ref.tps.size(); ++i){
+        const TestPrimitive& a = ref.tps[i]; const TestPrimitive& b = second.tps[i];
+        same = a.parent_fault_id==b.parent_fault_id && a.parent_fp_index==b.parent_fp_index && a.parent_fault_idx==b.parent_fault_idx &&
+               a.group_idx==b.group_idx && a.group==b.group && same_state(a.state, b.state) && same_ops(a.ops_before_detect, b.ops_before_detect) &&
+               same_op(a.detector.detectOp, b.detector.detectOp) && a.detector.pos==b.detector.pos && a.detector.order==b.detector.order &&
+               a.detector.has_set_Ci==b.detector.has_set_Ci && a.F_has_value==b.F_has_value && a.R_has_value==b.R_has_value && a.C_has_value==b.C_has_value;
+    }
+    CHECK(same && first.tps.size()==ref.tps.size(), "cached faults / TPs equal freshly generated ones");
+    {
+        ThreadPool pool(3);
+        auto par = build_fault_tp_set("input/S_C_faults.json", &pool, 3); // 小 batch，讓多個 worker 交錯完成
+        auto serial = load_faults("input/S_C_faults.json"); auto serial_tps = gen_tps(serial);
+        bool ordered = par.faults.size()==serial.size() && par.tps.size()==serial_tps.size();
+        for (size_t i=0; ordered && i<serial.size(); ++i) ordered = par.faults[i].fault_id==serial[i].fault_id && par.faults[i].fault_idx==serial[i].fault_idx;
+        for (size_t i=0; ordered && i<serial_tps.size(); ++i) ordered = par.tps[i].parent_fault_id==serial_tps[i].parent_fault_id && par.tps[i].group_idx==serial_tps[i].group_idx;
+        CHECK(ordered, "parallel build keeps serial fault / TP order and indices");
+    }
+    { std::ofstream(file, std::ios::binary | std::ios::trunc) << "garbage"; }
+    auto rebuilt = load_fault_tp_set("input/S_C_faults.json", dir);
+    CHECK(rebuilt.tps.size()==ref.tps.size() && MappedFaultTpCache(file).valid(), "corrupt cache is rebuilt");
+    std::filesystem::remove_all(dir);
+}
+
+static void test_PrefixTrieBatch(){
+    cout << "[Class] MarchPrefixTrie / simulate_batch\n";
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    PreparedFaultSet prep(faults, tps);
+    auto norm = [](const char* text){ return MarchTestNormalizer().normalize(RawMarchTest{"PT", text}); };
+    vector<MarchTest> mts = {
+        norm("b(W0);a(R0,W1);d(R1,W0)"), norm("b(W0);a(R0,W1);d(R1,W0,R0)"), norm("b(W0);a(R0,W1)"),
+        norm("b(W0);a(R0,W1,C(0)(1)(0));b(R1)"), norm("b(W0);d(R0,W1);a(R1,W0);b(R0)"), norm("b(W1);a(R1)")};
+    MarchPrefixTrie trie; vector<MarchPrefixTrie::NodeId> ids;
+    for (const auto& mt : mts) ids.push_back(trie.insert(mt));
+    CHECK(trie.insert(mts[0])==ids[0] && trie.parent(ids[2])==MarchPrefixTrie::ROOT+1, "insert merges shared prefixes");
+    FaultSimulator sim; PrefixSummarySimulator ps(prep); vector<CoverageSummary> out;
+    ps.simulate_batch(trie, out);
+    bool same = ps.march_test().elements.empty();
+    for (size_t i=0;i<mts.size();++i){
+        auto ref = sim.simulate_summary(mts[i], prep);
+        same = same && out[ids[i]].state_coverage==ref.state_coverage && out[ids[i]].sens_coverage==ref.sens_coverage && out[ids[i]].detect_coverage==ref.detect_coverage;
+    }
+    CHECK(same, "PrefixSummarySimulator batch equals simulate_summary per path");
+    IncrementalSimulator inc(prep); bool full_same = true;
+    inc.simulate_batch(trie, [&](MarchPrefixTrie::NodeId n, const IncrementalSimulator& s){
+        for (size_t i=0;i<mts.size();++i) if (ids[i]==n){
+            auto a = s.result(); auto b = sim.simulate(mts[i], prep);
+            full_same = full_same && a.detect_coverage==b.detect_coverage && a.cover_lists.size()==b.cover_lists.size() && a.op_table.back().head_next==b.op_table.back().head_next;
+        }
+    });
+    CHECK(full_same && inc.march_test().elements.empty(), "IncrementalSimulator batch equals simulate and returns to the root");
+}
+
+static void test_BeamParallelRun(){
+    cout << "[Class] BeamTemplateSearcher::run / run_stream with ThreadPool\n";
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    using namespace css::template_search;
+    auto lib = TemplateLibrary::make_bruce(2);
+    SequenceConstraintSet cs; cs.add(std::make_shared<FirstElementWriteOnlyConstraint>());
+    auto run = [&](ThreadPool* pool, bool stream){
+        FaultSimulator sim; BeamTemplateSearcher b(sim, lib, faults, tps, 4, std::make_unique<ValueExpandingGenerator>(), default_score_func, &cs);
+        b.set_thread_pool(pool); return stream ? b.run_stream(3, 16) : b.run(3, 4);
+    };
+    ThreadPool pool(3);
+    auto same_results = [](const vector<CandidateResult>& a, const vector<CandidateResult>& b){
+        bool same = !a.empty() && a.size()==b.size();
+        for (size_t i=0; same && i<a.size(); ++i) same = a[i].score==b[i].score && a[i].sequence==b[i].sequence && a[i].march_test.elements.size()==b[i].march_test.elements.size();
+        for (size_t i=0; same && i<a.size(); ++i) for (size_t e=0; same && e<a[i].march_test.elements.size(); ++e){
+            const auto& x = a[i].march_test.elements[e].ops; const auto& y = b[i].march_test.elements[e].ops;
+            same = x.size()==y.size();
+            for (size_t k=0; same && k<x.size(); ++k) same = encode_op(x[k])==encode_op(y[k]);
+        }
+        return same;
+    };
+    auto serial = run(nullptr, false), par = run(&pool, false);
+    CHECK(same_results(serial, par), "parallel beam run returns the serial result");
+    CHECK(same_results(run(nullptr, true), run(&pool, true)), "parallel run_stream returns the serial result");
+    bool sorted = true;
+    for (size_t i=0; i<serial.size(); ++i) sorted = sorted && serial[i].score==serial[i].sim_result.total_coverage && (i==0 || serial[i-1].score>=serial[i].score);
+    CHECK(sorted, "beam results are best first and scored from their simulation");
+}
+
+static void test_TranspositionTable(){
+    cout << "[Class] MarchTestHash + searcher transposition tables\n";
+    MarchTest a, b;
+    MarchPatternParser::parse("a(W0); a(R0,W1,C(1)(0)(1),R1,W0,R0,W1,R1,W0); d(R1)", a);
+    MarchPatternParser::parse("a(W0);a(R0, W1, C(1)(0)(1), R1, W0, R0, W1, R1, W0); d(R1)", b);
+    a.name = "x"; b.name = "y";
+    CHECK(hash_march_test(a)==hash_march_test(b), "hash ignores the name and pattern spelling");
+    MarchTestHasher inc; for (const auto& e : a.elements) inc.add(e);
+    CHECK(inc.digest()==hash_march_test(a), "incremental hash matches the whole-test hash");
+    MarchTest c = b; c.elements[2].order = AddrOrder::Up;
+    MarchTest d = b; d.elements[1].ops[8].value = Val::One;
+    MarchTest e = b; e.elements.push_back(MarchElement{});
+    CHECK(hash_march_test(c)!=hash_march_test(a) && hash_march_test(d)!=hash_march_test(a) && hash_march_test(e)!=hash_march_test(a), "order, op and element count change the hash");
+
+    // t1 只是 t0 多一個 None slot：兩者展開出相同的 element
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    using namespace css::template_search;
+    using K = TemplateOpKind;
+    TemplateLibrary lib, lib_no_dup;
+    for (auto* l : {&lib, &lib_no_dup}) {
+        l->push_back(ElementTemplate(AddrOrder::Up, {K::Write}));
+        if (l == &lib) l->push_back(ElementTemplate(AddrOrder::Up, {K::None, K::Write}));
+        l->push_back(ElementTemplate(AddrOrder::Down, {K::Read, K::Write}));
+    }
+    FaultSimulator sim;
+    GreedyTemplateSearcher g(sim, lib, faults, tps), g_no_dup(sim, lib_no_dup, faults, tps);
+    auto gr = g.run(3), gr_no_dup = g_no_dup.run(3);
+    bool first_wins = true; for (auto t : gr.sequence) first_wins = first_wins && t != 1;
+    CHECK(gr.score==gr_no_dup.score && first_wins, "greedy skips repeated trials without changing the pick");
+
+    BeamTemplateSearcher beam(sim, lib, faults, tps, 6);
+    ThreadPool pool(2);
+    BeamTemplateSearcher beam_par(sim, lib, faults, tps, 6); beam_par.set_thread_pool(&pool);
+    auto br = beam.run(2, 6), bp = beam_par.run(2, 6);
+    bool has_dup = false, consistent = true;
+    for (size_t i=0; i<br.size(); ++i) {
+        consistent = consistent && br[i].score==br[i].sim_result.total_coverage && i<bp.size() && bp[i].sequence==br[i].sequence && bp[i].score==br[i].score;
+        for (size_t j=0; j<i; ++j) has_dup = has_dup || (br[j].sequence!=br[i].sequence && hash_march_test(br[j].march_test)==hash_march_test(br[i].march_test));
+    }
+    CHECK(has_dup && consistent, "beam keeps converging paths and reuses their scores");
+}
+
+static void test_VariantPool(){
+    cout << "[Class] VariantPool\n";
+    using namespace css::template_search;
+    using K = TemplateOpKind;
+    TemplateLibrary lib;
+    lib.push_back(ElementTemplate(AddrOrder::Up, {K::Read, K::Compute}));
+    lib.push_back(ElementTemplate(AddrOrder::Up, {K::None, K::Read, K::Compute})); // 與 t0 展開相同
+    lib.push_back(ElementTemplate(AddrOrder::Down, {K::None}));
+    ValueExpandingGenerator gen;
+    VariantPool pool(lib, gen);
+    bool same = pool.template_count()==lib.size();
+    size_t total = 0;
+    for (size_t tid=0; same && tid<lib.size(); ++tid) {
+        auto elems = gen.generate(lib, tid);
+        same = elems.size()==pool.end(tid)-pool.begin(tid);
+        for (size_t k=0; same && k<elems.size(); ++k) {
+            MarchElement e = pool.element(pool.id(pool.begin(tid)+k));
+            same = e.order==elems[k].order && e.ops.size()==elems[k].ops.size();
+            for (size_t j=0; same && j<e.ops.size(); ++j) same = encode_op(e.ops[j])==encode_op(elems[k].ops[j]);
+        }
+        total += elems.size();
+    }
+    CHECK(same, "generator pool decodes to generate() in order");
+    CHECK(total==33 && pool.distinct()==17 && pool.id(pool.begin(0))==pool.id(pool.begin(1)), "repeated elements share one VariantId");
+
+    VariantPool dfs = VariantPool::slot_dfs(lib, 4);
+    MarchElement e1 = dfs.element(dfs.id(dfs.begin(0)+1)), e3 = dfs.element(dfs.id(dfs.begin(0)+3));
+    CHECK(dfs.end(0)-dfs.begin(0)==4 && dfs.leaves(0)==16 && dfs.op_count(dfs.id(dfs.begin(2)))==0
+          && e1.ops[0].value==Val::Zero && e1.ops[1].C_T==Val::One && e1.ops[1].C_M==Val::Zero
+          && e3.ops[1].C_T==Val::One && e3.ops[1].C_M==Val::One, "slot_dfs keeps the first cap combinations, last slot fastest");
+    CHECK(dfs.covers(4) && !dfs.covers(5) && VariantPool::slot_dfs(lib).covers(100) && !pool.covers(1), "covers() tells whether run_stream can reuse the pool");
+
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    auto bruce = TemplateLibrary::make_bruce(2);
+    VariantPool shared(bruce, gen), shared_dfs = VariantPool::slot_dfs(bruce, 16);
+    FaultSimulator sim;
+    GreedyTemplateSearcher g_own(sim, bruce, faults, tps), g_shared(sim, bruce, faults, tps);
+    g_shared.set_variant_pool(&shared);
+    BeamTemplateSearcher b_own(sim, bruce, faults, tps, 4), b_shared(sim, bruce, faults, tps, 4);
+    b_shared.set_variant_pool(&shared); b_shared.set_variant_pool(&shared_dfs);
+    auto ga = g_own.run(3), gb = g_shared.run(3);
+    auto ra = b_own.run(2, 4), rb = b_shared.run(2, 4), sa = b_own.run_stream(2, 16), sb = b_shared.run_stream(2, 16);
+    bool eq = ga.score==gb.score && ga.sequence==gb.sequence && ra.size()==rb.size() && sa.size()==sb.size();
+    for (size_t i=0; eq && i<ra.size(); ++i) eq = ra[i].score==rb[i].score && ra[i].sequence==rb[i].sequence;
+    for (size_t i=0; eq && i<sa.size(); ++i) eq = sa[i].score==sb[i].score && sa[i].sequence==sb[i].sequence;
+    CHECK(eq, "searchers give the same result with a shared pool");
+    bool threw = false;
+    try { g_own.set_variant_pool(&shared_dfs); } catch (const std::runtime_error&) { threw = true; }
+    CHECK(threw, "greedy rejects a run_stream-order pool");
+}
+
+static void test_LazyEnumeration(){
+    cout << "[Class] lazy template / sequence / variant spaces\n";
+    using namespace css::template_search;
+    using K = TemplateOpKind;
+    // make_bruce 走 BruceTemplateSpace：與掃過 4^s 種組合再過濾的結果（含順序）相同
+    bool same_lib = true;
+    for (size_t slots = 1; slots <= 6 && same_lib; ++slots) {
+        vector<ElementTemplate> scan;
+        const K kinds[4] = {K::None, K::Read, K::Write, K::Compute};
+        size_t combos = 1; for (size_t i = 0; i < slots; ++i) combos *= 4;
+        for (AddrOrder ord : {AddrOrder::Up, AddrOrder::Down})
+            for (size_t idx = 0; idx < combos; ++idx) {
+                std::vector<K> seq(slots); size_t t = idx;
+                for (size_t p = 0; p < slots; ++p) { seq[p] = kinds[t % 4]; t /= 4; }
+                ElementTemplate et(ord, seq); if (et.is_valid()) scan.push_back(et);
+            }
+        auto lib = TemplateLibrary::make_bruce(slots);
+        same_lib = lib.size()==scan.size();
+        for (size_t i = 0; same_lib && i < scan.size(); ++i) {
+            same_lib = lib.at(i).get_order()==scan[i].get_order();
+            for (size_t p = 0; same_lib && p < slots; ++p) same_lib = lib.at(i).get_slots()[p].kind==scan[i].get_slots()[p].kind;
+        }
+    }
+    CHECK(same_lib, "BruceTemplateSpace reproduces make_bruce order without scanning 4^s");
+    const BruceTemplateSpace big(40);
+    const ElementTemplate last = big.at(big.size()-1), first_down = big.at(big.size()/2), next = big.at(big.size()/2+1);
+    CHECK(big.size()==2*(41+40*41*42/3) && last.get_order()==AddrOrder::Down && last.count_non_none()==40 && !last.has_kind(K::Read) && !last.has_kind(K::Write)
+          && first_down.get_order()==AddrOrder::Down && first_down.count_non_none()==0 && next.count_non_none()==1 && next.has_kind(K::Read),
+          "large template spaces are counted and addressed by rank");
+
+    // sequence：各 shard 依序接起來等於整個空間
+    auto lib = TemplateLibrary::make_bruce(1); // 8 templates
+    TemplateEnumerator en(lib);
+    auto all = en.enumerate(3);
+    vector<vector<size_t>> joined;
+    for (size_t sh = 0; sh < 4; ++sh) {
+        auto r = shard_range(en.count(3), sh, 4);
+        en.for_each(3, r.first, r.second, [&](size_t, const TemplateEnumerator::Sequence& q){ joined.push_back(q.ids); });
+    }
+    bool seq_ok = all.size()==512 && joined.size()==512 && all[1].ids==vector<size_t>{0,0,1} && all[8].ids==vector<size_t>{0,1,0};
+    for (size_t i = 0; seq_ok && i < all.size(); ++i) seq_ok = all[i].ids==joined[i];
+    TemplateEnumerator::Sequence q; en.at(3, 511, q);
+    CHECK(seq_ok && q.ids==vector<size_t>{7,7,7} && en.count(40)==std::numeric_limits<size_t>::max() && en.enumerate(3, 10).size()==10,
+          "sequence ranges shard the DFS order and saturate their count");
+
+    // variant：超過 64 bits 的空間仍可從任一 rank 走訪；generate 不再默默回傳空集合
+    TemplateLibrary wide;
+    wide.push_back(ElementTemplate(AddrOrder::Up, std::vector<K>(24, K::Compute))); // 72 bits
+    wide.push_back(ElementTemplate(AddrOrder::Down, {K::Read, K::Compute, K::Write}));
+    ValueExpandingGenerator gen;
+    bool threw = false;
+    try { gen.generate(wide, 0); } catch (const std::runtime_error&) { threw = true; }
+    vector<MarchElement> got;
+    gen.for_each_variant(wide, 0, 9, 11, [&](size_t, const MarchElement& e){ got.push_back(e); });
+    const bool wide_ok = got.size()==2 && got[0].ops.size()==24 && got[0].ops[0].C_T==Val::One && got[0].ops[1].C_T==Val::One && got[0].ops[2].C_T==Val::Zero
+                      && got[1].ops[0].C_M==Val::One && got[1].ops[1].C_T==Val::One;
+    auto small = gen.generate(wide, 1);
+    vector<size_t> order_ok;
+    bool small_ok = small.size()==32 && gen.variant_count(wide, 1)==32;
+    for (size_t k = 0; small_ok && k < small.size(); ++k) {
+        const auto& o = small[k].ops; // 第一個 slot 變化最快：k = r + 2*(T + 2M + 4B) + 16*w
+        const size_t code = (o[0].value==Val::One) + 2*((o[1].C_T==Val::One) + 2*(o[1].C_M==Val::One) + 4*(o[1].C_B==Val::One)) + 16*(o[2].value==Val::One);
+        small_ok = code==k;
+    }
+    CHECK(threw && wide_ok && gen.variant_count(wide, 0)==std::numeric_limits<size_t>::max() && small_ok,
+          "value masks stream past 64 bits in generate() order");
+    VariantPool capped(wide, gen, 5);
+    CHECK(capped.end(0)-capped.begin(0)==5 && capped.end(1)-capped.begin(1)==5, "a capped pool stays bounded on huge spaces");
+
+    // run_stream：不建池（逐段解出）與建池的結果相同
+    auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
+    auto lib2 = TemplateLibrary::make_bruce(2);
+    FaultSimulator sim;
+    BeamTemplateSearcher pooled(sim, lib2, faults, tps, 4), lazy(sim, lib2, faults, tps, 4);
+    lazy.set_stream_pool_limit(0);
+    auto a = pooled.run_stream(2, 16), b = lazy.run_stream(2, 16);
+    bool eq = !a.empty() && a.size()==b.size();
+    for (size_t i = 0; eq && i < a.size(); ++i) eq = a[i].score==b[i].score && a[i].sequence==b[i].sequence;
+    CHECK(eq, "run_stream without a pool matches the pooled search");
+}
+
 static void test_SimulatorAdaptor(){
     cout << "[Class] SimulatorAdaptor\n";
     auto faults = load_faults("input/S_C_faults.json"); auto tps = gen_tps(faults);
@@ -183,9 +866,27 @@ int main(){
         test_CoverLUT();
         test_StateCoverEngine();
         test_SensEngine();
+        test_TPPatternAutomaton();
         test_DetectEngine();
         test_Reporter();
         test_FaultSimulator();
+        test_PreparedFaultSet();
+        test_FaultGroupInterning();
+        test_SimulationMode();
+        test_SimulationWorkspace();
+        test_BitParallelSimulator();
+        test_TpDominance();
+        test_ParallelSimulate();
+        test_OrderedBatch();
+        test_IncrementalSimulator();
+        test_FaultDropping();
+        test_ArrayFaultSimulator();
+        test_FaultTpCache();
+        test_PrefixTrieBatch();
+        test_BeamParallelRun();
+        test_TranspositionTable();
+        test_VariantPool();
+        test_LazyEnumeration();
         test_SimulatorAdaptor();
         test_DiffScorer();
         test_ElementPolicy();
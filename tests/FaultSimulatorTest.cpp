@@ -70,9 +70,9 @@ static TestPrimitive mk_tp(const CrossState& st){
     return tp;
 }
 
-// 取 vector<size_t> 當成集合做比較（忽略順序與重覆）
-template<typename T>
-static std::set<T> as_set(const std::vector<T>& v){ return std::set<T>(v.begin(), v.end()); }
+// 取任一範圍（vector / TpKeySpan）當成集合做比較（忽略順序與重覆）
+template<typename R>
+static auto as_set(const R& v){ using T = std::decay_t<decltype(*v.begin())>; return std::set<T>(v.begin(), v.end()); }
 
 
 // ============ Unit Tests ============
@@ -90,7 +90,7 @@ static void test_OpTableBuilder(){
 
 static void test_CoverLUT() {
     cout << "\n[Test] CoverLUT" << endl;
-    CoverLUT lut; // 建構時即完成 729x729 相容表
+    CoverLUT lut; // 相容表於編譯期產生（CSR），建構無成本
 
     // 1) 完全相等匹配
     {